@@ -0,0 +1,100 @@
+#include "minigl/minigl.hpp"
+
+#include <chrono>
+#include <random>
+
+using namespace minigl;
+
+constexpr size_t PRIMITIVE_COUNT = 1'000'000;
+constexpr size_t QUERY_COUNT = 100'000;
+
+/// Time of a call of `func`, in milliseconds
+template<typename F>
+static double measure(F&& func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/// Measures the build time of a BVH over 1M random boxes, and
+/// the throughput of its queries. No window is needed.
+int main() {
+    std::mt19937 rng {42};
+    std::uniform_real_distribution<float> position {-500.f, 500.f};
+    std::uniform_real_distribution<float> size {0.5f, 5.f};
+
+    auto random_box = [&](const Vec3& center) {
+        Vec3 extent {size(rng), size(rng), size(rng)};
+        return AABB { .min = center - extent, .max = center + extent };
+    };
+
+    std::vector<AABB> boxes {};
+    boxes.reserve(PRIMITIVE_COUNT);
+    for (size_t i = 0; i < PRIMITIVE_COUNT; i++)
+        boxes.push_back(random_box(Vec3{position(rng), position(rng), position(rng)}));
+
+    BVH bvh {};
+    double ms = measure([&] { bvh.build(boxes, false); });
+    println("Build (serial)     {:9.1f} ms  ({} nodes)", ms, bvh.nodes().size());
+
+    ms = measure([&] { bvh.build(boxes, true); });
+    println("Build (parallel)   {:9.1f} ms  ({} threads)", ms, ThreadPool::global().size());
+
+    // Move all the boxes a bit
+    for (auto& box: boxes) {
+        Vec3 offset {position(rng) * 0.01f, position(rng) * 0.01f, position(rng) * 0.01f};
+        box.min += offset;
+        box.max += offset;
+    }
+
+    ms = measure([&] { bvh.refit(boxes); });
+    println("Refit              {:9.1f} ms", ms);
+
+    // Frustum queries, from the center of the scene in the six
+    // axis directions
+    std::vector<uint32_t> result {};
+    Mat4 proj = perspective(radians(60.f), 16.f/9.f, 0.1f, 1000.f);
+    std::array<Vec3, 6> directions = {
+        Vec3{1.f, 0.f, 0.f}, Vec3{-1.f, 0.f, 0.f},
+        Vec3{0.f, 0.f, 1.f}, Vec3{0.f, 0.f, -1.f},
+        Vec3{0.5f, 0.5f, 0.5f}, Vec3{-0.5f, -0.5f, 0.5f}
+    };
+
+    ms = measure([&] {
+        for (auto& direction: directions) {
+            Frustum frustum {proj * lookAt(Vec3{0.f}, direction, Vec3{0.f, 1.f, 0.f})};
+            bvh.query(frustum, result);
+        }
+    });
+    println("Frustum queries    {:9.3f} ms/query  ({} visible per query)", ms / directions.size(), result.size() / directions.size());
+
+    // Closest hits of random rays
+    std::vector<Ray> rays(QUERY_COUNT);
+    for (auto& ray: rays) {
+        ray.origin = Vec3{position(rng), position(rng), position(rng)};
+        ray.direction = normalize(Vec3{position(rng), position(rng), position(rng)});
+    }
+
+    size_t hits = 0;
+    ms = measure([&] {
+        for (auto& ray: rays)
+            hits += bvh.raycast(ray).hit();
+    });
+    println("Ray casts          {:9.1f} Krays/s  ({} hits)", QUERY_COUNT / ms, hits);
+
+    // Small range queries
+    std::vector<AABB> ranges(QUERY_COUNT);
+    for (auto& range: ranges)
+        range = random_box(Vec3{position(rng), position(rng), position(rng)});
+
+    result.clear();
+    ms = measure([&] {
+        for (auto& range: ranges)
+            bvh.query(range, result);
+    });
+    println("Range queries      {:9.1f} Kqueries/s  ({} results)", QUERY_COUNT / ms, result.size());
+
+    return 0;
+}
\ No newline at end of file
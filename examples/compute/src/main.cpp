@@ -55,8 +55,11 @@ class Compute: public App {
 
             quad = ref<VertexArray>(vb, ib);
             
-            quad_shader = ref<Shader>("res/quad.glsl");
-            compute_shader = ref<Shader>("res/compute.glsl");
+            // Let the driver compile both programs concurrently
+            ShaderBatch shaders {};
+            quad_shader = shaders.add("res/quad.glsl");
+            compute_shader = shaders.add("res/compute.glsl");
+            shaders.build();
 
             w = 512; h = 512;
             image = ref<Texture>(w, h, TextureFormat::COLOR_RGBA);
@@ -0,0 +1,71 @@
+#include "minigl/minigl.hpp"
+
+#include <chrono>
+#include <random>
+
+using namespace minigl;
+
+constexpr size_t BOX_COUNT = 1'000'000;
+constexpr int RUNS = 20;
+
+/// Best time of `RUNS` runs of `func`, in milliseconds
+template<typename F>
+static double measure(F&& func)
+{
+    double best = std::numeric_limits<double>::max();
+    for (int run = 0; run < RUNS; run++) {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+
+    return best;
+}
+
+/// Compares the throughput of the frustum culling kernels on
+/// 1M random boxes. No window is needed.
+int main() {
+    std::mt19937 rng {42};
+    std::uniform_real_distribution<float> position {-500.f, 500.f};
+    std::uniform_real_distribution<float> size {0.5f, 5.f};
+
+    BoundingBoxes boxes {};
+    boxes.reserve(BOX_COUNT);
+    for (size_t i = 0; i < BOX_COUNT; i++) {
+        Vec3 center {position(rng), position(rng), position(rng)};
+        Vec3 extent {size(rng), size(rng), size(rng)};
+        boxes.add(AABB { .min = center - extent, .max = center + extent });
+    }
+
+    Mat4 viewProj = perspective(radians(60.f), 16.f/9.f, 0.1f, 1000.f)
+                  * lookAt(Vec3{0.f}, Vec3{0.f, 0.f, -1.f}, Vec3{0.f, 1.f, 0.f});
+    Frustum frustum {viewProj};
+
+    std::vector<uint8_t> visible {};
+    auto report = [&](const char* name, double ms, size_t count) {
+        println("{:<16} {:8.3f} ms  {:8.1f} Mboxes/s  ({} visible)", name, ms, BOX_COUNT / ms / 1000.0, count);
+    };
+
+    size_t count = 0;
+    std::vector<std::pair<const char*, SimdLevel>> levels = {
+        { "Scalar", SimdLevel::Scalar },
+        { "SSE", SimdLevel::SSE },
+        { "AVX", SimdLevel::AVX },
+    };
+
+    for (auto [name, level]: levels) {
+        if (level > simd_level()) {
+            println("{:<16} not supported", name);
+            continue;
+        }
+
+        double ms = measure([&] { count = frustum_cull(frustum, boxes, visible, level); });
+        report(name, ms, count);
+    }
+
+    double ms = measure([&] { count = frustum_cull_parallel(frustum, boxes, visible); });
+    report("Parallel", ms, count);
+
+    return 0;
+}
\ No newline at end of file
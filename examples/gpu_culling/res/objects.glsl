@@ -0,0 +1,50 @@
+#ifdef VERTEX
+#extension GL_ARB_shader_draw_parameters : require
+
+struct Object
+{
+    mat4 transform;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uint indexCount;
+    uint firstIndex;
+    int baseVertex;
+    uint padding;
+};
+
+layout(std430, binding = 8) readonly buffer Objects { Object objects[]; };
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+
+uniform mat4 u_viewProj;
+
+out vec3 v_normal;
+out vec3 v_color;
+
+void main()
+{
+    // The culling shader stores the object index in the base
+    // instance of its draw command
+    mat4 model = objects[gl_BaseInstanceARB].transform;
+
+    v_normal = mat3(model) * a_normal;
+    v_color = abs(normalize(model[3].xyz));
+    gl_Position = u_viewProj * model * vec4(a_position, 1.0);
+}
+#endif
+
+#ifdef FRAGMENT
+layout(location = 0) out vec4 color;
+
+in vec3 v_normal;
+in vec3 v_color;
+
+void main()
+{
+    vec3 light_dir = normalize(vec3(1.0, 2.0, 1.5));
+    float diff = max(dot(normalize(v_normal), light_dir), 0.0);
+
+    color = vec4((0.2 + 0.8 * diff) * v_color, 1.0);
+}
+#endif
\ No newline at end of file
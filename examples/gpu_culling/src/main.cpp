@@ -0,0 +1,82 @@
+#include "minigl/minigl.hpp"
+
+using namespace minigl;
+
+constexpr uint32_t N = 47;
+
+/// Unit cube with per-face normals
+static Ref<Mesh> cube_mesh()
+{
+    std::vector<Vertex> vertices {};
+    std::vector<uint32_t> indices {};
+
+    for (int axis = 0; axis < 3; axis++) {
+        for (float side: { -1.f, 1.f }) {
+            Vec3 normal {0.f};
+            normal[axis] = side;
+
+            Vec3 u {0.f}, v {0.f};
+            u[(axis + 1) % 3] = 1.f;
+            v[(axis + 2) % 3] = side;
+
+            uint32_t base = vertices.size();
+            for (auto [a, b]: { std::pair{-1.f, -1.f}, {1.f, -1.f}, {1.f, 1.f}, {-1.f, 1.f} }) {
+                Vertex vertex {};
+                vertex.pos = 0.5f * (normal + a * u + b * v);
+                vertex.normal = normal;
+                vertices.push_back(vertex);
+            }
+
+            for (uint32_t i: { 0, 1, 2, 2, 3, 0 })
+                indices.push_back(base + i);
+        }
+    }
+
+    return ref<Mesh>(vertices, indices);
+}
+
+/// About 100k cubes drawn with a single dispatch and a single
+/// draw call: the cubes outside the view are culled on the
+/// GPU.
+class GPUCullingApp: public App3D
+{
+    public:
+
+        GPUCullingApp(): App3D(800, 600), scene(N*N*N)
+        {
+            mesh = cube_mesh();
+            shader = ref<Shader>("res/objects.glsl");
+
+            for (uint32_t x = 0; x < N; x++)
+            for (uint32_t y = 0; y < N; y++)
+            for (uint32_t z = 0; z < N; z++) {
+                GPUObject object {};
+                object.transform = translate(2.f * Vec3{(float)x, (float)y, -(float)z});
+                object.boundsMin = Vec4{mesh->bounds.min, 0.f};
+                object.boundsMax = Vec4{mesh->bounds.max, 0.f};
+                object.index_count = mesh->indices.size();
+                scene.add(object);
+            }
+        }
+
+        void render() override {
+            scene.cull(camera.viewProj);
+
+            shader->use();
+            shader->upload("u_viewProj", camera.viewProj);
+            scene.draw(mesh->vertexArray);
+        }
+
+    private:
+
+        GPUScene scene;
+        Ref<Shader> shader;
+        Ref<Mesh> mesh;
+};
+
+int main() {
+    GPUCullingApp app {};
+    app.run();
+
+    return 0;
+}
\ No newline at end of file
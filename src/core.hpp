@@ -38,4 +38,19 @@ namespace minigl
     constexpr Box<T> box(Args&&... args) {
         return std::make_unique<T>(std::forward<Args>(args)...);
     }
+
+    /// 64-bit FNV-1a hash of a block of bytes. Pass the hash
+    /// of a previous block as `seed` to hash several blocks
+    /// as if they were contiguous.
+    inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+    {
+        auto bytes = (const uint8_t*)data;
+        uint64_t hash = seed;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
 }
\ No newline at end of file
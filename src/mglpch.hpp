@@ -7,5 +7,6 @@
 #include <array>
 #include <memory>
 #include <functional>
+#include <unordered_map>
 #include <fstream>
 #include <assert.h>
\ No newline at end of file
@@ -44,6 +44,9 @@ namespace minigl
     {
         window = box<Window>(width, height);
         input = box<Input>(window->get_native_window());
+        meshLoader = ref<MeshLoader>();
+        textureStreamer = ref<TextureStreamer>();
+        frameSync = box<FrameSync>(2);
 
         // Set the GLFW callbacks
         set_glfw_callbacks();
@@ -82,6 +85,11 @@ namespace minigl
             dt = time - lastFrameTime;
             lastFrameTime = time;
 
+            // Upload the meshes and textures loaded in the
+            // background
+            meshLoader->upload(uploadBudget);
+            textureStreamer->upload(textureBudget);
+
             if(!minimized) {
                 // Clear the screen
                 RenderCommand::set_clear_color({0.2f});
@@ -89,7 +97,9 @@ namespace minigl
 
                 // Update and draw stuff
                 onUpdate(dt);
+                frameSync->begin_frame();
                 render();
+                frameSync->end_frame();
             }
 
             // Poll events and swap buffers
@@ -3,6 +3,9 @@
 #include "core.hpp"
 #include "window.hpp"
 #include "input/input.hpp"
+#include "minigl/mesh_loader.hpp"
+#include "minigl/texture_streamer.hpp"
+#include "minigl/sync.hpp"
 
 namespace minigl
 {
@@ -21,10 +24,36 @@ namespace minigl
             /// Time since the application started, in seconds.
             static float time();
 
+            /// Set the maximum number of bytes of
+            /// asynchronously loaded meshes uploaded to the GPU
+            /// per frame (8 MB by default).
+            void set_upload_budget(size_t bytes) { uploadBudget = bytes; }
+
+            /// Set the maximum number of bytes of streamed
+            /// textures uploaded to the GPU per frame (8 MB by
+            /// default).
+            void set_texture_budget(size_t bytes) { textureBudget = bytes; }
+
         protected:
         
             Ref<Input> input;
             float dt = 0.f;
+
+            /// Asynchronous mesh loader; the meshes it loads are
+            /// uploaded at the start of each frame, within the
+            /// upload budget.
+            Ref<MeshLoader> meshLoader;
+
+            /// Asynchronous texture streamer; like the meshes,
+            /// its textures are uploaded at the start of each
+            /// frame, within the texture budget.
+            Ref<TextureStreamer> textureStreamer;
+
+            /// Frames in flight: `render()` is called between
+            /// `begin_frame()` and `end_frame()`, so its
+            /// `frame_index()` can be used to pick per-frame
+            /// regions of persistently mapped buffers.
+            Box<FrameSync> frameSync;
         
         private:
 
@@ -36,5 +65,7 @@ namespace minigl
             Box<Window> window;
             bool running = true, minimized = false;
             float lastFrameTime = 0.f;
+            size_t uploadBudget = 8 << 20;
+            size_t textureBudget = 8 << 20;
     };
 }
\ No newline at end of file
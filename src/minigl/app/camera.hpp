@@ -30,6 +30,9 @@ namespace minigl
 
             virtual void onUpdate(Ref<Input> input, float dt) = 0;
 
+            /// Frustum of the current view-projection matrix
+            Frustum frustum() const { return Frustum {viewProj}; }
+
         public:
 
             Mat4 proj;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "mglpch.hpp"
+#include "minigl/render_state.hpp"
 
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
@@ -17,7 +18,7 @@ namespace minigl
             void set_viewport(const int width, const int height) {
                 this->width = width;
                 this->height = height;
-                glViewport(0, 0, width, height);
+                RenderState::set_viewport(0, 0, width, height);
             }
 
         private:
@@ -0,0 +1,237 @@
+#include "atlas.hpp"
+#include "texture_loader.hpp"
+#include "thread_pool.hpp"
+
+#include <glad/glad.h>
+#include <numeric>
+
+namespace minigl
+{
+    //----------- SKYLINE PACKER -----------//
+
+    SkylinePacker::SkylinePacker(int width, int height):
+        skyline({{0, 0, width}}), binWidth(width), binHeight(height)
+    {
+    }
+
+    int SkylinePacker::fit(size_t index, int width, int height) const
+    {
+        if (skyline[index].x + width > binWidth)
+            return -1;
+
+        // The rectangle rests on the highest segment below it.
+        int y = 0;
+        for (int remaining = width; remaining > 0; index++) {
+            y = std::max(y, skyline[index].y);
+            if (y + height > binHeight)
+                return -1;
+
+            remaining -= skyline[index].width;
+        }
+
+        return y;
+    }
+
+    bool SkylinePacker::pack(int width, int height, AtlasRect& rect)
+    {
+        // Bottom-left: lowest top edge, then leftmost.
+        size_t best = skyline.size();
+        int best_top = binHeight + 1;
+        for (size_t i = 0; i < skyline.size(); i++) {
+            int y = fit(i, width, height);
+            if (y >= 0 && y + height < best_top) {
+                best = i;
+                best_top = y + height;
+                rect = {skyline[i].x, y, width, height};
+            }
+        }
+
+        if (best == skyline.size())
+            return false;
+
+        skyline.insert(skyline.begin() + best, Segment {rect.x, rect.y + height, width});
+
+        // Cut the segments now below the rectangle.
+        for (size_t i = best + 1; i < skyline.size(); ) {
+            auto& prev = skyline[i - 1];
+            int overlap = prev.x + prev.width - skyline[i].x;
+            if (overlap <= 0)
+                break;
+
+            skyline[i].x += overlap;
+            skyline[i].width -= overlap;
+            if (skyline[i].width > 0)
+                break;
+
+            skyline.erase(skyline.begin() + i);
+        }
+
+        // Merge the neighbours at the same height.
+        for (size_t i = 0; i + 1 < skyline.size(); ) {
+            if (skyline[i].y == skyline[i + 1].y) {
+                skyline[i].width += skyline[i + 1].width;
+                skyline.erase(skyline.begin() + i + 1);
+            }
+            else {
+                i++;
+            }
+        }
+
+        usedArea += (size_t)width * height;
+        return true;
+    }
+
+    //----------- TEXTURE ATLAS -----------//
+
+    TextureAtlas::TextureAtlas(int layer_width, int layer_height, int padding):
+        layerWidth(layer_width), layerHeight(layer_height), padding(padding)
+    {
+    }
+
+    uint32_t TextureAtlas::add(const uint8_t* pixels, int width, int height, int channels)
+    {
+        MGL_ASSERT(width + 2*padding <= layerWidth && height + 2*padding <= layerHeight,
+                   "Image of {}x{} too large for atlas layers of {}x{}.", width, height, layerWidth, layerHeight);
+        MGL_ASSERT(channels >= 1 && channels <= 4, "Atlas images must have 1 to 4 channels ({} given).", channels);
+
+        // Stored as RGBA, the format of the atlas: grey
+        // images are expanded, missing alpha is opaque.
+        Image image {width, height, std::vector<uint8_t>((size_t)width * height * 4)};
+        for (size_t p = 0; p < (size_t)width * height; p++) {
+            const uint8_t* src = pixels + p * channels;
+            uint8_t* dst = image.pixels.data() + p * 4;
+
+            if (channels <= 2)
+                dst[0] = dst[1] = dst[2] = src[0];
+            else
+                dst[0] = src[0], dst[1] = src[1], dst[2] = src[2];
+
+            dst[3] = channels == 2 ? src[1] : channels == 4 ? src[3] : 255;
+        }
+
+        images.push_back(std::move(image));
+        return images.size() - 1;
+    }
+
+    uint32_t TextureAtlas::add(const TextureData& image)
+    {
+        MGL_ASSERT(!image.compressed, "Texture at path '{}': compressed images cannot be packed in an atlas.", image.path);
+        return add(image.pixels.get(), image.width, image.height, image.channels);
+    }
+
+    uint32_t TextureAtlas::add(const std::string& path)
+    {
+        return add(TextureData(path, {.mipmaps = MipmapGeneration::None}));
+    }
+
+    Ref<Texture> TextureAtlas::build(const TextureOptions& options)
+    {
+        MGL_ASSERT(!images.empty(), "Cannot build an empty texture atlas.");
+
+        // Tall images first: the skyline stays flatter, which
+        // wastes less space under it.
+        std::vector<uint32_t> order(images.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            if (images[a].height != images[b].height)
+                return images[a].height > images[b].height;
+            return images[a].width > images[b].width;
+        });
+
+        // First fit: each image goes in the first layer with
+        // room for it.
+        std::vector<SkylinePacker> packers {};
+        std::vector<AtlasRect> rects(images.size());
+        atlasRegions.assign(images.size(), {});
+
+        for (uint32_t i: order) {
+            int width = images[i].width + 2*padding;
+            int height = images[i].height + 2*padding;
+
+            uint32_t layer = 0;
+            while (layer < packers.size() && !packers[layer].pack(width, height, rects[i]))
+                layer++;
+
+            if (layer == packers.size()) {
+                packers.emplace_back(layerWidth, layerHeight);
+                packers.back().pack(width, height, rects[i]);
+            }
+
+            atlasRegions[i] = AtlasRegion {
+                .scale = {(float)images[i].width / layerWidth, (float)images[i].height / layerHeight},
+                .offset = {(float)(rects[i].x + padding) / layerWidth, (float)(rects[i].y + padding) / layerHeight},
+                .layer = layer
+            };
+        }
+
+        // Copy the images in their layer, with their edges
+        // repeated in the padding. The rectangles are
+        // disjoint, so the images are copied in parallel.
+        size_t layer_size = (size_t)layerWidth * layerHeight * 4;
+        std::vector<std::vector<uint8_t>> layers(packers.size(), std::vector<uint8_t>(layer_size));
+
+        parallel_for(images.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                auto& image = images[i];
+                auto& rect = rects[i];
+                uint8_t* layer = layers[atlasRegions[i].layer].data();
+
+                for (int y = 0; y < rect.height; y++) {
+                    int src_y = std::clamp(y - padding, 0, image.height - 1);
+                    const uint8_t* src = image.pixels.data() + (size_t)src_y * image.width * 4;
+                    uint8_t* dst = layer + ((size_t)(rect.y + y) * layerWidth + rect.x) * 4;
+
+                    for (int x = 0; x < padding; x++) {
+                        std::memcpy(dst + x*4, src, 4);
+                        std::memcpy(dst + (padding + image.width + x)*4, src + (image.width - 1)*4, 4);
+                    }
+                    std::memcpy(dst + padding*4, src, (size_t)image.width * 4);
+                }
+            }
+        }, 16);
+
+        auto format = options.srgb ? TextureFormat::COLOR_SRGB_ALPHA : TextureFormat::COLOR_RGBA8;
+        uint32_t levels = options.mipmaps == MipmapGeneration::None ? 1 : 0;
+        auto texture = ref<Texture>(layerWidth, layerHeight, (int)layers.size(), format, levels);
+        texture->set_filtering(options.filtering, options.anisotropy);
+
+        for (size_t l = 0; l < layers.size(); l++) {
+            texture->upload_layer(l, 0, 0, layerWidth, layerHeight, GL_RGBA, layers[l].data());
+
+            if (options.mipmaps == MipmapGeneration::CPUBox || options.mipmaps == MipmapGeneration::CPUKaiser) {
+                auto mips = generate_mipmaps(layers[l].data(), layerWidth, layerHeight, 4, options.srgb, options.mipmaps);
+                for (uint32_t level = 1; level < texture->levels; level++) {
+                    auto& mip = mips[level - 1];
+                    texture->upload_layer(l, 0, 0, mip.width, mip.height, GL_RGBA, mip.pixels.data(), level);
+                }
+            }
+        }
+
+        if (options.mipmaps == MipmapGeneration::GPU)
+            texture->generate_mipmaps();
+
+        float occupancy = 0.f;
+        for (auto& packer: packers)
+            occupancy += packer.occupancy();
+
+        trace("Built texture atlas of {} images in {} layers of {}x{} ({:.0f}% occupancy)",
+              images.size(), layers.size(), layerWidth, layerHeight, 100.f * occupancy / packers.size());
+
+        return texture;
+    }
+
+    const char* const atlas_region_glsl = R"glsl(
+struct AtlasRegion
+{
+    vec2 scale;
+    vec2 offset;
+    uint layer;
+    uint padding[3];
+};
+
+vec3 atlas_uv(AtlasRegion region, vec2 uv)
+{
+    return vec3(uv * region.scale + region.offset, float(region.layer));
+}
+)glsl";
+}
\ No newline at end of file
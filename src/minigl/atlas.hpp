@@ -0,0 +1,125 @@
+#pragma once
+
+#include "core.hpp"
+#include "geometry.hpp"
+#include "texture.hpp"
+
+namespace minigl
+{
+    struct TextureData;
+
+    /// Rectangle of texels, from its bottom left corner
+    struct AtlasRect
+    {
+        int x = 0, y = 0;
+        int width = 0, height = 0;
+    };
+
+    /// Skyline rectangle packer: the free space of the bin is
+    /// described by its top edge (the skyline), a list of
+    /// horizontal segments. Rectangles are placed bottom-left,
+    /// at the lowest position where they fit. It wastes the
+    /// space below the skyline overhangs, but packs in
+    /// O(n) per rectangle, fast enough to build atlases at
+    /// runtime.
+    class SkylinePacker
+    {
+        public:
+
+            SkylinePacker(int width, int height);
+
+            /// Place a `width` x `height` rectangle, or return
+            /// false if it does not fit anymore.
+            bool pack(int width, int height, AtlasRect& rect);
+
+            /// Fraction of the bin area covered by rectangles
+            float occupancy() const { return (float)usedArea / ((float)binWidth * binHeight); }
+
+        private:
+
+            struct Segment
+            {
+                int x, y, width;
+            };
+
+            /// Height at which a `width` wide rectangle fits on
+            /// the skyline from segment `index`, or -1.
+            int fit(size_t index, int width, int height) const;
+
+            std::vector<Segment> skyline;
+            int binWidth, binHeight;
+            size_t usedArea = 0;
+    };
+
+    /// Location of an image in an atlas. The texture
+    /// coordinates of the image map to the atlas with
+    /// `uv * scale + offset`, in the array layer `layer`. The
+    /// layout matches the std430 `AtlasRegion` struct of
+    /// `atlas_region_glsl`, so the regions can be uploaded to
+    /// a shader storage buffer as is and indexed per instance
+    /// or per draw.
+    struct AtlasRegion
+    {
+        Vec2 scale;
+        Vec2 offset;
+        uint32_t layer;
+        uint32_t padding[3] {};
+    };
+
+    /// Builder of texture atlases: images of any size are
+    /// packed into the layers of an array texture, so that
+    /// objects using different images can be drawn with a
+    /// single texture binding, in a single instanced or
+    /// indirect draw.
+    class TextureAtlas
+    {
+        public:
+
+            /// Create an atlas of `layer_width` x `layer_height`
+            /// layers. Each image is surrounded by `padding`
+            /// texels repeating its edges, so that filtering
+            /// does not bleed neighbouring images in; mip
+            /// level n only stays clean while 2^n <= `padding`.
+            TextureAtlas(int layer_width = 2048, int layer_height = 2048, int padding = 4);
+
+            /// Add 8-bit pixels of 1 to 4 channels (copied), and
+            /// return the index of their region.
+            uint32_t add(const uint8_t* pixels, int width, int height, int channels);
+
+            /// Add a decoded image (see `load_textures()` to
+            /// decode many images in parallel).
+            uint32_t add(const TextureData& image);
+
+            /// Load and add the image at `path`.
+            uint32_t add(const std::string& path);
+
+            /// Pack the images added so far, largest first,
+            /// into as few layers as possible, and upload them
+            /// to an RGBA8 (or sRGB) array texture. Fills the
+            /// regions of the images.
+            Ref<Texture> build(const TextureOptions& options = {});
+
+            /// Regions of the images, by index, valid after
+            /// `build()`.
+            const std::vector<AtlasRegion>& regions() const { return atlasRegions; }
+
+        private:
+
+            struct Image
+            {
+                int width, height;
+                std::vector<uint8_t> pixels;
+            };
+
+            int layerWidth, layerHeight, padding;
+            std::vector<Image> images;
+            std::vector<AtlasRegion> atlasRegions;
+    };
+
+    /// GLSL `AtlasRegion` struct (see the C++ struct) and the
+    /// function `vec3 atlas_uv(AtlasRegion region, vec2 uv)`,
+    /// which returns the coordinates sampling an atlas
+    /// `sampler2DArray`. To be prepended to the source of the
+    /// shaders sampling atlases.
+    extern const char* const atlas_region_glsl;
+}
\ No newline at end of file
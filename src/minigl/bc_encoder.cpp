@@ -0,0 +1,434 @@
+#include "bc_encoder.hpp"
+#include "thread_pool.hpp"
+
+#include <cmath>
+#include <cstring>
+
+namespace minigl
+{
+    //----------- HELPERS -----------//
+
+    /// Principal axis of a set of points of `N` components,
+    /// by power iteration on their covariance matrix. Returns
+    /// the mean through `mean`.
+    template<int N>
+    static std::array<float, N> principal_axis(const float (*points)[N], int count, std::array<float, N>& mean)
+    {
+        mean.fill(0.f);
+        for (int i = 0; i < count; i++)
+            for (int c = 0; c < N; c++)
+                mean[c] += points[i][c] / count;
+
+        float covariance[N][N] {};
+        for (int i = 0; i < count; i++)
+            for (int a = 0; a < N; a++)
+                for (int b = 0; b < N; b++)
+                    covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+
+        std::array<float, N> axis {};
+        axis.fill(1.f);
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            std::array<float, N> next {};
+            float length = 0.f;
+            for (int a = 0; a < N; a++) {
+                for (int b = 0; b < N; b++)
+                    next[a] += covariance[a][b] * axis[b];
+                length = std::max(length, std::abs(next[a]));
+            }
+
+            if (length == 0.f)
+                break;
+            for (int a = 0; a < N; a++)
+                axis[a] = next[a] / length;
+        }
+
+        return axis;
+    }
+
+    static uint16_t pack_565(float r, float g, float b)
+    {
+        auto quantize = [](float v, int max) { return (uint16_t)std::clamp((int)(v / 255.f * max + 0.5f), 0, max); };
+        return (quantize(r, 31) << 11) | (quantize(g, 63) << 5) | quantize(b, 31);
+    }
+
+    static void unpack_565(uint16_t color, float* rgb)
+    {
+        int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    //----------- BC1 -----------//
+
+    /// Indices of the texels for 565 endpoints in 4-color
+    /// mode, and the total squared error
+    static float bc1_indices(const float (*colors)[3], uint16_t c0, uint16_t c1, uint32_t& indices)
+    {
+        float palette[4][3];
+        unpack_565(c0, palette[0]);
+        unpack_565(c1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+            palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+        }
+
+        float total = 0.f;
+        indices = 0;
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            float best_error = std::numeric_limits<float>::max();
+            for (int p = 0; p < 4; p++) {
+                float error = 0.f;
+                for (int c = 0; c < 3; c++) {
+                    float d = colors[i][c] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < best_error) {
+                    best = p;
+                    best_error = error;
+                }
+            }
+
+            indices |= best << (2 * i);
+            total += best_error;
+        }
+
+        return total;
+    }
+
+    /// Least squares endpoints for the given indices: the
+    /// texel colors are `(1-t) e0 + t e1`, with t in {0, 1,
+    /// 1/3, 2/3} for indices {0, 1, 2, 3}.
+    static bool bc1_refit(const float (*colors)[3], uint32_t indices, float* e0, float* e1)
+    {
+        static const float weights[4] = {0.f, 1.f, 1.f / 3.f, 2.f / 3.f};
+
+        float aa = 0.f, ab = 0.f, bb = 0.f;
+        float ax[3] {}, bx[3] {};
+        for (int i = 0; i < 16; i++) {
+            float t = weights[(indices >> (2 * i)) & 3];
+            float a = 1.f - t;
+            aa += a * a; ab += a * t; bb += t * t;
+            for (int c = 0; c < 3; c++) {
+                ax[c] += a * colors[i][c];
+                bx[c] += t * colors[i][c];
+            }
+        }
+
+        float det = aa * bb - ab * ab;
+        if (std::abs(det) < 1e-6f)
+            return false;
+
+        for (int c = 0; c < 3; c++) {
+            e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.f, 255.f);
+            e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.f, 255.f);
+        }
+
+        return true;
+    }
+
+    /// Write a BC1 color block for the endpoints, in 4-color
+    /// mode (which requires c0 > c1)
+    static void bc1_write(const float (*colors)[3], uint16_t c0, uint16_t c1, uint8_t* block)
+    {
+        uint32_t indices = 0;
+        if (c0 < c1)
+            std::swap(c0, c1);
+
+        // Equal endpoints select the 3-color mode: all the
+        // texels use the first endpoint.
+        if (c0 != c1)
+            bc1_indices(colors, c0, c1, indices);
+
+        std::memcpy(block, &c0, 2);
+        std::memcpy(block + 2, &c1, 2);
+        std::memcpy(block + 4, &indices, 4);
+    }
+
+    static void encode_bc1_colors(const float (*colors)[3], uint8_t* block)
+    {
+        std::array<float, 3> mean;
+        auto axis = principal_axis<3>(colors, 16, mean);
+
+        // Endpoints: extreme projections on the axis
+        float min_t = std::numeric_limits<float>::max(), max_t = std::numeric_limits<float>::lowest();
+        for (int i = 0; i < 16; i++) {
+            float t = 0.f;
+            for (int c = 0; c < 3; c++)
+                t += (colors[i][c] - mean[c]) * axis[c];
+            min_t = std::min(min_t, t);
+            max_t = std::max(max_t, t);
+        }
+
+        float axis_length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        if (axis_length2 > 0.f) {
+            min_t /= axis_length2;
+            max_t /= axis_length2;
+        }
+
+        float e0[3], e1[3];
+        for (int c = 0; c < 3; c++) {
+            e0[c] = std::clamp(mean[c] + max_t * axis[c], 0.f, 255.f);
+            e1[c] = std::clamp(mean[c] + min_t * axis[c], 0.f, 255.f);
+        }
+
+        uint16_t c0 = pack_565(e0[0], e0[1], e0[2]);
+        uint16_t c1 = pack_565(e1[0], e1[1], e1[2]);
+        if (c0 < c1)
+            std::swap(c0, c1);
+
+        // Refine the endpoints for the indices they produce,
+        // and keep the refit if it is better.
+        if (c0 != c1)
+        {
+            uint32_t indices;
+            float error = bc1_indices(colors, c0, c1, indices);
+
+            if (bc1_refit(colors, indices, e0, e1)) {
+                uint16_t r0 = pack_565(e0[0], e0[1], e0[2]);
+                uint16_t r1 = pack_565(e1[0], e1[1], e1[2]);
+                if (r0 < r1)
+                    std::swap(r0, r1);
+
+                uint32_t refit_indices;
+                if (r0 != r1 && bc1_indices(colors, r0, r1, refit_indices) < error) {
+                    c0 = r0;
+                    c1 = r1;
+                }
+            }
+        }
+
+        bc1_write(colors, c0, c1, block);
+    }
+
+    void encode_bc1_block(const uint8_t* texels, uint8_t* block)
+    {
+        float colors[16][3];
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                colors[i][c] = texels[4 * i + c];
+
+        encode_bc1_colors(colors, block);
+    }
+
+    //----------- BC4 -----------//
+
+    void encode_bc4_block(const uint8_t* texels, uint8_t* block, int channel)
+    {
+        int min_value = 255, max_value = 0;
+        for (int i = 0; i < 16; i++) {
+            min_value = std::min<int>(min_value, texels[4 * i + channel]);
+            max_value = std::max<int>(max_value, texels[4 * i + channel]);
+        }
+
+        // 8-value mode (first endpoint greater): the endpoints,
+        // then 6 interpolated values.
+        block[0] = max_value;
+        block[1] = min_value;
+
+        uint64_t indices = 0;
+        if (max_value > min_value)
+        {
+            int palette[8];
+            palette[0] = max_value;
+            palette[1] = min_value;
+            for (int p = 1; p < 7; p++)
+                palette[p + 1] = ((7 - p) * max_value + p * min_value) / 7;
+
+            for (int i = 0; i < 16; i++) {
+                int value = texels[4 * i + channel];
+                int best = 0, best_error = 256;
+                for (int p = 0; p < 8; p++) {
+                    int error = std::abs(value - palette[p]);
+                    if (error < best_error) {
+                        best = p;
+                        best_error = error;
+                    }
+                }
+                indices |= (uint64_t)best << (3 * i);
+            }
+        }
+
+        for (int b = 0; b < 6; b++)
+            block[2 + b] = (indices >> (8 * b)) & 0xff;
+    }
+
+    //----------- BC3, BC5 -----------//
+
+    void encode_bc3_block(const uint8_t* texels, uint8_t* block)
+    {
+        encode_bc4_block(texels, block, 3);
+        encode_bc1_block(texels, block + 8);
+    }
+
+    void encode_bc5_block(const uint8_t* texels, uint8_t* block)
+    {
+        encode_bc4_block(texels, block, 0);
+        encode_bc4_block(texels, block + 8, 1);
+    }
+
+    //----------- BC7 -----------//
+
+    /// Writes bits to a 128-bit block, from the least
+    /// significant bit of the first byte
+    struct BitWriter
+    {
+        uint8_t* block;
+        int position = 0;
+
+        void write(uint32_t value, int bits)
+        {
+            for (int b = 0; b < bits; b++, position++)
+                if ((value >> b) & 1)
+                    block[position / 8] |= 1 << (position % 8);
+        }
+    };
+
+    void encode_bc7_block(const uint8_t* texels, uint8_t* block)
+    {
+        static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        float points[16][4];
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 4; c++)
+                points[i][c] = texels[4 * i + c];
+
+        std::array<float, 4> mean;
+        auto axis = principal_axis<4>(points, 16, mean);
+        float axis_length2 = 0.f;
+        for (int c = 0; c < 4; c++)
+            axis_length2 += axis[c] * axis[c];
+
+        float min_t = 0.f, max_t = 0.f;
+        if (axis_length2 > 0.f) {
+            min_t = std::numeric_limits<float>::max();
+            max_t = std::numeric_limits<float>::lowest();
+            for (int i = 0; i < 16; i++) {
+                float t = 0.f;
+                for (int c = 0; c < 4; c++)
+                    t += (points[i][c] - mean[c]) * axis[c];
+                min_t = std::min(min_t, t / axis_length2);
+                max_t = std::max(max_t, t / axis_length2);
+            }
+        }
+
+        // Mode 6 endpoints: 7 bits per channel, plus a shared
+        // low bit per endpoint. The low bit is picked to
+        // minimize the quantization error of the endpoint.
+        int endpoints[2][4], pbits[2];
+        for (int e = 0; e < 2; e++)
+        {
+            float t = e == 0 ? min_t : max_t;
+            float target[4];
+            for (int c = 0; c < 4; c++)
+                target[c] = std::clamp(mean[c] + t * axis[c], 0.f, 255.f);
+
+            float best_error = std::numeric_limits<float>::max();
+            for (int p = 0; p < 2; p++) {
+                int quantized[4];
+                float error = 0.f;
+                for (int c = 0; c < 4; c++) {
+                    quantized[c] = std::clamp((int)std::round((target[c] - p) / 2.f), 0, 127);
+                    float d = target[c] - (quantized[c] * 2 + p);
+                    error += d * d;
+                }
+
+                if (error < best_error) {
+                    best_error = error;
+                    pbits[e] = p;
+                    std::memcpy(endpoints[e], quantized, sizeof(quantized));
+                }
+            }
+        }
+
+        // Palette and indices
+        int palette[16][4];
+        for (int w = 0; w < 16; w++) {
+            for (int c = 0; c < 4; c++) {
+                int e0 = endpoints[0][c] * 2 + pbits[0];
+                int e1 = endpoints[1][c] * 2 + pbits[1];
+                palette[w][c] = ((64 - weights[w]) * e0 + weights[w] * e1 + 32) >> 6;
+            }
+        }
+
+        int indices[16];
+        for (int i = 0; i < 16; i++) {
+            int best = 0, best_error = std::numeric_limits<int>::max();
+            for (int w = 0; w < 16; w++) {
+                int error = 0;
+                for (int c = 0; c < 4; c++) {
+                    int d = texels[4 * i + c] - palette[w][c];
+                    error += d * d;
+                }
+                if (error < best_error) {
+                    best = w;
+                    best_error = error;
+                }
+            }
+            indices[i] = best;
+        }
+
+        // The most significant bit of the first index is
+        // implicitly 0: swap the endpoints if it is set.
+        if (indices[0] >= 8) {
+            std::swap(endpoints[0], endpoints[1]);
+            std::swap(pbits[0], pbits[1]);
+            for (auto& index: indices)
+                index = 15 - index;
+        }
+
+        std::memset(block, 0, 16);
+        BitWriter writer {block};
+        writer.write(1 << 6, 7);
+        for (int c = 0; c < 4; c++) {
+            writer.write(endpoints[0][c], 7);
+            writer.write(endpoints[1][c], 7);
+        }
+        writer.write(pbits[0], 1);
+        writer.write(pbits[1], 1);
+
+        writer.write(indices[0], 3);
+        for (int i = 1; i < 16; i++)
+            writer.write(indices[i], 4);
+    }
+
+    //----------- IMAGE -----------//
+
+    std::vector<uint8_t> encode_bc(const uint8_t* rgba, int width, int height, CompressedFormat format)
+    {
+        int blocks_x = std::max((width + 3) / 4, 1);
+        int blocks_y = std::max((height + 3) / 4, 1);
+        uint32_t size = block_size(format);
+
+        std::vector<uint8_t> blocks((size_t)blocks_x * blocks_y * size);
+        parallel_for(blocks_y, [&](size_t begin, size_t end) {
+            uint8_t texels[16 * 4];
+            for (size_t by = begin; by < end; by++) {
+                for (int bx = 0; bx < blocks_x; bx++) {
+                    // Gather the block, clamping at the edges
+                    for (int y = 0; y < 4; y++) {
+                        int sy = std::min<int>(by * 4 + y, height - 1);
+                        for (int x = 0; x < 4; x++) {
+                            int sx = std::min(bx * 4 + x, width - 1);
+                            std::memcpy(&texels[4 * (4 * y + x)], &rgba[4 * ((size_t)sy * width + sx)], 4);
+                        }
+                    }
+
+                    uint8_t* block = &blocks[(by * blocks_x + bx) * size];
+                    switch (format)
+                    {
+                        case CompressedFormat::BC1: encode_bc1_block(texels, block); break;
+                        case CompressedFormat::BC3: encode_bc3_block(texels, block); break;
+                        case CompressedFormat::BC4: encode_bc4_block(texels, block); break;
+                        case CompressedFormat::BC5: encode_bc5_block(texels, block); break;
+                        case CompressedFormat::BC7: encode_bc7_block(texels, block); break;
+                    }
+                }
+            }
+        }, 4);
+
+        return blocks;
+    }
+}
\ No newline at end of file
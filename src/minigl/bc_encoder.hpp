@@ -0,0 +1,28 @@
+#pragma once
+
+#include "core.hpp"
+#include "compressed_texture.hpp"
+
+namespace minigl
+{
+    /// Compress an RGBA8 image into 4x4 blocks of `format`,
+    /// rows of blocks being encoded in parallel. Blocks past
+    /// the edges of the image repeat its last row and column.
+    /// BC4 encodes the red channel, BC5 the red and green
+    /// channels.
+    ///
+    /// The encoders favour speed over the last bit of quality:
+    /// BC1 fits the endpoints on the principal axis of the
+    /// block colors, then refines them by least squares; BC7
+    /// only uses mode 6 (a single RGBA subset with 4-bit
+    /// indices).
+    std::vector<uint8_t> encode_bc(const uint8_t* rgba, int width, int height, CompressedFormat format);
+
+    /// Encode a single block of 16 RGBA8 texels, in row order.
+    /// `block` receives `block_size(format)` bytes.
+    void encode_bc1_block(const uint8_t* texels, uint8_t* block);
+    void encode_bc3_block(const uint8_t* texels, uint8_t* block);
+    void encode_bc4_block(const uint8_t* texels, uint8_t* block, int channel = 0);
+    void encode_bc5_block(const uint8_t* texels, uint8_t* block);
+    void encode_bc7_block(const uint8_t* texels, uint8_t* block);
+}
\ No newline at end of file
@@ -1,4 +1,7 @@
 #include "buffer.hpp"
+#include "render_state.hpp"
+
+#include <cstring>
 
 namespace minigl
 {
@@ -32,6 +35,17 @@ namespace minigl
                    {DataType::Float4, "a_color"}}};
     }
 
+    VertexBuffer::VertexBuffer(const Vertex* vertices, size_t count, DataAccess usage)
+    {
+        create_buffer(vertices, count * sizeof(Vertex), usage);
+
+        this->count = count;
+        layout = {{{DataType::Float3, "a_pos"},
+                   {DataType::Float3, "a_normal"},
+                   {DataType::Float2, "a_tex"},
+                   {DataType::Float4, "a_color"}}};
+    }
+
     VertexBuffer::~VertexBuffer()
     {
         glDeleteBuffers(1, &bufferID);
@@ -49,8 +63,12 @@ namespace minigl
 
     void VertexBuffer::update_vertices(const std::vector<Vertex>& vertices)
     {
-        glBindBuffer(GL_ARRAY_BUFFER, bufferID);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex), &vertices[0]);
+        glNamedBufferSubData(bufferID, 0, vertices.size() * sizeof(Vertex), vertices.data());
+    }
+
+    void VertexBuffer::upload(const void* data, size_t size, size_t offset)
+    {
+        glNamedBufferSubData(bufferID, offset, size, data);
     }
 
     //----------- INDEX BUFFER -----------//
@@ -69,7 +87,9 @@ namespace minigl
 
     IndexBuffer::~IndexBuffer()
     {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        // Deleting the buffer detaches it from the bound
+        // vertex array. Binding 0 here would instead detach
+        // whatever index buffer the bound vertex array uses.
         glDeleteBuffers(1, &idxBufferID);
     }
 
@@ -83,6 +103,11 @@ namespace minigl
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
 
+    void IndexBuffer::upload(const void* data, size_t size, size_t offset)
+    {
+        glNamedBufferSubData(idxBufferID, offset, size, data);
+    }
+
     //----------- VERTEX ARRAY -----------//
 
     VertexArray::VertexArray()
@@ -100,55 +125,78 @@ namespace minigl
 
     void VertexArray::bind() const
     {
-        glBindVertexArray(vtxArrID);
-        for (auto& vb: vertexBuffers)
-        {
-            vb->bind();
-        }
+        // The vertex buffers are attached to the VAO with
+        // glVertexArrayVertexBuffer, there is nothing else to
+        // bind.
+        RenderState::bind_vertex_array(vtxArrID);
     }
 
     void VertexArray::unbind() const
     {
-        for (auto& vb: vertexBuffers)
-        {
-            vb->unbind();
-        }
-        glBindVertexArray(0);
+        RenderState::bind_vertex_array(0);
     }
 
     void VertexArray::add_vertex_buffer(const Ref<VertexBuffer>& vb)
     {
-        int binding = 0;
-        for (auto& vertexBuffer: vertexBuffers)
-        {
-            binding += vertexBuffer->attribute_count();
-        }
-
         // The vertex array is provided the ID of the new
         // vertex buffer, which is bound at the index
         // corresponding to the next possible location after
         // the previous buffers (for example, 2 if a pos|normal
         // buffer is already present), and the stride of the
         // internal layout of the new buffer.
+        uint32_t binding = attributeCount;
         glVertexArrayVertexBuffer(vtxArrID, binding, vb->bufferID, 0, vb->layout.stride);
 
+        set_attributes(binding, vb->layout);
+        attributeCount += vb->attribute_count();
+
+        vertexBuffers.push_back(vb);
+    }
+
+    uint32_t VertexArray::add_layout(const BufferLayout& layout)
+    {
+        uint32_t binding = attributeCount;
+        set_attributes(binding, layout);
+        attributeCount += layout.size();
+
+        return binding;
+    }
+
+    void VertexArray::set_vertex_buffer(uint32_t binding, uint32_t bufferID, size_t offset, uint32_t stride)
+    {
+        glVertexArrayVertexBuffer(vtxArrID, binding, bufferID, offset, stride);
+    }
+
+    void VertexArray::set_attributes(uint32_t binding, const BufferLayout& layout)
+    {
         // For each element in the layout:
-        const auto& layout = vb->layout; 
         for (uint32_t attribute = binding; const auto& element: layout)
         {
             // - Enable the attribute
             glEnableVertexArrayAttrib(vtxArrID, attribute);
             
             // - Set its format (size, type, normalization,
-            //   offset)
-            glVertexArrayAttribFormat(
-                vtxArrID,
-                attribute,
-                element.count(),
-                dataTypeToGLType(element.type),
-                element.normalized ? GL_TRUE : GL_FALSE,
-                element.offset
-            );
+            //   offset). Integers that are not normalized are
+            //   fetched as integers, not converted to floats.
+            if (dataTypeIsInteger(element.type) && !element.normalized) {
+                glVertexArrayAttribIFormat(
+                    vtxArrID,
+                    attribute,
+                    element.count(),
+                    dataTypeToGLType(element.type),
+                    element.offset
+                );
+            }
+            else {
+                glVertexArrayAttribFormat(
+                    vtxArrID,
+                    attribute,
+                    element.count(),
+                    dataTypeToGLType(element.type),
+                    element.normalized ? GL_TRUE : GL_FALSE,
+                    element.offset
+                );
+            }
 
             // - Set the binding divisor for instanced/indirect
             //   rendering
@@ -168,8 +216,6 @@ namespace minigl
 
             attribute++;
         }
-
-        vertexBuffers.push_back(vb);
     }
 
     void VertexArray::set_index_buffer(const Ref<IndexBuffer>& ib)
@@ -180,7 +226,6 @@ namespace minigl
 
     void VertexArray::updateVertices(size_t index, const std::vector<Vertex>& vertices)
     {
-        glBindVertexArray(vtxArrID);
         vertexBuffers[index]->update_vertices(vertices);
     }
 
@@ -310,8 +355,9 @@ namespace minigl
 
     IndirectBuffer::~IndirectBuffer()
     {
+        if (mappedBuffer)
+            glUnmapNamedBuffer(indirectBufferID);
         mappedBuffer = nullptr;
-        glUnmapBuffer(indirectBufferID);
         glDeleteBuffers(1, &indirectBufferID);
     }
 
@@ -348,4 +394,73 @@ namespace minigl
     {
         glBindBuffer(GL_UNIFORM_BUFFER, uboID);
     }
+
+    //----------- STREAM BUFFER -----------//
+
+    StreamBuffer::StreamBuffer(size_t frame_size, uint32_t frame_count):
+        frameSize(frame_size), sync(frame_count)
+    {
+        // Coherent mapping: writes are visible to the GPU
+        // without explicit flushes, so plain memcpy is enough.
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glCreateBuffers(1, &streamBufferID);
+        glNamedBufferStorage(streamBufferID, frame_size * frame_count, nullptr, flags);
+        mappedBuffer = (uint8_t*)glMapNamedBufferRange(streamBufferID, 0, frame_size * frame_count, flags);
+
+        frame = sync.begin_frame();
+    }
+
+    StreamBuffer::~StreamBuffer()
+    {
+        glUnmapNamedBuffer(streamBufferID);
+        glDeleteBuffers(1, &streamBufferID);
+    }
+
+    size_t StreamBuffer::allocate(size_t size, size_t alignment)
+    {
+        // The absolute offset is aligned, since the frame size
+        // need not be a multiple of the alignment.
+        size_t begin = frame * frameSize;
+        size_t offset = (begin + head + alignment - 1) / alignment * alignment;
+        size_t end = begin + frameSize;
+        MGL_ASSERT(offset + size <= end, "Stream buffer frame region overflow ({} bytes requested, {} left).", size, end - std::min(offset, end));
+
+        head = offset + size - begin;
+        return offset;
+    }
+
+    size_t StreamBuffer::write(const void* data, size_t size, size_t alignment)
+    {
+        size_t offset = allocate(size, alignment);
+        std::memcpy(mappedBuffer + offset, data, size);
+
+        return offset;
+    }
+
+    void StreamBuffer::bind_range(GLenum target, uint32_t binding_point, size_t offset, size_t size) const
+    {
+        glBindBufferRange(target, binding_point, streamBufferID, offset, size);
+    }
+
+    void StreamBuffer::bind_vertices(VertexArray& vertexArray, uint32_t binding, size_t offset, uint32_t stride) const
+    {
+        vertexArray.set_vertex_buffer(binding, streamBufferID, offset, stride);
+    }
+
+    void StreamBuffer::next_frame()
+    {
+        // Fence the commands reading the current region, then
+        // wait for the GPU to be done with the next one.
+        sync.end_frame();
+        frame = sync.begin_frame();
+        head = 0;
+    }
+
+    size_t StreamBuffer::uniform_alignment()
+    {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        return alignment;
+    }
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "geometry.hpp"
 #include "color.hpp"
 #include "texture.hpp"
+#include "sync.hpp"
 
 #include <glad/glad.h>
 
@@ -16,7 +17,17 @@ namespace minigl
         None = 0,
         Float, Float2, Float3, Float4,
         Int, Int2, Int3, Int4,
-        Mat2, Mat4
+        Mat2, Mat4,
+
+        /// 16-bit floats
+        Half, Half2, Half4,
+        /// 8 and 16-bit integers, usually normalized (see
+        /// `BufferElement::normalized`)
+        Byte2, Byte4, UByte2, UByte4,
+        Short2, Short4, UShort2, UShort4,
+        /// Four components packed in 32 bits: 10 bits for x, y
+        /// and z, 2 bits for w (`GL_INT_2_10_10_10_REV`)
+        Int10_10_10_2, UInt10_10_10_2
     };
 
     /// Get the DataType type size in bytes
@@ -37,6 +48,23 @@ namespace minigl
             case DataType::Mat2: return 4 * 2 * 2;
             case DataType::Mat4: return 4 * 4 * 4;
 
+            case DataType::Half: return 2;
+            case DataType::Half2: return 2 * 2;
+            case DataType::Half4: return 2 * 4;
+
+            case DataType::Byte2: return 2;
+            case DataType::Byte4: return 4;
+            case DataType::UByte2: return 2;
+            case DataType::UByte4: return 4;
+
+            case DataType::Short2: return 2 * 2;
+            case DataType::Short4: return 2 * 4;
+            case DataType::UShort2: return 2 * 2;
+            case DataType::UShort4: return 2 * 4;
+
+            case DataType::Int10_10_10_2: return 4;
+            case DataType::UInt10_10_10_2: return 4;
+
             case DataType::None: break;
         }
 
@@ -62,6 +90,23 @@ namespace minigl
             case DataType::Mat2: break;
             case DataType::Mat4: break;
 
+            case DataType::Half: return GL_HALF_FLOAT;
+            case DataType::Half2: return GL_HALF_FLOAT;
+            case DataType::Half4: return GL_HALF_FLOAT;
+
+            case DataType::Byte2: return GL_BYTE;
+            case DataType::Byte4: return GL_BYTE;
+            case DataType::UByte2: return GL_UNSIGNED_BYTE;
+            case DataType::UByte4: return GL_UNSIGNED_BYTE;
+
+            case DataType::Short2: return GL_SHORT;
+            case DataType::Short4: return GL_SHORT;
+            case DataType::UShort2: return GL_UNSIGNED_SHORT;
+            case DataType::UShort4: return GL_UNSIGNED_SHORT;
+
+            case DataType::Int10_10_10_2: return GL_INT_2_10_10_10_REV;
+            case DataType::UInt10_10_10_2: return GL_UNSIGNED_INT_2_10_10_10_REV;
+
             case DataType::None: break;
         }
 
@@ -69,6 +114,23 @@ namespace minigl
         return -1;
     }
 
+    /// Whether the DataType holds integers that can reach
+    /// shaders as integers (`int`, `ivec` or `uvec`). The
+    /// packed 10_10_10_2 formats can only be read as floats.
+    static bool dataTypeIsInteger(DataType type)
+    {
+        switch (type)
+        {
+            case DataType::Int: case DataType::Int2: case DataType::Int3: case DataType::Int4:
+            case DataType::Byte2: case DataType::Byte4: case DataType::UByte2: case DataType::UByte4:
+            case DataType::Short2: case DataType::Short4: case DataType::UShort2: case DataType::UShort4:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
     /// Group of tightly packed data in the vertex buffer at a
     /// given offset, corresponding to an attribute.
     struct BufferElement
@@ -83,7 +145,10 @@ namespace minigl
         size_t size;
         /// If true, values stored in an integer format will be
         /// normalized to a value in the range [-1, 1] (signed)
-        /// or [0, 1] (unsigned).
+        /// or [0, 1] (unsigned). If false, they reach the
+        /// shader as integers (`int`, `ivec` or `uvec`
+        /// inputs), except the packed 10_10_10_2 formats, which
+        /// are converted to floats.
         bool normalized;
         /// When using indirect rendering, the divisor
         /// specifies the instancing rate of the buffer
@@ -114,6 +179,23 @@ namespace minigl
                 case DataType::Int3: return 3;
                 case DataType::Int4: return 4;
 
+                case DataType::Half: return 1;
+                case DataType::Half2: return 2;
+                case DataType::Half4: return 4;
+
+                case DataType::Byte2: return 2;
+                case DataType::Byte4: return 4;
+                case DataType::UByte2: return 2;
+                case DataType::UByte4: return 4;
+
+                case DataType::Short2: return 2;
+                case DataType::Short4: return 4;
+                case DataType::UShort2: return 2;
+                case DataType::UShort4: return 4;
+
+                case DataType::Int10_10_10_2: return 4;
+                case DataType::UInt10_10_10_2: return 4;
+
                 case DataType::None: break;
             }
 
@@ -225,6 +307,12 @@ namespace minigl
             /// `[pos, normal, tex, color]`.
             explicit VertexBuffer(const std::vector<Vertex>& vertices, DataAccess usage = DataAccess::Static);
 
+            /// Create a vertex buffer from `count` vertices
+            /// stored at `vertices`, which can point to any
+            /// memory (e.g. a mapped file). Its layout is set
+            /// to `[pos, normal, tex, color]`.
+            VertexBuffer(const Vertex* vertices, size_t count, DataAccess usage = DataAccess::Static);
+
             /// Create a vertex buffer from a buffer of
             /// vertices with a custom layout.
             template<typename vertex_t>
@@ -247,6 +335,11 @@ namespace minigl
             /// Update the vertices of the vertex buffer.
             void update_vertices(const std::vector<Vertex>& vertices);
 
+            /// Upload `size` bytes of `data` at `offset` bytes
+            /// into the buffer. The buffer must have been
+            /// created with `DataAccess::Dynamic`.
+            void upload(const void* data, size_t size, size_t offset = 0);
+
             virtual const BufferLayout& getLayout() const { return layout; }
             virtual void setLayout(const BufferLayout& layout) { this->layout = layout; }
     };
@@ -294,6 +387,11 @@ namespace minigl
             void bind() const;
             void unbind() const;
 
+            /// Upload `size` bytes of `data` at `offset` bytes
+            /// into the buffer. The buffer must have been
+            /// created with `DataAccess::Dynamic`.
+            void upload(const void* data, size_t size, size_t offset = 0);
+
             inline uint32_t getCount() const { return count; }
     };
 
@@ -319,8 +417,19 @@ namespace minigl
             void add_vertex_buffer(const Ref<VertexBuffer>& vb);
             void set_index_buffer(const Ref<IndexBuffer>& ib);
 
-            /// Get the number of indices in the index buffer.
-            inline uint32_t index_count() const { return indexBuffer->getCount(); }
+            /// Declare the attributes of a vertex buffer that is
+            /// not owned by the vertex array (e.g. a region of a
+            /// `StreamBuffer`), and return the binding index to
+            /// attach it to with `set_vertex_buffer()`.
+            uint32_t add_layout(const BufferLayout& layout);
+
+            /// Attach the buffer `bufferID`, starting at
+            /// `offset` bytes, to the given binding index.
+            void set_vertex_buffer(uint32_t binding, uint32_t bufferID, size_t offset, uint32_t stride);
+
+            /// Get the number of indices in the index buffer
+            /// (0 without an index buffer).
+            inline uint32_t index_count() const { return indexBuffer ? indexBuffer->getCount() : 0; }
 
             /// Update the vertices of the vertex buffer.
             void updateVertices(size_t index, const std::vector<Vertex>& vertices);
@@ -330,6 +439,16 @@ namespace minigl
             uint32_t vtxArrID;
             std::vector<Ref<VertexBuffer>> vertexBuffers;
             Ref<IndexBuffer> indexBuffer;
+
+            /// Number of attributes declared so far. A new
+            /// buffer is bound at the index of its first
+            /// attribute.
+            uint32_t attributeCount = 0;
+
+            /// Set the format of the attributes of `layout`,
+            /// starting at the attribute `binding`, and attach
+            /// them to the given binding index.
+            void set_attributes(uint32_t binding, const BufferLayout& layout);
     };
 
     enum BufferBit: GLenum
@@ -430,7 +549,7 @@ namespace minigl
         public:
 
             uint32_t indirectBufferID;
-            DrawCommand* mappedBuffer;
+            DrawCommand* mappedBuffer = nullptr;
             uint32_t size;
     };
 
@@ -518,4 +637,81 @@ namespace minigl
                     mappedBuffer = (buffer_t*)glMapNamedBufferRange(ssboID, 0, size, (GLenum)usage);
             }
     };
+
+    /// Ring buffer for data written by the CPU every frame
+    /// (dynamic vertices, uniforms, instance data...). The
+    /// buffer is persistently and coherently mapped, and split
+    /// into one region per frame in flight: the CPU writes into
+    /// the region of the current frame with plain memcpy while
+    /// the GPU reads the regions of the previous frames. A
+    /// fence guards each region, so that it is only reused
+    /// once the GPU is done with it, without any implicit
+    /// driver synchronization (unlike `glBufferSubData`).
+    class StreamBuffer
+    {
+        public:
+
+            /// Create a stream buffer of `frame_count` regions
+            /// of `frame_size` bytes each.
+            StreamBuffer(size_t frame_size, uint32_t frame_count = 3);
+
+            /// Destructor: unmaps and deletes the buffer.
+            virtual ~StreamBuffer();
+
+            StreamBuffer(const StreamBuffer&) = delete;
+            StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+            /// Reserve `size` bytes in the region of the current
+            /// frame, aligned to `alignment` bytes, and return
+            /// their offset in the buffer. Write to them through
+            /// `data()`.
+            size_t allocate(size_t size, size_t alignment = 16);
+
+            /// Copy `size` bytes of `data` into the region of
+            /// the current frame, and return their offset in
+            /// the buffer.
+            size_t write(const void* data, size_t size, size_t alignment = 16);
+
+            template<typename T>
+            size_t write(const std::vector<T>& data, size_t alignment = 16)
+            {
+                return write(data.data(), data.size() * sizeof(T), alignment);
+            }
+
+            /// Pointer to the mapped memory at `offset` bytes.
+            void* data(size_t offset) const { return mappedBuffer + offset; }
+
+            /// Bind `size` bytes at `offset` to an indexed
+            /// target (`GL_UNIFORM_BUFFER`,
+            /// `GL_SHADER_STORAGE_BUFFER`...).
+            void bind_range(GLenum target, uint32_t binding_point, size_t offset, size_t size) const;
+
+            /// Attach the data at `offset` to a binding index of
+            /// a vertex array (see `VertexArray::add_layout()`).
+            void bind_vertices(VertexArray& vertexArray, uint32_t binding, size_t offset, uint32_t stride) const;
+
+            /// Mark the end of the current frame: fence its
+            /// region, and move to the next one, waiting for
+            /// the GPU to finish reading it if needed. Call once
+            /// per frame, after the draw calls that read the
+            /// buffer.
+            void next_frame();
+
+            /// Minimum alignment of the offsets bound to
+            /// `GL_UNIFORM_BUFFER`.
+            static size_t uniform_alignment();
+
+        public:
+
+            uint32_t streamBufferID;
+
+        private:
+
+            uint8_t* mappedBuffer;
+            size_t frameSize;
+
+            uint32_t frame = 0;
+            size_t head = 0;
+            FrameSync sync;
+    };
 }
\ No newline at end of file
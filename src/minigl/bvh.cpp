@@ -0,0 +1,514 @@
+#include "bvh.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <mutex>
+
+namespace minigl
+{
+    /// Number of bins of the SAH evaluation
+    constexpr uint32_t BIN_COUNT = 16;
+
+    /// Nodes with more primitives are binned in parallel
+    constexpr uint32_t PARALLEL_BINNING = 1 << 16;
+
+    /// Nodes with more primitives build their children in
+    /// parallel
+    constexpr uint32_t PARALLEL_SUBTREE = 1 << 12;
+
+    static float surface_area(const AABB& box)
+    {
+        if (box.empty())
+            return 0.f;
+
+        Vec3 d = box.max - box.min;
+        return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    struct Bin
+    {
+        AABB bounds;
+        uint32_t count = 0;
+    };
+
+    /// Bins of the three axes, plus the bounds they were
+    /// computed for
+    struct Binning
+    {
+        std::array<std::array<Bin, BIN_COUNT>, 3> bins {};
+
+        void merge(const Binning& other)
+        {
+            for (int axis = 0; axis < 3; axis++) {
+                for (uint32_t b = 0; b < BIN_COUNT; b++) {
+                    bins[axis][b].bounds.expand(other.bins[axis][b].bounds);
+                    bins[axis][b].count += other.bins[axis][b].count;
+                }
+            }
+        }
+    };
+
+    /// State of a build
+    struct BVHBuilder
+    {
+        const std::vector<AABB>& boxes;
+        std::vector<Vec3> centroids;
+        std::vector<BVHNode>& nodes;
+        std::vector<uint32_t>& primitives;
+        std::atomic<uint32_t> nodeCount = 1;
+        bool parallel;
+
+        /// Run `func(begin, end)` over `[first, first +
+        /// count)`, in parallel for large ranges
+        template<typename F>
+        void for_range(uint32_t first, uint32_t count, F&& func)
+        {
+            if (parallel && count >= PARALLEL_BINNING) {
+                parallel_for(count, [&](size_t begin, size_t end) {
+                    func(first + (uint32_t)begin, first + (uint32_t)end);
+                }, PARALLEL_BINNING / 4);
+            }
+            else {
+                func(first, first + count);
+            }
+        }
+
+        /// Bounds of the boxes and of the centroids of the
+        /// primitives `[first, first + count)`
+        void compute_bounds(uint32_t first, uint32_t count, AABB& bounds, AABB& centroid_bounds)
+        {
+            std::mutex mutex;
+            for_range(first, count, [&](uint32_t begin, uint32_t end) {
+                AABB b {}, c {};
+                for (uint32_t i = begin; i < end; i++) {
+                    b.expand(boxes[primitives[i]]);
+                    c.expand(centroids[primitives[i]]);
+                }
+
+                std::lock_guard lock {mutex};
+                bounds.expand(b);
+                centroid_bounds.expand(c);
+            });
+        }
+
+        void build_node(uint32_t index, uint32_t first, uint32_t count, uint32_t depth)
+        {
+            AABB bounds {}, centroid_bounds {};
+            compute_bounds(first, count, bounds, centroid_bounds);
+
+            auto& node = nodes[index];
+            node.min = bounds.min;
+            node.max = bounds.max;
+
+            auto make_leaf = [&]() {
+                node.first = first;
+                node.count = count;
+            };
+
+            if (count <= 1 || depth >= BVH::MAX_DEPTH) {
+                make_leaf();
+                return;
+            }
+
+            // Bin the centroids along each axis
+            Vec3 extent = centroid_bounds.max - centroid_bounds.min;
+            Vec3 scale {0.f};
+            for (int axis = 0; axis < 3; axis++)
+                scale[axis] = extent[axis] > 0.f ? BIN_COUNT / extent[axis] : 0.f;
+
+            auto bin_index = [&](uint32_t primitive, int axis) {
+                float offset = (centroids[primitive][axis] - centroid_bounds.min[axis]) * scale[axis];
+                return std::min((uint32_t)offset, BIN_COUNT - 1);
+            };
+
+            Binning binning {};
+            std::mutex mutex;
+            for_range(first, count, [&](uint32_t begin, uint32_t end) {
+                Binning local {};
+                for (uint32_t i = begin; i < end; i++) {
+                    uint32_t primitive = primitives[i];
+                    for (int axis = 0; axis < 3; axis++) {
+                        if (scale[axis] == 0.f)
+                            continue;
+
+                        auto& bin = local.bins[axis][bin_index(primitive, axis)];
+                        bin.bounds.expand(boxes[primitive]);
+                        bin.count++;
+                    }
+                }
+
+                std::lock_guard lock {mutex};
+                binning.merge(local);
+            });
+
+            // Evaluate the SAH cost of the split after each bin,
+            // by sweeping from both ends
+            float best_cost = std::numeric_limits<float>::max();
+            int best_axis = -1;
+            uint32_t best_split = 0;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (scale[axis] == 0.f)
+                    continue;
+
+                auto& bins = binning.bins[axis];
+                std::array<float, BIN_COUNT> right_cost {};
+
+                AABB right {};
+                uint32_t right_count = 0;
+                for (uint32_t b = BIN_COUNT - 1; b > 0; b--) {
+                    right.expand(bins[b].bounds);
+                    right_count += bins[b].count;
+                    right_cost[b] = surface_area(right) * right_count;
+                }
+
+                AABB left {};
+                uint32_t left_count = 0;
+                for (uint32_t b = 0; b < BIN_COUNT - 1; b++) {
+                    left.expand(bins[b].bounds);
+                    left_count += bins[b].count;
+                    if (left_count == 0 || left_count == count)
+                        continue;
+
+                    float cost = surface_area(left) * left_count + right_cost[b+1];
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_split = b + 1;
+                    }
+                }
+            }
+
+            uint32_t left_count;
+            if (best_axis < 0) {
+                // All the centroids are at the same position:
+                // split in the middle if the leaf is too large.
+                if (count <= BVH::MAX_LEAF_SIZE) {
+                    make_leaf();
+                    return;
+                }
+
+                left_count = count / 2;
+            }
+            else {
+                // Traversing the node tests the boxes of its two
+                // children, which costs about as much as testing
+                // two primitive boxes.
+                float area = surface_area(bounds);
+                float split_cost = 2.f + (area > 0.f ? best_cost / area : 0.f);
+                if (split_cost >= count && count <= BVH::MAX_LEAF_SIZE) {
+                    make_leaf();
+                    return;
+                }
+
+                auto begin = primitives.begin() + first;
+                auto middle = std::partition(begin, begin + count, [&](uint32_t primitive) {
+                    return bin_index(primitive, best_axis) < best_split;
+                });
+                left_count = middle - begin;
+            }
+
+            uint32_t left = nodeCount.fetch_add(2);
+            node.first = left;
+            node.count = 0;
+
+            // `node` may not be accessed past this point: the
+            // children are written concurrently.
+            if (parallel && count >= PARALLEL_SUBTREE)
+            {
+                auto& pool = ThreadPool::global();
+                auto future = pool.submit([=, this]() {
+                    build_node(left, first, left_count, depth + 1);
+                });
+
+                build_node(left + 1, first + left_count, count - left_count, depth + 1);
+
+                // Help with the pending tasks instead of
+                // blocking a worker
+                while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    if (!pool.run_pending_task())
+                        std::this_thread::yield();
+                }
+            }
+            else
+            {
+                build_node(left, first, left_count, depth + 1);
+                build_node(left + 1, first + left_count, count - left_count, depth + 1);
+            }
+        }
+    };
+
+    void BVH::build(const std::vector<AABB>& boxes, bool parallel)
+    {
+        nodeList.clear();
+        primitiveList.clear();
+        primitiveBoxes.clear();
+        if (boxes.empty())
+            return;
+
+        uint32_t count = boxes.size();
+
+        // A binary tree with at most one primitive per leaf
+        // has at most 2n - 1 nodes.
+        nodeList.resize(2 * count);
+        primitiveList.resize(count);
+
+        BVHBuilder builder {
+            .boxes = boxes,
+            .centroids = std::vector<Vec3>(count),
+            .nodes = nodeList,
+            .primitives = primitiveList,
+            .parallel = parallel
+        };
+
+        auto init = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                primitiveList[i] = i;
+                builder.centroids[i] = boxes[i].center();
+            }
+        };
+
+        if (parallel)
+            parallel_for(count, init, PARALLEL_BINNING / 4);
+        else
+            init(0, count);
+
+        builder.build_node(0, 0, count, 0);
+        nodeList.resize(builder.nodeCount);
+
+        primitiveBoxes.resize(count);
+        for (uint32_t i = 0; i < count; i++)
+            primitiveBoxes[i] = boxes[primitiveList[i]];
+    }
+
+    void BVH::refit(const std::vector<AABB>& boxes)
+    {
+        MGL_ASSERT(boxes.size() == primitiveList.size(), "Refitting a BVH with a different number of primitives");
+
+        // Children are always stored after their parent, so a
+        // reverse sweep updates them first.
+        for (size_t i = nodeList.size(); i-- > 0;)
+        {
+            auto& node = nodeList[i];
+
+            AABB bounds {};
+            if (node.leaf()) {
+                for (uint32_t p = node.first; p < node.first + node.count; p++) {
+                    primitiveBoxes[p] = boxes[primitiveList[p]];
+                    bounds.expand(primitiveBoxes[p]);
+                }
+            }
+            else {
+                auto& left = nodeList[node.first];
+                auto& right = nodeList[node.first + 1];
+                bounds.expand(AABB { .min = left.min, .max = left.max });
+                bounds.expand(AABB { .min = right.min, .max = right.max });
+            }
+
+            node.min = bounds.min;
+            node.max = bounds.max;
+        }
+    }
+
+    /// Fixed-size traversal stack. The depth of the tree is
+    /// bounded, and each level pushes at most one node.
+    template<typename T>
+    struct TraversalStack
+    {
+        std::array<T, 2 * BVH::MAX_DEPTH + 2> items;
+        uint32_t size = 0;
+
+        void push(const T& item) { items[size++] = item; }
+        T pop() { return items[--size]; }
+        bool empty() const { return size == 0; }
+    };
+
+    /// Append all the primitives of the subtree of `root`
+    static void collect(const std::vector<BVHNode>& nodes, const std::vector<uint32_t>& primitives,
+                        uint32_t root, std::vector<uint32_t>& result)
+    {
+        TraversalStack<uint32_t> stack {};
+        stack.push(root);
+        while (!stack.empty())
+        {
+            auto& node = nodes[stack.pop()];
+            if (node.leaf()) {
+                result.insert(result.end(), primitives.begin() + node.first, primitives.begin() + node.first + node.count);
+            }
+            else {
+                stack.push(node.first);
+                stack.push(node.first + 1);
+            }
+        }
+    }
+
+    template<typename F>
+    void BVH::add_leaf(const BVHNode& leaf, std::vector<uint32_t>& result, F&& test) const
+    {
+        for (uint32_t p = leaf.first; p < leaf.first + leaf.count; p++)
+            if (test(primitiveBoxes[p]))
+                result.push_back(primitiveList[p]);
+    }
+
+    void BVH::query(const Frustum& frustum, std::vector<uint32_t>& result) const
+    {
+        if (empty())
+            return;
+
+        TraversalStack<uint32_t> stack {};
+        stack.push(0);
+        while (!stack.empty())
+        {
+            uint32_t index = stack.pop();
+            auto& node = nodeList[index];
+
+            Vec3 center = (node.min + node.max) * 0.5f;
+            Vec3 extent = (node.max - node.min) * 0.5f;
+
+            bool outside = false, inside = true;
+            for (auto& plane: frustum.planes) {
+                Vec3 normal {plane.x, plane.y, plane.z};
+                float distance = glm::dot(normal, center) + plane.w;
+                float radius = glm::dot(extent, glm::abs(normal));
+
+                if (distance + radius < 0.f) {
+                    outside = true;
+                    break;
+                }
+                if (distance - radius < 0.f)
+                    inside = false;
+            }
+
+            if (outside)
+                continue;
+
+            // Nodes fully inside the frustum need no more
+            // tests.
+            if (inside) {
+                collect(nodeList, primitiveList, index, result);
+            }
+            else if (node.leaf()) {
+                add_leaf(node, result, [&](const AABB& box) { return frustum.intersects(box); });
+            }
+            else {
+                stack.push(node.first);
+                stack.push(node.first + 1);
+            }
+        }
+    }
+
+    void BVH::query(const AABB& range, std::vector<uint32_t>& result) const
+    {
+        if (empty())
+            return;
+
+        auto overlaps = [&](const Vec3& min, const Vec3& max) {
+            return min.x <= range.max.x && max.x >= range.min.x
+                && min.y <= range.max.y && max.y >= range.min.y
+                && min.z <= range.max.z && max.z >= range.min.z;
+        };
+
+        TraversalStack<uint32_t> stack {};
+        stack.push(0);
+        while (!stack.empty())
+        {
+            auto& node = nodeList[stack.pop()];
+            if (!overlaps(node.min, node.max))
+                continue;
+
+            if (node.leaf()) {
+                add_leaf(node, result, [&](const AABB& box) { return overlaps(box.min, box.max); });
+            }
+            else {
+                stack.push(node.first);
+                stack.push(node.first + 1);
+            }
+        }
+    }
+
+    /// Distance at which the ray enters the box (slab test),
+    /// or infinity if it misses it
+    static float ray_box(const Vec3& origin, const Vec3& inv_direction, const Vec3& min, const Vec3& max, float max_distance)
+    {
+        float tmin = 0.f, tmax = max_distance;
+        for (int axis = 0; axis < 3; axis++) {
+            float t0 = (min[axis] - origin[axis]) * inv_direction[axis];
+            float t1 = (max[axis] - origin[axis]) * inv_direction[axis];
+            tmin = std::max(tmin, std::min(t0, t1));
+            tmax = std::min(tmax, std::max(t0, t1));
+        }
+
+        return tmin <= tmax ? tmin : std::numeric_limits<float>::infinity();
+    }
+
+    RayHit BVH::raycast(const Ray& ray, float max_distance, const std::function<float(uint32_t)>& intersect) const
+    {
+        RayHit hit {};
+        hit.distance = max_distance;
+        if (empty())
+            return RayHit {};
+
+        Vec3 inv_direction = Vec3{1.f} / ray.direction;
+
+        struct Entry
+        {
+            uint32_t node;
+            float distance;
+        };
+
+        TraversalStack<Entry> stack {};
+        float root_distance = ray_box(ray.origin, inv_direction, nodeList[0].min, nodeList[0].max, max_distance);
+        if (root_distance != std::numeric_limits<float>::infinity())
+            stack.push({ 0, root_distance });
+
+        while (!stack.empty())
+        {
+            auto [index, distance] = stack.pop();
+
+            // A closer hit was found since the node was pushed
+            if (distance > hit.distance)
+                continue;
+
+            auto& node = nodeList[index];
+            if (node.leaf())
+            {
+                for (uint32_t p = node.first; p < node.first + node.count; p++)
+                {
+                    uint32_t primitive = primitiveList[p];
+                    auto& box = primitiveBoxes[p];
+
+                    // Skip the exact test if the box is missed
+                    float d = ray_box(ray.origin, inv_direction, box.min, box.max, hit.distance);
+                    if (d != std::numeric_limits<float>::infinity() && intersect)
+                        d = intersect(primitive);
+
+                    if (d < hit.distance) {
+                        hit.distance = d;
+                        hit.primitive = primitive;
+                    }
+                }
+                continue;
+            }
+
+            // Visit the closest child first
+            uint32_t near = node.first, far = node.first + 1;
+            float near_distance = ray_box(ray.origin, inv_direction, nodeList[near].min, nodeList[near].max, hit.distance);
+            float far_distance = ray_box(ray.origin, inv_direction, nodeList[far].min, nodeList[far].max, hit.distance);
+            if (far_distance < near_distance) {
+                std::swap(near, far);
+                std::swap(near_distance, far_distance);
+            }
+
+            if (far_distance != std::numeric_limits<float>::infinity())
+                stack.push({ far, far_distance });
+            if (near_distance != std::numeric_limits<float>::infinity())
+                stack.push({ near, near_distance });
+        }
+
+        if (!hit.hit())
+            return RayHit {};
+
+        return hit;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "core.hpp"
+#include "geometry.hpp"
+
+namespace minigl
+{
+    /// Node of a `BVH`, 32 bytes so that two sibling nodes
+    /// share a cache line.
+    struct BVHNode
+    {
+        Vec3 min;
+        /// Leaf: index of the first primitive in
+        /// `BVH::primitives()`. Internal node: index of the
+        /// left child, the right child being the next node.
+        uint32_t first;
+        Vec3 max;
+        /// Number of primitives of a leaf, 0 for internal
+        /// nodes
+        uint32_t count;
+
+        bool leaf() const { return count > 0; }
+    };
+
+    /// Result of `BVH::raycast()`
+    struct RayHit
+    {
+        static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+        uint32_t primitive = NONE;
+        float distance = std::numeric_limits<float>::infinity();
+
+        bool hit() const { return primitive != NONE; }
+    };
+
+    /// Bounding volume hierarchy over a set of primitives
+    /// (meshes, instances...) given by their bounding boxes,
+    /// for spatial queries: frustum culling, ray picking and
+    /// range queries.
+    ///
+    /// The tree is built top-down with the surface area
+    /// heuristic, evaluated on bins of primitive centroids;
+    /// large subtrees are built in parallel. Nodes are stored
+    /// flat in a single array, with siblings next to each
+    /// other, and traversed with an explicit stack. Moving
+    /// primitives are handled with `refit()`, which keeps the
+    /// topology and only updates the bounds.
+    class BVH
+    {
+        public:
+
+            /// Maximum number of primitives in a leaf
+            static constexpr uint32_t MAX_LEAF_SIZE = 8;
+
+            /// Maximum depth of the tree: deeper nodes are
+            /// turned into leaves, whatever their size.
+            static constexpr uint32_t MAX_DEPTH = 64;
+
+            BVH() = default;
+            explicit BVH(const std::vector<AABB>& boxes, bool parallel = true) { build(boxes, parallel); }
+
+            /// Build the tree over `boxes`. Primitives are
+            /// identified by their index in `boxes`.
+            void build(const std::vector<AABB>& boxes, bool parallel = true);
+
+            /// Update the bounds of the tree after the boxes
+            /// moved. The number of boxes must not change. The
+            /// tree quality degrades as the primitives move
+            /// away from their initial positions: rebuild it
+            /// from time to time.
+            void refit(const std::vector<AABB>& boxes);
+
+            /// Append the primitives whose box intersects the
+            /// frustum to `result`.
+            void query(const Frustum& frustum, std::vector<uint32_t>& result) const;
+
+            /// Append the primitives whose box intersects
+            /// `range` to `result`.
+            void query(const AABB& range, std::vector<uint32_t>& result) const;
+
+            /// Find the closest primitive hit by the ray, at
+            /// most at `max_distance`. By default a primitive
+            /// is hit when its box is; pass `intersect` to test
+            /// the actual primitive: it returns the distance
+            /// along the ray of the hit, or infinity if there is
+            /// none.
+            RayHit raycast(const Ray& ray,
+                           float max_distance = std::numeric_limits<float>::infinity(),
+                           const std::function<float(uint32_t)>& intersect = {}) const;
+
+            const std::vector<BVHNode>& nodes() const { return nodeList; }
+
+            /// Primitive indices, referenced by the leaves
+            const std::vector<uint32_t>& primitives() const { return primitiveList; }
+
+            bool empty() const { return nodeList.empty(); }
+
+        private:
+
+            std::vector<BVHNode> nodeList;
+            std::vector<uint32_t> primitiveList;
+
+            /// Boxes of the primitives, in the order of
+            /// `primitiveList`, so that the leaves read them
+            /// contiguously
+            std::vector<AABB> primitiveBoxes;
+
+            /// Append the primitives of a leaf whose box passes
+            /// `test`
+            template<typename F>
+            void add_leaf(const BVHNode& leaf, std::vector<uint32_t>& result, F&& test) const;
+    };
+}
\ No newline at end of file
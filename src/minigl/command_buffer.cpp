@@ -0,0 +1,239 @@
+#include "command_buffer.hpp"
+#include "render_state.hpp"
+#include "thread_pool.hpp"
+
+#include <cstring>
+
+namespace minigl
+{
+    /// Order-preserving 31-bit quantization of a depth: the bit
+    /// patterns of positive floats sort like their values.
+    static uint64_t depth_bits(float depth)
+    {
+        depth = std::max(depth, 0.f);
+
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> 1;
+    }
+
+    uint64_t SortKey::pack() const
+    {
+        uint64_t key = (uint64_t)(pass & 0xF) << 60
+                     | (uint64_t)translucent << 59;
+
+        uint64_t program_bits = program & 0xFFF;
+        uint64_t material_bits = material & 0xFFFF;
+        uint64_t depth = depth_bits(this->depth);
+
+        if (translucent) {
+            // Back to front
+            key |= (0x7FFFFFFF - depth) << 28
+                 | program_bits << 16
+                 | material_bits;
+        }
+        else {
+            key |= program_bits << 47
+                 | material_bits << 31
+                 | depth;
+        }
+
+        return key;
+    }
+
+    //----------- COMMAND CONTEXT -----------//
+
+    void CommandContext::draw(const SortKey& key, const DrawPacket& packet)
+    {
+        draw(key.pack(), packet);
+    }
+
+    void CommandContext::draw(uint64_t key, const DrawPacket& packet)
+    {
+        MGL_ASSERT(packet.shader && packet.vertexArray, "Draw packet without a shader or a vertex array");
+
+        keys.push_back(key);
+        packets.push_back(packet);
+    }
+
+    void CommandContext::clear()
+    {
+        keys.clear();
+        packets.clear();
+    }
+
+    //----------- COMMAND BUFFER -----------//
+
+    void CommandBuffer::draw(const SortKey& key, const DrawPacket& packet)
+    {
+        main.draw(key, packet);
+    }
+
+    void CommandBuffer::draw(uint64_t key, const DrawPacket& packet)
+    {
+        main.draw(key, packet);
+    }
+
+    CommandContext& CommandBuffer::context(size_t index)
+    {
+        if (index >= contexts.size())
+            contexts.resize(index + 1);
+
+        return contexts[index];
+    }
+
+    void CommandBuffer::record(size_t count,
+                               const std::function<void(CommandContext&, size_t, size_t)>& func,
+                               size_t min_chunk)
+    {
+        if (count == 0)
+            return;
+
+        // One context per chunk: chunks are recorded by
+        // whichever thread picks them up, but always land in
+        // the same context, so the recording order does not
+        // depend on the scheduling.
+        size_t chunk_count = std::min((count + min_chunk - 1) / std::max<size_t>(min_chunk, 1),
+                                      ThreadPool::global().size() * 4);
+        chunk_count = std::max<size_t>(chunk_count, 1);
+        size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+        chunk_count = (count + chunk_size - 1) / chunk_size;
+
+        // Fresh contexts, never handed out by `context()` nor
+        // by a previous call: a caller may still be recording
+        // in those. They are reused after the next `clear()`.
+        size_t first = recordUsed;
+        recordUsed += chunk_count;
+        if (recordContexts.size() < recordUsed)
+            recordContexts.resize(recordUsed);
+
+        parallel_for(chunk_count, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++)
+                func(recordContexts[first + c], c * chunk_size, std::min((c + 1) * chunk_size, count));
+        });
+    }
+
+    size_t CommandBuffer::size() const
+    {
+        size_t size = main.size();
+        for (auto& context: contexts)
+            size += context.size();
+        for (size_t i = 0; i < recordUsed; i++)
+            size += recordContexts[i].size();
+
+        return size;
+    }
+
+    void CommandBuffer::clear()
+    {
+        main.clear();
+        for (auto& context: contexts)
+            context.clear();
+        for (size_t i = 0; i < recordUsed; i++)
+            recordContexts[i].clear();
+
+        recordUsed = 0;
+        items.clear();
+    }
+
+    void CommandBuffer::gather()
+    {
+        items.clear();
+        items.reserve(size());
+
+        auto add = [this](const CommandContext& context) {
+            for (size_t i = 0; i < context.size(); i++)
+                items.push_back({ context.keys[i], &context.packets[i] });
+        };
+
+        add(main);
+        for (auto& context: contexts)
+            add(context);
+        for (size_t i = 0; i < recordUsed; i++)
+            add(recordContexts[i]);
+    }
+
+    void CommandBuffer::sort()
+    {
+        // LSD radix sort on bytes, which is stable and linear
+        // in the number of draws. Passes on bytes which are the
+        // same for all the keys (often the pass and the high
+        // depth bits) are skipped.
+        scratch.resize(items.size());
+
+        std::array<std::array<uint32_t, 256>, 8> histograms {};
+        for (auto& item: items)
+            for (int byte = 0; byte < 8; byte++)
+                histograms[byte][(item.key >> (8*byte)) & 0xFF]++;
+
+        for (int byte = 0; byte < 8; byte++)
+        {
+            auto& histogram = histograms[byte];
+            uint32_t first = (items[0].key >> (8*byte)) & 0xFF;
+            if (histogram[first] == items.size())
+                continue;
+
+            std::array<uint32_t, 256> offsets {};
+            for (uint32_t b = 1; b < 256; b++)
+                offsets[b] = offsets[b-1] + histogram[b-1];
+
+            for (auto& item: items)
+                scratch[offsets[(item.key >> (8*byte)) & 0xFF]++] = item;
+
+            items.swap(scratch);
+        }
+    }
+
+    void CommandBuffer::submit()
+    {
+        gather();
+        if (items.empty()) {
+            clear();
+            return;
+        }
+
+        sort();
+
+        // Only change the state that differs from the previous
+        // draw.
+        const DrawPacket* previous = nullptr;
+        for (auto& item: items)
+        {
+            auto& packet = *item.packet;
+
+            if (!previous || packet.shader != previous->shader)
+                packet.shader->use();
+
+            if (!previous || packet.vertexArray != previous->vertexArray)
+                packet.vertexArray->bind();
+
+            for (uint32_t unit = 0; unit < MAX_PACKET_TEXTURES; unit++)
+            {
+                auto texture = packet.textures[unit];
+                if (texture && (!previous || texture != previous->textures[unit]))
+                    texture->bind(unit);
+            }
+
+            if (packet.uniforms && (!previous
+                || packet.uniforms != previous->uniforms
+                || packet.uniformBinding != previous->uniformBinding
+                || packet.uniformOffset != previous->uniformOffset
+                || packet.uniformSize != previous->uniformSize))
+            {
+                packet.uniforms->bind_range(GL_UNIFORM_BUFFER, packet.uniformBinding, packet.uniformOffset, packet.uniformSize);
+            }
+
+            uint32_t count = packet.indexCount ? packet.indexCount : packet.vertexArray->index_count();
+            glDrawElementsInstancedBaseVertex((GLenum)packet.primitive,
+                                              count,
+                                              GL_UNSIGNED_INT,
+                                              (const void*)(packet.firstIndex * sizeof(uint32_t)),
+                                              packet.instanceCount,
+                                              packet.baseVertex);
+
+            previous = &packet;
+        }
+
+        clear();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "core.hpp"
+#include "commands.hpp"
+#include "buffer.hpp"
+#include "shader.hpp"
+#include "texture.hpp"
+
+#include <deque>
+
+namespace minigl
+{
+    /// Sort key of a draw. Packed into 64 bits, from the most
+    /// significant field:
+    ///
+    /// - opaque draws: pass (4 bits), translucency (1 bit),
+    ///   program (12 bits), material (16 bits), depth (31 bits,
+    ///   front to back);
+    /// - translucent draws: pass, translucency, depth (31 bits,
+    ///   back to front), program, material.
+    ///
+    /// Opaque draws are grouped by state to minimize program
+    /// and material changes, while translucent draws have to be
+    /// blended in depth order.
+    struct SortKey
+    {
+        uint32_t pass = 0;
+        bool translucent = false;
+
+        /// Any ID of the program (e.g. the GL name): only its
+        /// 12 low bits are used to group the draws.
+        uint32_t program = 0;
+
+        /// Any ID of the material (textures, uniforms): only
+        /// its 16 low bits are used.
+        uint32_t material = 0;
+
+        /// Distance to the camera. Negative values are
+        /// clamped to 0.
+        float depth = 0.f;
+
+        uint64_t pack() const;
+    };
+
+    /// Maximum number of textures of a draw packet
+    constexpr uint32_t MAX_PACKET_TEXTURES = 4;
+
+    /// Everything needed to execute a draw. The shader, vertex
+    /// array, textures and uniform buffer are not owned: they
+    /// must stay alive until the command buffer is submitted.
+    struct DrawPacket
+    {
+        const Shader* shader = nullptr;
+        const VertexArray* vertexArray = nullptr;
+
+        /// Textures, bound to the units 0, 1, ...
+        std::array<const Texture*, MAX_PACKET_TEXTURES> textures {};
+
+        /// Range of a uniform buffer bound to
+        /// `uniformBinding` (e.g. per object data written to a
+        /// `StreamBuffer`). Not bound if `uniforms` is null.
+        const StreamBuffer* uniforms = nullptr;
+        uint32_t uniformBinding = 0;
+        uint32_t uniformOffset = 0;
+        uint32_t uniformSize = 0;
+
+        Primitives primitive = Primitives::TRIANGLES;
+
+        /// Number of indices to draw, or 0 for the whole index
+        /// buffer.
+        uint32_t indexCount = 0;
+        uint32_t firstIndex = 0;
+        int32_t baseVertex = 0;
+        uint32_t instanceCount = 1;
+    };
+
+    /// List of recorded draws. Recording does not make any
+    /// OpenGL call, so a context can be filled from any thread,
+    /// as long as it is only used by one thread at a time.
+    class CommandContext
+    {
+        public:
+
+            /// Record a draw
+            void draw(const SortKey& key, const DrawPacket& packet);
+            void draw(uint64_t key, const DrawPacket& packet);
+
+            /// Number of recorded draws
+            size_t size() const { return packets.size(); }
+
+            /// Drop the recorded draws
+            void clear();
+
+        private:
+
+            friend class CommandBuffer;
+
+            std::vector<uint64_t> keys;
+            std::vector<DrawPacket> packets;
+    };
+
+    /// Deferred draw list. Draws are recorded in any order
+    /// with a sort key, then sorted on submission and executed
+    /// with the state changes between consecutive draws only.
+    /// This lets scenes be submitted object by object without
+    /// thrashing program and vertex array binds.
+    ///
+    /// Draws can be recorded on the buffer itself, or in
+    /// parallel on worker threads through its contexts (see
+    /// `record()`). Only `submit()` has to run on the GL
+    /// thread.
+    class CommandBuffer
+    {
+        public:
+
+            /// Record a draw from the GL thread
+            void draw(const SortKey& key, const DrawPacket& packet);
+            void draw(uint64_t key, const DrawPacket& packet);
+
+            /// Recording context number `index`, created if
+            /// needed. Create the contexts before handing them
+            /// to the worker threads: this call is not thread
+            /// safe.
+            CommandContext& context(size_t index);
+
+            /// Record the draws of `count` objects in parallel
+            /// on the global thread pool. The range is split in
+            /// chunks of at least `min_chunk` objects, and
+            /// `func(context, begin, end)` records the objects
+            /// `[begin, end)` of each chunk in its own context.
+            /// These contexts are internal, separate from those
+            /// of `context()`, so callers can keep recording in
+            /// theirs meanwhile. Returns once all the chunks are
+            /// recorded.
+            void record(size_t count,
+                        const std::function<void(CommandContext&, size_t, size_t)>& func,
+                        size_t min_chunk = 256);
+
+            /// Number of recorded draws, in all the contexts
+            size_t size() const;
+
+            /// Drop the recorded draws
+            void clear();
+
+            /// Sort the draws of all the contexts by key,
+            /// execute them, and clear the buffer. Draws with
+            /// equal keys are executed in recording order: the
+            /// draws recorded on the buffer first, then the
+            /// contexts in index order, then the chunks of the
+            /// `record()` calls, in call order.
+            void submit();
+
+        private:
+
+            struct SortItem
+            {
+                uint64_t key;
+                const DrawPacket* packet;
+            };
+
+            CommandContext main;
+
+            /// Worker contexts. A deque keeps the references
+            /// returned by `context()` valid when it grows.
+            std::deque<CommandContext> contexts;
+
+            /// Contexts of `record()`, of which the first
+            /// `recordUsed` hold draws since the last clear
+            std::deque<CommandContext> recordContexts;
+            size_t recordUsed = 0;
+
+            std::vector<SortItem> items;
+            std::vector<SortItem> scratch;
+
+            /// Gather the draws of all the contexts in `items`
+            void gather();
+
+            /// Sort `items` by key
+            void sort();
+    };
+}
\ No newline at end of file
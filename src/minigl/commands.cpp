@@ -1,25 +1,8 @@
 #include "commands.hpp"
+#include "render_state.hpp"
 
 namespace minigl
 {
-    void Fence::wait()
-    {
-        // Reset the fence if it is signaled
-        fence = 0;
-
-        // Check once making sure to flush the command queue,
-        // then loop until the fence is signaled.
-        GLenum wait_return = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
-        while (wait_return == GL_ALREADY_SIGNALED || wait_return == GL_CONDITION_SATISFIED) {
-            wait_return = glClientWaitSync(fence, 0, 0);
-        }
-    }
-
-    void Fence::reset()
-    {
-        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
-    }
-
     void RenderCommand::clear(GLenum bits)
     {
         glClear(bits);
@@ -27,37 +10,33 @@ namespace minigl
 
     void RenderCommand::set_clear_color(const Color& color)
     {
-        glClearColor(color.r, color.g, color.b, color.a);
+        RenderState::set_clear_color(color);
     }
 
     void RenderCommand::set_depth_test(bool enabled)
     {
-        enabled ? glEnable(GL_DEPTH_TEST)
-                : glDisable(GL_DEPTH_TEST);
+        RenderState::set_capability(GL_DEPTH_TEST, enabled);
     }
 
     void RenderCommand::set_depth_clamp(bool enabled)
     {
-        enabled ? glEnable(GL_DEPTH_CLAMP)
-                : glDisable(GL_DEPTH_CLAMP);
+        RenderState::set_capability(GL_DEPTH_CLAMP, enabled);
     }
 
     void RenderCommand::set_face_culling(bool enabled)
     {
-        enabled ? glEnable(GL_CULL_FACE)
-                : glDisable(GL_CULL_FACE);
+        RenderState::set_capability(GL_CULL_FACE, enabled);
     }
 
     void RenderCommand::set_viewport(uint32_t x, uint32_t y, uint32_t width,
                                     uint32_t height)
     {
-        glViewport(x, y, width, height);
+        RenderState::set_viewport(x, y, width, height);
     }
 
     void RenderCommand::wireframe(bool enabled)
     {
-        enabled ? glPolygonMode(GL_FRONT_AND_BACK, GL_LINE)
-                : glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        RenderState::set_polygon_mode(enabled ? GL_LINE : GL_FILL);
     }
 
     void RenderCommand::draw_indexed(const Ref<VertexArray>& vertexArray,
@@ -80,6 +59,19 @@ namespace minigl
                                 count);
     }
 
+    void RenderCommand::draw_range(const Ref<VertexArray>& vertexArray,
+                                  uint32_t firstIndex,
+                                  uint32_t indexCount,
+                                  uint32_t instanceCount,
+                                  Primitives drawPrimitive)
+    {
+        glDrawElementsInstanced((GLenum)drawPrimitive,
+                                indexCount,
+                                GL_UNSIGNED_INT,
+                                (const void*)(firstIndex * sizeof(uint32_t)),
+                                instanceCount);
+    }
+
     void RenderCommand::draw_indirect(const Ref<VertexArray>& vertexArray,
                                     uint32_t count,
                                     Primitives drawPrimitive)
@@ -91,6 +83,18 @@ namespace minigl
                                     0);
     }
 
+    void RenderCommand::draw_indirect_count(const Ref<VertexArray>& vertexArray,
+                                           uint32_t max_count,
+                                           Primitives drawPrimitive)
+    {
+        glMultiDrawElementsIndirectCount((GLenum)drawPrimitive,
+                                         GL_UNSIGNED_INT,
+                                         nullptr,
+                                         0,
+                                         max_count,
+                                         0);
+    }
+
     void RenderCommand::dispatch_compute(uint32_t numGroupsX, uint32_t numGroupsY,
                                        uint32_t numGroupsZ)
     {
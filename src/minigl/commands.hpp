@@ -1,6 +1,9 @@
+#pragma once
+
 #include "mglpch.hpp"
 #include "color.hpp"
 #include "buffer.hpp"
+#include "sync.hpp"
 
 #include <glad/glad.h>
 
@@ -14,18 +17,6 @@ namespace minigl
         LINE_STRIP = GL_LINE_STRIP,
     };
 
-    class Fence
-    {
-        public:
-
-            void wait();
-            void reset();
-
-        private:
-
-            GLsync fence;
-    };
-
     /// Render commands: functionality to execute several
     /// OpenGL render commands, like clearing the window or
     /// drawing an indexed vertex array.
@@ -68,8 +59,21 @@ namespace minigl
 
         static void draw_instanced(const Ref<VertexArray>& vertexArray, uint32_t count, Primitives drawPrimitive = Primitives::TRIANGLES);
 
+        /// Draw `indexCount` indices of the vertex array,
+        /// starting at `firstIndex` (e.g. a level of detail of
+        /// a mesh), `instanceCount` times
+        static void draw_range(const Ref<VertexArray>& vertexArray, uint32_t firstIndex, uint32_t indexCount,
+                               uint32_t instanceCount = 1, Primitives drawPrimitive = Primitives::TRIANGLES);
+
         static void draw_indirect(const Ref<VertexArray>& vertexArray, uint32_t count, Primitives drawPrimitive = Primitives::TRIANGLES);
 
+        /// Multi draw indirect with the number of draws read
+        /// from the GPU: the commands are read from the bound
+        /// `GL_DRAW_INDIRECT_BUFFER`, and their count from the
+        /// first integer of the bound `GL_PARAMETER_BUFFER`,
+        /// capped at `max_count`.
+        static void draw_indirect_count(const Ref<VertexArray>& vertexArray, uint32_t max_count, Primitives drawPrimitive = Primitives::TRIANGLES);
+
         /// Launch a set of (numGroupsX, numGroupsY,
         /// numGroupsZ) compute work groups in each dimension.
         static void dispatch_compute(uint32_t numGroupsX, uint32_t numGroupsY, uint32_t numGroupsZ);
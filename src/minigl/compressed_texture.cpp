@@ -0,0 +1,484 @@
+#include "compressed_texture.hpp"
+
+#include <cstring>
+
+namespace minigl
+{
+    /// Enums of EXT_texture_compression_s3tc and
+    /// EXT_texture_sRGB, which are not part of the core profile
+    /// loaded by GLAD but supported by all desktop drivers.
+    #define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+    #define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+    #define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+    #define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+
+    //----------- FORMATS -----------//
+
+    uint32_t block_size(CompressedFormat format)
+    {
+        switch (format)
+        {
+            case CompressedFormat::BC1: return 8;
+            case CompressedFormat::BC4: return 8;
+            case CompressedFormat::BC3: return 16;
+            case CompressedFormat::BC5: return 16;
+            case CompressedFormat::BC7: return 16;
+        }
+
+        MGL_ASSERT(false, "Unknown compressed format");
+        return 0;
+    }
+
+    size_t compressed_level_size(CompressedFormat format, int width, int height)
+    {
+        size_t blocks_x = std::max((width + 3) / 4, 1);
+        size_t blocks_y = std::max((height + 3) / 4, 1);
+        return blocks_x * blocks_y * block_size(format);
+    }
+
+    GLenum compressed_gl_format(CompressedFormat format, bool srgb)
+    {
+        switch (format)
+        {
+            case CompressedFormat::BC1: return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case CompressedFormat::BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case CompressedFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+            case CompressedFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+            case CompressedFormat::BC7: return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+        }
+
+        MGL_ASSERT(false, "Unknown compressed format");
+        return 0;
+    }
+
+    template<typename T>
+    static T read(const uint8_t* data)
+    {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    static constexpr uint32_t fourcc(const char (&code)[5])
+    {
+        return (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) | ((uint32_t)code[3] << 24);
+    }
+
+    //----------- IMAGE -----------//
+
+    CompressedImage::CompressedImage(const std::string& path): file(path)
+    {
+        if (!file.valid()) {
+            warn("Cannot open compressed texture '{}'", path);
+            return;
+        }
+
+        auto extension = std::filesystem::path(path).extension().string();
+        bool read = extension == ".ktx2" ? read_ktx2() : read_dds();
+        if (!read) {
+            levels.clear();
+            warn("Compressed texture '{}' is invalid or has an unsupported format", path);
+            return;
+        }
+
+        if (topDown)
+            flip_vertically(path);
+    }
+
+    bool CompressedImage::is_container(const std::string& path)
+    {
+        auto extension = std::filesystem::path(path).extension().string();
+        return extension == ".dds" || extension == ".ktx2";
+    }
+
+    //----------- ORIENTATION -----------//
+
+    /// Reverse the first `rows` rows of a BC1 color block:
+    /// after the two endpoints, each byte holds the 2-bit
+    /// indices of a row.
+    static void flip_bc1_block(uint8_t* block, int rows)
+    {
+        std::reverse(block + 4, block + 4 + rows);
+    }
+
+    /// Reverse the first `rows` rows of a BC4 block (also the
+    /// alpha block of BC3, and each channel of BC5): after the
+    /// two endpoints, 48 bits hold the 3-bit indices, 12 bits
+    /// per row.
+    static void flip_bc4_block(uint8_t* block, int rows)
+    {
+        uint64_t bits = 0;
+        std::memcpy(&bits, block + 2, 6);
+
+        uint64_t flipped = bits;
+        for (int row = 0; row < rows; row++) {
+            uint64_t indices = (bits >> (12 * (rows - 1 - row))) & 0xfff;
+            flipped &= ~(uint64_t(0xfff) << (12 * row));
+            flipped |= indices << (12 * row);
+        }
+
+        std::memcpy(block + 2, &flipped, 6);
+    }
+
+    void CompressedImage::flip_vertically(const std::string& path)
+    {
+        if (format == CompressedFormat::BC7) {
+            warn("Compressed texture '{}' is stored top-down, but BC7 blocks cannot be flipped: it is loaded upside down", path);
+            return;
+        }
+
+        size_t total = 0;
+        for (auto& level: levels)
+            total += level.size;
+        flipped.resize(total);
+
+        uint32_t size = block_size(format);
+        uint8_t* out = flipped.data();
+        for (auto& level: levels) {
+            size_t blocks_x = std::max((level.width + 3) / 4, 1);
+            size_t blocks_y = std::max((level.height + 3) / 4, 1);
+            size_t row_size = blocks_x * size;
+
+            // Levels smaller than a block only flip their valid
+            // rows. Otherwise the padding rows of the last block
+            // row cannot be moved across blocks: the image ends
+            // up shifted by them.
+            int rows = std::min(level.height, 4);
+            if (level.height > 4 && level.height % 4 != 0)
+                warn("Compressed texture '{}': {} rows are not a multiple of 4, the flipped level is off by {} rows", path, level.height, 4 - level.height % 4);
+
+            for (size_t y = 0; y < blocks_y; y++) {
+                uint8_t* row = out + y * row_size;
+                std::memcpy(row, level.data + (blocks_y - 1 - y) * row_size, row_size);
+
+                for (size_t x = 0; x < blocks_x; x++) {
+                    uint8_t* block = row + x * size;
+                    switch (format)
+                    {
+                        case CompressedFormat::BC1: flip_bc1_block(block, rows); break;
+                        case CompressedFormat::BC3: flip_bc4_block(block, rows); flip_bc1_block(block + 8, rows); break;
+                        case CompressedFormat::BC4: flip_bc4_block(block, rows); break;
+                        case CompressedFormat::BC5: flip_bc4_block(block, rows); flip_bc4_block(block + 8, rows); break;
+                        case CompressedFormat::BC7: break;
+                    }
+                }
+            }
+
+            level.data = out;
+            out += level.size;
+        }
+    }
+
+    //----------- DDS -----------//
+
+    /// DXGI formats of the DX10 extended header
+    enum DXGIFormat: uint32_t
+    {
+        DXGI_BC1_UNORM = 71, DXGI_BC1_UNORM_SRGB = 72,
+        DXGI_BC3_UNORM = 77, DXGI_BC3_UNORM_SRGB = 78,
+        DXGI_BC4_UNORM = 80,
+        DXGI_BC5_UNORM = 83,
+        DXGI_BC7_UNORM = 98, DXGI_BC7_UNORM_SRGB = 99,
+    };
+
+    bool CompressedImage::read_dds()
+    {
+        // Magic, 124-byte header (whose pixel format starts at
+        // byte 76), and an optional 20-byte DX10 header
+        constexpr size_t header_size = 4 + 124;
+        const uint8_t* data = file.data();
+        if (file.size() < header_size || read<uint32_t>(data) != fourcc("DDS "))
+            return false;
+
+        height = read<uint32_t>(data + 12);
+        width = read<uint32_t>(data + 16);
+        uint32_t mip_count = std::max(read<uint32_t>(data + 28), 1u);
+        uint32_t code = read<uint32_t>(data + 4 + 80);
+
+        size_t offset = header_size;
+        switch (code)
+        {
+            case fourcc("DXT1"): format = CompressedFormat::BC1; break;
+            case fourcc("DXT5"): format = CompressedFormat::BC3; break;
+            case fourcc("ATI1"): case fourcc("BC4U"): format = CompressedFormat::BC4; break;
+            case fourcc("ATI2"): case fourcc("BC5U"): format = CompressedFormat::BC5; break;
+
+            case fourcc("DX10"): {
+                if (file.size() < header_size + 20)
+                    return false;
+
+                offset += 20;
+                switch (read<uint32_t>(data + header_size))
+                {
+                    case DXGI_BC1_UNORM_SRGB: srgb = true; [[fallthrough]];
+                    case DXGI_BC1_UNORM: format = CompressedFormat::BC1; break;
+                    case DXGI_BC3_UNORM_SRGB: srgb = true; [[fallthrough]];
+                    case DXGI_BC3_UNORM: format = CompressedFormat::BC3; break;
+                    case DXGI_BC4_UNORM: format = CompressedFormat::BC4; break;
+                    case DXGI_BC5_UNORM: format = CompressedFormat::BC5; break;
+                    case DXGI_BC7_UNORM_SRGB: srgb = true; [[fallthrough]];
+                    case DXGI_BC7_UNORM: format = CompressedFormat::BC7; break;
+                    default: return false;
+                }
+
+                // Only single 2D textures are supported: the
+                // resource dimension must be 2D (3), without the
+                // cube map flag (0x4) or array layers.
+                uint32_t dimension = read<uint32_t>(data + header_size + 4);
+                uint32_t misc_flags = read<uint32_t>(data + header_size + 8);
+                uint32_t array_size = read<uint32_t>(data + header_size + 12);
+                if (dimension != 3 || (misc_flags & 0x4) || array_size > 1)
+                    return false;
+                break;
+            }
+
+            default:
+                return false;
+        }
+
+        // Legacy cube maps and volume textures (DDSCAPS2_CUBEMAP
+        // and DDSCAPS2_VOLUME) are not supported either.
+        if (read<uint32_t>(data + 4 + 108) & (0x200 | 0x200000))
+            return false;
+
+        // DDS images are always stored top-down
+        topDown = true;
+
+        // The levels follow each other, largest first
+        for (uint32_t level = 0; level < mip_count; level++)
+        {
+            int w = std::max(width >> level, 1);
+            int h = std::max(height >> level, 1);
+            size_t size = compressed_level_size(format, w, h);
+            if (offset + size > file.size())
+                return false;
+
+            levels.push_back({w, h, data + offset, size});
+            offset += size;
+        }
+
+        return true;
+    }
+
+    //----------- KTX2 -----------//
+
+    static const uint8_t ktx2_identifier[12] = {
+        0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+    };
+
+    /// Vulkan formats of the KTX2 header
+    enum VkFormat: uint32_t
+    {
+        VK_BC1_RGB_UNORM = 131, VK_BC1_RGB_SRGB = 132,
+        VK_BC1_RGBA_UNORM = 133, VK_BC1_RGBA_SRGB = 134,
+        VK_BC3_UNORM = 137, VK_BC3_SRGB = 138,
+        VK_BC4_UNORM = 139,
+        VK_BC5_UNORM = 141,
+        VK_BC7_UNORM = 145, VK_BC7_SRGB = 146,
+    };
+
+    /// Size of the KTX2 identifier, header and index, before
+    /// the level index
+    static constexpr size_t KTX2_HEADER_SIZE = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+
+    bool CompressedImage::read_ktx2()
+    {
+        const uint8_t* data = file.data();
+        if (file.size() < KTX2_HEADER_SIZE || std::memcmp(data, ktx2_identifier, sizeof(ktx2_identifier)) != 0)
+            return false;
+
+        const uint8_t* header = data + 12;
+        uint32_t vk_format = read<uint32_t>(header);
+        width = read<uint32_t>(header + 8);
+        height = read<uint32_t>(header + 12);
+        uint32_t depth = read<uint32_t>(header + 16);
+        uint32_t layer_count = read<uint32_t>(header + 20);
+        uint32_t face_count = read<uint32_t>(header + 24);
+        uint32_t level_count = std::max(read<uint32_t>(header + 28), 1u);
+        uint32_t supercompression = read<uint32_t>(header + 32);
+
+        if (depth > 0 || layer_count > 0 || face_count != 1 || supercompression != 0)
+            return false;
+
+        switch (vk_format)
+        {
+            case VK_BC1_RGB_SRGB: case VK_BC1_RGBA_SRGB: srgb = true; [[fallthrough]];
+            case VK_BC1_RGB_UNORM: case VK_BC1_RGBA_UNORM: format = CompressedFormat::BC1; break;
+            case VK_BC3_SRGB: srgb = true; [[fallthrough]];
+            case VK_BC3_UNORM: format = CompressedFormat::BC3; break;
+            case VK_BC4_UNORM: format = CompressedFormat::BC4; break;
+            case VK_BC5_UNORM: format = CompressedFormat::BC5; break;
+            case VK_BC7_SRGB: srgb = true; [[fallthrough]];
+            case VK_BC7_UNORM: format = CompressedFormat::BC7; break;
+            default: return false;
+        }
+
+        if (file.size() < KTX2_HEADER_SIZE + level_count * 24)
+            return false;
+
+        // Key/value data: look for the orientation. Without
+        // it, images are top-down ("rd").
+        uint32_t kvd_offset = read<uint32_t>(header + 44);
+        uint32_t kvd_length = read<uint32_t>(header + 48);
+        if ((uint64_t)kvd_offset + kvd_length > file.size())
+            return false;
+
+        std::string orientation = "rd";
+        for (uint32_t offset = 0; offset + 4 <= kvd_length; ) {
+            uint32_t length = read<uint32_t>(data + kvd_offset + offset);
+            if (offset + 4 + length > kvd_length)
+                return false;
+
+            auto entry = (const char*)data + kvd_offset + offset + 4;
+            auto key_end = (const char*)std::memchr(entry, '\0', length);
+            if (key_end && std::string(entry, key_end) == "KTXorientation")
+                orientation = std::string(key_end + 1, strnlen(key_end + 1, entry + length - key_end - 1));
+
+            offset += (4 + length + 3) & ~3u;
+        }
+
+        if (orientation.size() < 2 || orientation[0] != 'r' || (orientation[1] != 'u' && orientation[1] != 'd')) {
+            warn("Unsupported KTX2 orientation '{}'", orientation);
+            return false;
+        }
+        topDown = orientation[1] == 'd';
+
+        // Level index: offset, size, and uncompressed size of
+        // each level, largest first
+        const uint8_t* index = data + KTX2_HEADER_SIZE;
+        for (uint32_t level = 0; level < level_count; level++)
+        {
+            uint64_t offset = read<uint64_t>(index + 24 * level);
+            uint64_t size = read<uint64_t>(index + 24 * level + 8);
+
+            int w = std::max(width >> level, 1);
+            int h = std::max(height >> level, 1);
+            if (offset + size > file.size() || size != compressed_level_size(format, w, h))
+                return false;
+
+            levels.push_back({w, h, data + offset, size});
+        }
+
+        return true;
+    }
+
+    /// Data format descriptor of a block compressed format: a
+    /// basic descriptor block with one sample per channel
+    /// group (see the Khronos Data Format specification).
+    static std::vector<uint32_t> ktx2_dfd(CompressedFormat format, bool srgb)
+    {
+        // Color models, and channel ids of the samples
+        constexpr uint8_t MODEL_BC1A = 128, MODEL_BC3 = 130, MODEL_BC4 = 131, MODEL_BC5 = 132, MODEL_BC7 = 134;
+        constexpr uint8_t CHANNEL_COLOR = 0, CHANNEL_RED = 0, CHANNEL_GREEN = 1, CHANNEL_ALPHA = 15;
+
+        struct Sample { uint16_t offset; uint8_t channel; };
+        uint8_t model = 0;
+        std::vector<Sample> samples {};
+        switch (format)
+        {
+            case CompressedFormat::BC1: model = MODEL_BC1A; samples = {{0, CHANNEL_COLOR}}; break;
+            case CompressedFormat::BC3: model = MODEL_BC3; samples = {{0, CHANNEL_ALPHA}, {64, CHANNEL_COLOR}}; break;
+            case CompressedFormat::BC4: model = MODEL_BC4; samples = {{0, CHANNEL_RED}}; break;
+            case CompressedFormat::BC5: model = MODEL_BC5; samples = {{0, CHANNEL_RED}, {64, CHANNEL_GREEN}}; break;
+            case CompressedFormat::BC7: model = MODEL_BC7; samples = {{0, CHANNEL_COLOR}}; break;
+        }
+
+        uint32_t bits = 8 * block_size(format);
+        uint32_t sample_bits = bits / samples.size();
+        uint32_t block_size_bytes = 24 + 16 * samples.size();
+
+        std::vector<uint32_t> dfd {};
+        dfd.push_back(4 + block_size_bytes);
+        dfd.push_back(0);                              // vendor, descriptor type
+        dfd.push_back(2 | (block_size_bytes << 16));   // version, block size
+        dfd.push_back(model | (1 << 8) | ((srgb ? 2 : 1) << 16)); // model, BT.709 primaries, transfer, flags
+        dfd.push_back(3 | (3 << 8));                   // 4x4x1x1 texel blocks
+        dfd.push_back(block_size(format));             // bytes per plane
+        dfd.push_back(0);
+
+        for (auto& sample: samples) {
+            dfd.push_back(sample.offset | ((sample_bits - 1) << 16) | ((uint32_t)sample.channel << 24));
+            dfd.push_back(0);                          // sample position
+            dfd.push_back(0);                          // lower
+            dfd.push_back(0xffffffff);                 // upper
+        }
+
+        return dfd;
+    }
+
+    bool write_ktx2(const std::string& path, CompressedFormat format, bool srgb,
+                    int width, int height, const std::vector<std::vector<uint8_t>>& levels)
+    {
+        if (format == CompressedFormat::BC4 || format == CompressedFormat::BC5)
+            srgb = false;
+
+        uint32_t vk_format = 0;
+        switch (format)
+        {
+            case CompressedFormat::BC1: vk_format = srgb ? VK_BC1_RGB_SRGB : VK_BC1_RGB_UNORM; break;
+            case CompressedFormat::BC3: vk_format = srgb ? VK_BC3_SRGB : VK_BC3_UNORM; break;
+            case CompressedFormat::BC4: vk_format = VK_BC4_UNORM; break;
+            case CompressedFormat::BC5: vk_format = VK_BC5_UNORM; break;
+            case CompressedFormat::BC7: vk_format = srgb ? VK_BC7_SRGB : VK_BC7_UNORM; break;
+        }
+
+        auto dfd = ktx2_dfd(format, srgb);
+
+        // Key/value data: the orientation, first row at the
+        // bottom ("right, up")
+        std::string orientation = "KTXorientation";
+        orientation.push_back('\0');
+        orientation += "ru";
+        orientation.push_back('\0');
+
+        std::vector<uint8_t> kvd(4 + orientation.size());
+        uint32_t kv_length = orientation.size();
+        std::memcpy(kvd.data(), &kv_length, 4);
+        std::memcpy(kvd.data() + 4, orientation.data(), orientation.size());
+        kvd.resize((kvd.size() + 3) & ~size_t(3));
+
+        size_t level_index_offset = KTX2_HEADER_SIZE;
+        size_t dfd_offset = level_index_offset + 24 * levels.size();
+        size_t kvd_offset = dfd_offset + 4 * dfd.size();
+        size_t data_offset = kvd_offset + kvd.size();
+
+        // The levels are stored smallest first, each aligned
+        // to the block size.
+        size_t alignment = block_size(format);
+        std::vector<uint64_t> level_offsets(levels.size());
+        size_t end = data_offset;
+        for (size_t level = levels.size(); level-- > 0;) {
+            end = (end + alignment - 1) / alignment * alignment;
+            level_offsets[level] = end;
+            end += levels[level].size();
+        }
+
+        std::vector<uint8_t> out(end, 0);
+        auto write = [&](size_t offset, const void* src, size_t size) { std::memcpy(out.data() + offset, src, size); };
+
+        write(0, ktx2_identifier, sizeof(ktx2_identifier));
+
+        uint32_t header[9] = {vk_format, 1, (uint32_t)width, (uint32_t)height, 0, 0, 1, (uint32_t)levels.size(), 0};
+        write(12, header, sizeof(header));
+
+        uint32_t index[4] = {(uint32_t)dfd_offset, (uint32_t)(4 * dfd.size()), (uint32_t)kvd_offset, (uint32_t)kvd.size()};
+        write(12 + sizeof(header), index, sizeof(index));
+        // (no supercompression global data)
+
+        for (size_t level = 0; level < levels.size(); level++) {
+            uint64_t entry[3] = {level_offsets[level], levels[level].size(), levels[level].size()};
+            write(level_index_offset + 24 * level, entry, sizeof(entry));
+            write(level_offsets[level], levels[level].data(), levels[level].size());
+        }
+
+        write(dfd_offset, dfd.data(), 4 * dfd.size());
+        write(kvd_offset, kvd.data(), kvd.size());
+
+        std::ofstream file {path, std::ios::binary};
+        if (!file)
+            return false;
+
+        file.write((const char*)out.data(), out.size());
+        return (bool)file;
+    }
+}
\ No newline at end of file
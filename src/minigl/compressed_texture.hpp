@@ -0,0 +1,100 @@
+#pragma once
+
+#include "core.hpp"
+#include "mapped_file.hpp"
+
+#include <glad/glad.h>
+
+namespace minigl
+{
+    /// Block compressed texture formats. All of them store
+    /// 4x4 texel blocks.
+    enum class CompressedFormat
+    {
+        /// RGB, 8 bytes per block (S3TC DXT1)
+        BC1,
+        /// RGBA, 16 bytes per block: BC4 alpha and BC1 color
+        /// (S3TC DXT5)
+        BC3,
+        /// Single channel, 8 bytes per block (RGTC1)
+        BC4,
+        /// Two channels, 16 bytes per block (RGTC2), e.g.
+        /// normal maps
+        BC5,
+        /// RGBA, 16 bytes per block (BPTC), the highest quality
+        BC7,
+    };
+
+    /// Size of a 4x4 block in bytes
+    uint32_t block_size(CompressedFormat format);
+
+    /// Size in bytes of a `width` x `height` level
+    size_t compressed_level_size(CompressedFormat format, int width, int height);
+
+    /// OpenGL internal format. BC4 and BC5 have no sRGB
+    /// variant, `srgb` is ignored for them.
+    GLenum compressed_gl_format(CompressedFormat format, bool srgb);
+
+    /// Mip level of a compressed image
+    struct CompressedLevel
+    {
+        int width, height;
+        const uint8_t* data;
+        size_t size;
+    };
+
+    /// Block compressed image with all its mip levels, read
+    /// from a DDS or KTX2 file (chosen from the extension). The
+    /// file is mapped, and the levels point into the mapping.
+    /// Only 2D images without supercompression are supported.
+    ///
+    /// Levels are oriented like OpenGL textures (and images
+    /// loaded with stb_image), first row at the bottom. Images
+    /// stored top-down (DDS files, and KTX2 files without a
+    /// "ru" `KTXorientation`) are flipped into a copy: block
+    /// rows are reversed, and so are the texel rows within
+    /// each block. BC7 blocks cannot be flipped without
+    /// re-encoding them, so top-down BC7 images are loaded
+    /// upside down, with a warning.
+    class CompressedImage
+    {
+        public:
+
+            /// Read the image at `path`. The image is left
+            /// invalid if the file cannot be read or its format
+            /// is not supported (see `valid()`).
+            explicit CompressedImage(const std::string& path);
+
+            bool valid() const { return !levels.empty(); }
+
+            /// Whether `path` has the extension of a compressed
+            /// texture container (.dds or .ktx2)
+            static bool is_container(const std::string& path);
+
+            CompressedFormat format = CompressedFormat::BC1;
+            bool srgb = false;
+            int width = 0, height = 0;
+            std::vector<CompressedLevel> levels;
+
+        private:
+
+            MappedFile file;
+
+            /// Flipped levels, when the file is top-down
+            std::vector<uint8_t> flipped;
+            bool topDown = false;
+
+            bool read_dds();
+            bool read_ktx2();
+
+            /// Flip the levels upside down, into `flipped`
+            void flip_vertically(const std::string& path);
+    };
+
+    /// Write compressed levels (the full resolution one first)
+    /// to a KTX2 file, oriented with the first row at the
+    /// bottom like OpenGL textures. Returns false if the file
+    /// cannot be written.
+    bool write_ktx2(const std::string& path, CompressedFormat format, bool srgb,
+                    int width, int height, const std::vector<std::vector<uint8_t>>& levels);
+}
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "culling.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <bit>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define MGL_X86
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#endif
+
+// GCC and Clang only emit AVX instructions in functions that
+// are explicitly compiled for it, so that the rest of the
+// library still runs on CPUs without AVX.
+#if defined(__GNUC__) || defined(__clang__)
+    #define MGL_TARGET_AVX __attribute__((target("avx")))
+#else
+    #define MGL_TARGET_AVX
+#endif
+
+namespace minigl
+{
+    SimdLevel simd_level()
+    {
+#ifdef MGL_X86
+        static const SimdLevel level = [] {
+#ifdef _MSC_VER
+            // AVX needs both CPU support and the OS saving the
+            // YMM registers (OSXSAVE, then XCR0 bits 1 and 2).
+            int info[4];
+            __cpuid(info, 1);
+            bool avx = (info[2] & (1 << 28)) && (info[2] & (1 << 27))
+                    && (_xgetbv(0) & 6) == 6;
+#else
+            bool avx = __builtin_cpu_supports("avx");
+#endif
+            return avx ? SimdLevel::AVX : SimdLevel::SSE;
+        }();
+
+        return level;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    //----------- BOUNDING BOXES -----------//
+
+    size_t BoundingBoxes::add(const AABB& box)
+    {
+        size_t index = size();
+
+        centerX.push_back(0.f); centerY.push_back(0.f); centerZ.push_back(0.f);
+        extentX.push_back(0.f); extentY.push_back(0.f); extentZ.push_back(0.f);
+        set(index, box);
+
+        return index;
+    }
+
+    void BoundingBoxes::set(size_t index, const AABB& box)
+    {
+        Vec3 center = box.center();
+        Vec3 extent = box.extent();
+
+        centerX[index] = center.x; centerY[index] = center.y; centerZ[index] = center.z;
+        extentX[index] = extent.x; extentY[index] = extent.y; extentZ[index] = extent.z;
+    }
+
+    void BoundingBoxes::reserve(size_t count)
+    {
+        for (auto array: { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ })
+            array->reserve(count);
+    }
+
+    void BoundingBoxes::clear()
+    {
+        for (auto array: { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ })
+            array->clear();
+    }
+
+    //----------- KERNELS -----------//
+
+    /// Frustum planes with the absolute values of their
+    /// normals precomputed. A box is outside a plane `(n, d)`
+    /// if `dot(n, c) + d + dot(|n|, e) < 0`.
+    struct CullPlanes
+    {
+        float nx[6], ny[6], nz[6], d[6];
+        float ax[6], ay[6], az[6];
+
+        explicit CullPlanes(const Frustum& frustum)
+        {
+            for (int p = 0; p < 6; p++) {
+                auto& plane = frustum.planes[p];
+                nx[p] = plane.x; ny[p] = plane.y; nz[p] = plane.z; d[p] = plane.w;
+                ax[p] = std::abs(plane.x); ay[p] = std::abs(plane.y); az[p] = std::abs(plane.z);
+            }
+        }
+    };
+
+    static size_t cull_scalar(const CullPlanes& planes, const BoundingBoxes& boxes,
+                              uint8_t* visible, size_t begin, size_t end)
+    {
+        size_t count = 0;
+        for (size_t i = begin; i < end; i++)
+        {
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; p++)
+            {
+                float distance = planes.nx[p] * boxes.centerX[i]
+                               + planes.ny[p] * boxes.centerY[i]
+                               + planes.nz[p] * boxes.centerZ[i]
+                               + planes.d[p];
+                float radius = planes.ax[p] * boxes.extentX[i]
+                             + planes.ay[p] * boxes.extentY[i]
+                             + planes.az[p] * boxes.extentZ[i];
+                inside = distance + radius >= 0.f;
+            }
+
+            visible[i] = inside;
+            count += inside;
+        }
+
+        return count;
+    }
+
+#ifdef MGL_X86
+    static size_t cull_sse(const CullPlanes& planes, const BoundingBoxes& boxes,
+                           uint8_t* visible, size_t begin, size_t end)
+    {
+        size_t count = 0;
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128 cx = _mm_loadu_ps(&boxes.centerX[i]);
+            __m128 cy = _mm_loadu_ps(&boxes.centerY[i]);
+            __m128 cz = _mm_loadu_ps(&boxes.centerZ[i]);
+            __m128 ex = _mm_loadu_ps(&boxes.extentX[i]);
+            __m128 ey = _mm_loadu_ps(&boxes.extentY[i]);
+            __m128 ez = _mm_loadu_ps(&boxes.extentZ[i]);
+
+            // Lanes stay set while their box is inside all
+            // the planes tested so far.
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; p++)
+            {
+                __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.nx[p]), cx),
+                               _mm_mul_ps(_mm_set1_ps(planes.ny[p]), cy)),
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.nz[p]), cz),
+                               _mm_set1_ps(planes.d[p])));
+                __m128 radius = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.ax[p]), ex),
+                               _mm_mul_ps(_mm_set1_ps(planes.ay[p]), ey)),
+                    _mm_mul_ps(_mm_set1_ps(planes.az[p]), ez));
+
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            for (int lane = 0; lane < 4; lane++)
+                visible[i + lane] = (mask >> lane) & 1;
+            count += std::popcount((unsigned)mask);
+        }
+
+        return count + cull_scalar(planes, boxes, visible, i, end);
+    }
+
+    MGL_TARGET_AVX
+    static size_t cull_avx(const CullPlanes& planes, const BoundingBoxes& boxes,
+                           uint8_t* visible, size_t begin, size_t end)
+    {
+        size_t count = 0;
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8)
+        {
+            __m256 cx = _mm256_loadu_ps(&boxes.centerX[i]);
+            __m256 cy = _mm256_loadu_ps(&boxes.centerY[i]);
+            __m256 cz = _mm256_loadu_ps(&boxes.centerZ[i]);
+            __m256 ex = _mm256_loadu_ps(&boxes.extentX[i]);
+            __m256 ey = _mm256_loadu_ps(&boxes.extentY[i]);
+            __m256 ez = _mm256_loadu_ps(&boxes.extentZ[i]);
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < 6; p++)
+            {
+                __m256 distance = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.nx[p]), cx),
+                                  _mm256_mul_ps(_mm256_set1_ps(planes.ny[p]), cy)),
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.nz[p]), cz),
+                                  _mm256_set1_ps(planes.d[p])));
+                __m256 radius = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.ax[p]), ex),
+                                  _mm256_mul_ps(_mm256_set1_ps(planes.ay[p]), ey)),
+                    _mm256_mul_ps(_mm256_set1_ps(planes.az[p]), ez));
+
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+            }
+
+            int mask = _mm256_movemask_ps(inside);
+            for (int lane = 0; lane < 8; lane++)
+                visible[i + lane] = (mask >> lane) & 1;
+            count += std::popcount((unsigned)mask);
+        }
+
+        // Leave the tail to SSE, without mixing AVX and SSE
+        // instructions in the same function.
+        _mm256_zeroupper();
+        return count + cull_sse(planes, boxes, visible, i, end);
+    }
+#endif
+
+    size_t frustum_cull(const Frustum& frustum, const BoundingBoxes& boxes,
+                        uint8_t* visible, size_t begin, size_t end,
+                        SimdLevel level)
+    {
+        CullPlanes planes {frustum};
+        if (level > simd_level())
+            level = simd_level();
+
+        switch (level)
+        {
+#ifdef MGL_X86
+            case SimdLevel::AVX: return cull_avx(planes, boxes, visible, begin, end);
+            case SimdLevel::SSE: return cull_sse(planes, boxes, visible, begin, end);
+#endif
+            default: return cull_scalar(planes, boxes, visible, begin, end);
+        }
+    }
+
+    size_t frustum_cull(const Frustum& frustum, const BoundingBoxes& boxes,
+                        std::vector<uint8_t>& visible, SimdLevel level)
+    {
+        visible.resize(boxes.size());
+        return frustum_cull(frustum, boxes, visible.data(), 0, boxes.size(), level);
+    }
+
+    size_t frustum_cull_parallel(const Frustum& frustum, const BoundingBoxes& boxes,
+                                 std::vector<uint8_t>& visible, SimdLevel level)
+    {
+        visible.resize(boxes.size());
+
+        // Large chunks: the kernels process millions of boxes
+        // per second, so small chunks would only measure the
+        // scheduling overhead.
+        std::atomic<size_t> count = 0;
+        parallel_for(boxes.size(), [&](size_t begin, size_t end) {
+            count += frustum_cull(frustum, boxes, visible.data(), begin, end, level);
+        }, 16384);
+
+        return count;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "core.hpp"
+#include "geometry.hpp"
+
+namespace minigl
+{
+    /// Instruction sets of the culling kernels
+    enum class SimdLevel
+    {
+        /// Plain C++, one box at a time
+        Scalar,
+        /// SSE, 4 boxes at a time
+        SSE,
+        /// AVX, 8 boxes at a time
+        AVX,
+    };
+
+    /// Best instruction set supported by both the build and the
+    /// CPU
+    SimdLevel simd_level();
+
+    /// Bounding boxes stored as structure of arrays (one array
+    /// per coordinate of the centers and extents), so that the
+    /// culling kernels can load several boxes per instruction.
+    class BoundingBoxes
+    {
+        public:
+
+            /// Add a box and return its index
+            size_t add(const AABB& box);
+
+            /// Replace the box at `index`
+            void set(size_t index, const AABB& box);
+
+            void reserve(size_t count);
+            void clear();
+
+            size_t size() const { return centerX.size(); }
+
+            std::vector<float> centerX, centerY, centerZ;
+            std::vector<float> extentX, extentY, extentZ;
+    };
+
+    /// Test the boxes `[begin, end)` against the frustum, and
+    /// write 1 for the visible ones and 0 for the others into
+    /// `visible[begin, end)`. Returns the number of visible
+    /// boxes. If `level` is not supported, the best supported
+    /// level is used instead.
+    size_t frustum_cull(const Frustum& frustum, const BoundingBoxes& boxes,
+                        uint8_t* visible, size_t begin, size_t end,
+                        SimdLevel level = simd_level());
+
+    /// Test all the boxes against the frustum; `visible` is
+    /// resized to the number of boxes.
+    size_t frustum_cull(const Frustum& frustum, const BoundingBoxes& boxes,
+                        std::vector<uint8_t>& visible,
+                        SimdLevel level = simd_level());
+
+    /// Same as `frustum_cull()`, split in chunks culled in
+    /// parallel on the global thread pool. Worth it from a few
+    /// tens of thousands of boxes.
+    size_t frustum_cull_parallel(const Frustum& frustum, const BoundingBoxes& boxes,
+                                 std::vector<uint8_t>& visible,
+                                 SimdLevel level = simd_level());
+}
\ No newline at end of file
@@ -81,4 +81,78 @@ namespace minigl
     {
         return glm::all(glm::epsilonEqual(a, Vec3{b}, epsilon));
     }
+
+    void AABB::expand(const Vec3& p)
+    {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void AABB::expand(const AABB& box)
+    {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+
+    Frustum::Frustum(const Mat4& viewProj)
+    {
+        // Gribb-Hartmann: the planes are sums and differences
+        // of the last row of the matrix with the other rows.
+        auto row = [&](int i) {
+            return Vec4 { viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i] };
+        };
+
+        for (int i = 0; i < 3; i++) {
+            planes[2*i] = row(3) + row(i);
+            planes[2*i+1] = row(3) - row(i);
+        }
+    }
+
+    bool Frustum::intersects(const AABB& box) const
+    {
+        Vec3 center = box.center();
+        Vec3 extent = box.extent();
+
+        for (auto& plane: planes) {
+            Vec3 normal {plane.x, plane.y, plane.z};
+
+            // Projected radius of the box on the plane normal
+            float radius = glm::dot(extent, glm::abs(normal));
+            if (glm::dot(normal, center) + plane.w < -radius)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool Frustum::intersects(const Sphere& sphere) const
+    {
+        for (auto& plane: planes) {
+            Vec3 normal {plane.x, plane.y, plane.z};
+
+            // The planes are not normalized: scale the radius
+            // instead of the distance.
+            float radius = sphere.radius * glm::length(normal);
+            if (glm::dot(normal, sphere.center) + plane.w < -radius)
+                return false;
+        }
+
+        return true;
+    }
+
+    Ray Ray::from_screen(const Vec2& pos, const Vec2& size, const Mat4& viewProj)
+    {
+        // Window coordinates have Y pointing down
+        float x = 2.f * pos.x / size.x - 1.f;
+        float y = 1.f - 2.f * pos.y / size.y;
+
+        Mat4 inverse = glm::inverse(viewProj);
+        Vec4 near = inverse * Vec4{x, y, -1.f, 1.f};
+        Vec4 far = inverse * Vec4{x, y, 1.f, 1.f};
+
+        Vec3 origin = Vec3{near} / near.w;
+        Vec3 target = Vec3{far} / far.w;
+
+        return Ray { .origin = origin, .direction = glm::normalize(target - origin) };
+    }
 }
\ No newline at end of file
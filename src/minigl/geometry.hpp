@@ -2,6 +2,8 @@
 
 #include <fmt/format.h>
 #include <glm/glm.hpp>
+#include <limits>
+#include <array>
 
 namespace minigl
 {
@@ -41,6 +43,69 @@ namespace minigl
     float length(const Vec3& vec);
 
     bool allclose(const Vec3& a, float b, float epsilon=1e-6);
+
+    /// Axis-aligned bounding box. A default-constructed box
+    /// is empty (inverted), so that expanding it by a first
+    /// point collapses it onto that point.
+    struct AABB
+    {
+        Vec3 min {std::numeric_limits<float>::max()};
+        Vec3 max {std::numeric_limits<float>::lowest()};
+
+        /// Grow the box to contain the point `p`.
+        void expand(const Vec3& p);
+
+        /// Grow the box to contain the box `box`.
+        void expand(const AABB& box);
+
+        bool empty() const { return min.x > max.x; }
+        Vec3 center() const { return (min + max) * 0.5f; }
+        Vec3 extent() const { return (max - min) * 0.5f; }
+    };
+
+    /// Bounding sphere
+    struct Sphere
+    {
+        Vec3 center {0.f};
+        float radius = 0.f;
+    };
+
+    /// Half line from `origin` towards `direction`
+    struct Ray
+    {
+        Vec3 origin {0.f};
+        Vec3 direction {0.f, 0.f, -1.f};
+
+        /// Ray through the pixel at `pos` (in window
+        /// coordinates, e.g. `Input::getMousePos()`) of a
+        /// viewport of size `size`, from the near plane of the
+        /// `viewProj` camera.
+        static Ray from_screen(const Vec2& pos, const Vec2& size, const Mat4& viewProj);
+    };
+
+    /// View frustum, as six planes `(n, d)` with their normals
+    /// pointing inwards: a point `p` is inside the frustum if
+    /// `dot(n, p) + d >= 0` for all the planes. The planes are
+    /// not normalized.
+    struct Frustum
+    {
+        /// Left, right, bottom, top, near and far planes
+        std::array<Vec4, 6> planes {};
+
+        Frustum() = default;
+
+        /// Extract the planes of a view-projection matrix
+        explicit Frustum(const Mat4& viewProj);
+
+        /// Whether the box is at least partially inside the
+        /// frustum. Conservative: boxes near the corners of the
+        /// frustum may be reported inside.
+        bool intersects(const AABB& box) const;
+
+        /// Whether the sphere is at least partially inside the
+        /// frustum (conservative, like for boxes).
+        bool intersects(const Sphere& sphere) const;
+    };
 }
 
 // Vec3 formatting
@@ -0,0 +1,186 @@
+#include "geometry_pool.hpp"
+#include "mesh.hpp"
+
+namespace minigl
+{
+    //----------- RANGE ALLOCATOR -----------//
+
+    RangeAllocator::RangeAllocator(uint32_t capacity)
+    {
+        grow(capacity);
+    }
+
+    void RangeAllocator::insert_free(uint32_t offset, uint32_t size)
+    {
+        freeByOffset.emplace(offset, size);
+        freeBySize.emplace(size, offset);
+    }
+
+    void RangeAllocator::erase_free(std::map<uint32_t, uint32_t>::iterator it)
+    {
+        auto [first, last] = freeBySize.equal_range(it->second);
+        for (auto s = first; s != last; s++) {
+            if (s->second == it->first) {
+                freeBySize.erase(s);
+                break;
+            }
+        }
+
+        freeByOffset.erase(it);
+    }
+
+    uint32_t RangeAllocator::allocate(uint32_t size)
+    {
+        if (size == 0)
+            return INVALID;
+
+        // Smallest free range that fits
+        auto fit = freeBySize.lower_bound(size);
+        if (fit == freeBySize.end())
+            return INVALID;
+
+        uint32_t offset = fit->second;
+        uint32_t free_size = fit->first;
+        erase_free(freeByOffset.find(offset));
+
+        if (free_size > size)
+            insert_free(offset + size, free_size - size);
+
+        usedSize += size;
+        return offset;
+    }
+
+    void RangeAllocator::free(uint32_t offset, uint32_t size)
+    {
+        if (size == 0)
+            return;
+
+        usedSize -= size;
+
+        // Merge with the next free range
+        auto next = freeByOffset.lower_bound(offset);
+        if (next != freeByOffset.end() && next->first == offset + size) {
+            size += next->second;
+            erase_free(next);
+        }
+
+        // Merge with the previous free range
+        auto it = freeByOffset.lower_bound(offset);
+        if (it != freeByOffset.begin()) {
+            auto prev = std::prev(it);
+            if (prev->first + prev->second == offset) {
+                offset = prev->first;
+                size += prev->second;
+                erase_free(prev);
+            }
+        }
+
+        insert_free(offset, size);
+    }
+
+    void RangeAllocator::grow(uint32_t capacity)
+    {
+        if (capacity <= totalSize)
+            return;
+
+        // The new space is a free range at the end, merged
+        // with the last free range if it reaches the end.
+        uint32_t old_size = totalSize;
+        totalSize = capacity;
+        usedSize += capacity - old_size;
+        free(old_size, capacity - old_size);
+    }
+
+    //----------- GEOMETRY POOL -----------//
+
+    GeometryPool::GeometryPool(uint32_t vertex_capacity, uint32_t index_capacity):
+        vertexAllocator(vertex_capacity), indexAllocator(index_capacity)
+    {
+        vertexBuffer = ref<VertexBuffer>((const Vertex*)nullptr, vertex_capacity, DataAccess::Dynamic);
+        indexBuffer = ref<IndexBuffer>((const uint32_t*)nullptr, index_capacity, DataAccess::Dynamic);
+
+        vertexArray = ref<VertexArray>();
+        binding = vertexArray->add_layout(vertexBuffer->layout);
+        vertexArray->set_vertex_buffer(binding, vertexBuffer->bufferID, 0, vertexBuffer->layout.stride);
+        vertexArray->set_index_buffer(indexBuffer);
+    }
+
+    GeometryHandle GeometryPool::add(const Vertex* vertices, size_t vertex_count, const uint32_t* indices, size_t index_count)
+    {
+        GeometryHandle handle {};
+        if (vertex_count == 0 || index_count == 0)
+            return handle;
+
+        handle.vertex_count = vertex_count;
+        handle.index_count = index_count;
+        handle.base_vertex = allocate(vertexAllocator, vertex_count);
+        handle.first_index = allocate(indexAllocator, index_count);
+
+        vertexBuffer->upload(vertices, vertex_count * sizeof(Vertex), handle.base_vertex * sizeof(Vertex));
+        indexBuffer->upload(indices, index_count * sizeof(uint32_t), handle.first_index * sizeof(uint32_t));
+
+        return handle;
+    }
+
+    GeometryHandle GeometryPool::add(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+    {
+        return add(vertices.data(), vertices.size(), indices.data(), indices.size());
+    }
+
+    GeometryHandle GeometryPool::add(const std::string& path)
+    {
+        std::vector<Vertex> vertices {};
+        std::vector<uint32_t> indices {};
+        load_mesh(path, vertices, indices);
+
+        return add(vertices, indices);
+    }
+
+    void GeometryPool::remove(const GeometryHandle& handle)
+    {
+        if (!handle.valid())
+            return;
+
+        vertexAllocator.free(handle.base_vertex, handle.vertex_count);
+        indexAllocator.free(handle.first_index, handle.index_count);
+    }
+
+    uint32_t GeometryPool::allocate(RangeAllocator& allocator, uint32_t count)
+    {
+        uint32_t offset = allocator.allocate(count);
+        if (offset != RangeAllocator::INVALID)
+            return offset;
+
+        // Double the capacity, or more for large meshes
+        uint64_t capacity = std::max<uint64_t>(2ull * allocator.capacity(), allocator.capacity() + count);
+        MGL_ASSERT(capacity <= std::numeric_limits<uint32_t>::max(), "Geometry pool is full");
+
+        allocator.grow(capacity);
+        resize_buffers();
+
+        return allocator.allocate(count);
+    }
+
+    void GeometryPool::resize_buffers()
+    {
+        if (vertexAllocator.capacity() > vertexBuffer->vertex_count()) {
+            auto buffer = ref<VertexBuffer>((const Vertex*)nullptr, vertexAllocator.capacity(), DataAccess::Dynamic);
+            glCopyNamedBufferSubData(vertexBuffer->bufferID, buffer->bufferID, 0, 0, vertexBuffer->vertex_count() * sizeof(Vertex));
+
+            vertexBuffer = buffer;
+            vertexArray->set_vertex_buffer(binding, vertexBuffer->bufferID, 0, vertexBuffer->layout.stride);
+
+            trace("Geometry pool grown to {} vertices", vertexAllocator.capacity());
+        }
+
+        if (indexAllocator.capacity() > indexBuffer->getCount()) {
+            auto buffer = ref<IndexBuffer>((const uint32_t*)nullptr, indexAllocator.capacity(), DataAccess::Dynamic);
+            glCopyNamedBufferSubData(indexBuffer->idxBufferID, buffer->idxBufferID, 0, 0, indexBuffer->getCount() * sizeof(uint32_t));
+
+            indexBuffer = buffer;
+            vertexArray->set_index_buffer(indexBuffer);
+
+            trace("Geometry pool grown to {} indices", indexAllocator.capacity());
+        }
+    }
+}
\ No newline at end of file
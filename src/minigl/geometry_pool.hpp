@@ -0,0 +1,130 @@
+#pragma once
+
+#include "core.hpp"
+#include "buffer.hpp"
+
+#include <map>
+
+namespace minigl
+{
+    /// Free-list allocator of ranges in `[0, capacity)`, in
+    /// arbitrary units (vertices, indices...). Allocations are
+    /// best fit, and freed ranges are merged with their free
+    /// neighbours, which keeps fragmentation low for the
+    /// typical load/unload patterns of meshes.
+    class RangeAllocator
+    {
+        public:
+
+            static constexpr uint32_t INVALID = std::numeric_limits<uint32_t>::max();
+
+            explicit RangeAllocator(uint32_t capacity = 0);
+
+            /// Allocate `size` units, and return the offset of
+            /// the range, or `INVALID` if there is no free range
+            /// large enough.
+            uint32_t allocate(uint32_t size);
+
+            /// Free a range returned by `allocate()`
+            void free(uint32_t offset, uint32_t size);
+
+            /// Extend the capacity to `capacity` units. The
+            /// allocated ranges are kept.
+            void grow(uint32_t capacity);
+
+            uint32_t capacity() const { return totalSize; }
+            uint32_t used() const { return usedSize; }
+
+        private:
+
+            uint32_t totalSize = 0;
+            uint32_t usedSize = 0;
+
+            /// Free ranges, by offset (for merging) and by size
+            /// (for best fit searches)
+            std::map<uint32_t, uint32_t> freeByOffset;
+            std::multimap<uint32_t, uint32_t> freeBySize;
+
+            void insert_free(uint32_t offset, uint32_t size);
+            void erase_free(std::map<uint32_t, uint32_t>::iterator it);
+    };
+
+    /// Location of a mesh in a `GeometryPool`. The indices are
+    /// relative to the first vertex of the mesh, so the fields
+    /// map directly to those of a `DrawCommand`.
+    struct GeometryHandle
+    {
+        uint32_t first_index = 0;
+        uint32_t index_count = 0;
+        uint32_t base_vertex = 0;
+        uint32_t vertex_count = 0;
+
+        bool valid() const { return index_count > 0; }
+
+        /// Draw command for the mesh
+        DrawCommand draw_command(uint32_t instance_count = 1, uint32_t base_instance = 0) const
+        {
+            return { index_count, instance_count, first_index, base_vertex, base_instance };
+        }
+    };
+
+    /// Shared vertex and index buffers holding the geometry of
+    /// many meshes, behind a single vertex array. Since all
+    /// the meshes use the same buffers, any set of them can be
+    /// drawn with one bind and one multi draw indirect call.
+    ///
+    /// The buffers grow (by copying on the GPU) when they are
+    /// full, which keeps the handles valid but changes the
+    /// buffer IDs: use `vertex_array()` rather than caching
+    /// them.
+    class GeometryPool
+    {
+        public:
+
+            /// Create a pool with room for `vertex_capacity`
+            /// vertices and `index_capacity` indices.
+            GeometryPool(uint32_t vertex_capacity = 1 << 20, uint32_t index_capacity = 1 << 22);
+
+            GeometryPool(const GeometryPool&) = delete;
+            GeometryPool& operator=(const GeometryPool&) = delete;
+
+            /// Copy a mesh into the pool
+            GeometryHandle add(const Vertex* vertices, size_t vertex_count, const uint32_t* indices, size_t index_count);
+            GeometryHandle add(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+            /// Load the OBJ file at `path` (or its cache) into
+            /// the pool
+            GeometryHandle add(const std::string& path);
+
+            /// Free the space of a mesh. Draw commands using it
+            /// must not be executed anymore.
+            void remove(const GeometryHandle& handle);
+
+            /// Vertex array of the shared buffers
+            const Ref<VertexArray>& vertex_array() const { return vertexArray; }
+
+            uint32_t vertex_count() const { return vertexAllocator.used(); }
+            uint32_t index_count() const { return indexAllocator.used(); }
+
+        private:
+
+            RangeAllocator vertexAllocator;
+            RangeAllocator indexAllocator;
+
+            Ref<VertexBuffer> vertexBuffer;
+            Ref<IndexBuffer> indexBuffer;
+            Ref<VertexArray> vertexArray;
+
+            /// Binding index of the vertex buffer in the vertex
+            /// array
+            uint32_t binding;
+
+            /// Allocate `count` units in `allocator`, growing
+            /// the buffers if needed.
+            uint32_t allocate(RangeAllocator& allocator, uint32_t count);
+
+            /// Reallocate the buffers with the current capacity
+            /// of the allocators, and copy their contents.
+            void resize_buffers();
+    };
+}
\ No newline at end of file
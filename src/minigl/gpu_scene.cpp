@@ -0,0 +1,182 @@
+#include "gpu_scene.hpp"
+
+namespace minigl
+{
+    /// Frustum culling shader: one invocation per object,
+    /// which appends the draw command of the object to the
+    /// command buffer if its world space bounding box
+    /// intersects the frustum.
+    static const char* cull_shader_source = R"glsl(
+#ifdef COMPUTE
+layout(local_size_x = 64) in;
+
+struct Object
+{
+    mat4 transform;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uint indexCount;
+    uint firstIndex;
+    int baseVertex;
+    uint padding;
+};
+
+struct DrawCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 8) readonly buffer Objects { Object objects[]; };
+layout(std430, binding = 9) writeonly buffer Commands { DrawCommand commands[]; };
+layout(std430, binding = 10) buffer Count { uint drawCount; };
+
+uniform vec4 u_planes[6];
+uniform uint u_objectCount;
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= u_objectCount)
+        return;
+
+    Object object = objects[id];
+
+    // World space box enclosing the transformed model box
+    vec3 center = 0.5 * (object.boundsMin.xyz + object.boundsMax.xyz);
+    vec3 extent = 0.5 * (object.boundsMax.xyz - object.boundsMin.xyz);
+
+    vec3 worldCenter = (object.transform * vec4(center, 1.0)).xyz;
+    mat3 m = mat3(object.transform);
+    vec3 worldExtent = abs(m[0]) * extent.x + abs(m[1]) * extent.y + abs(m[2]) * extent.z;
+
+    for (int i = 0; i < 6; i++)
+    {
+        vec4 plane = u_planes[i];
+        float radius = dot(worldExtent, abs(plane.xyz));
+        if (dot(plane.xyz, worldCenter) + plane.w < -radius)
+            return;
+    }
+
+    uint slot = atomicAdd(drawCount, 1);
+    commands[slot] = DrawCommand(object.indexCount, 1, object.firstIndex, object.baseVertex, id);
+}
+#endif
+)glsl";
+
+    static_assert(sizeof(GPUObject) == 112, "GPUObject must match the std430 layout of the shaders");
+    static_assert(sizeof(DrawCommand) == 20, "DrawCommand must match the GL indirect command layout");
+
+    GPUScene::GPUScene(uint32_t capacity):
+        maxObjects(capacity)
+    {
+        objects.reserve(capacity);
+
+        glCreateBuffers(1, &objectBufferID);
+        glNamedBufferStorage(objectBufferID, capacity * sizeof(GPUObject), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+        // Only written and read by the GPU
+        glCreateBuffers(1, &commandBufferID);
+        glNamedBufferStorage(commandBufferID, capacity * sizeof(DrawCommand), nullptr, 0);
+
+        glCreateBuffers(1, &countBufferID);
+        glNamedBufferStorage(countBufferID, sizeof(uint32_t), nullptr, 0);
+
+        cullShader = Shader::from_source(cull_shader_source);
+    }
+
+    GPUScene::~GPUScene()
+    {
+        glDeleteBuffers(1, &objectBufferID);
+        glDeleteBuffers(1, &commandBufferID);
+        glDeleteBuffers(1, &countBufferID);
+    }
+
+    uint32_t GPUScene::add(const GPUObject& object)
+    {
+        MGL_ASSERT(objects.size() < maxObjects, "GPU scene is full ({} objects)", maxObjects);
+
+        uint32_t index = objects.size();
+        objects.push_back(object);
+        mark_dirty(index, index + 1);
+
+        return index;
+    }
+
+    void GPUScene::set(uint32_t index, const GPUObject& object)
+    {
+        objects[index] = object;
+        mark_dirty(index, index + 1);
+    }
+
+    void GPUScene::clear()
+    {
+        objects.clear();
+        dirtyBegin = dirtyEnd = 0;
+    }
+
+    void GPUScene::mark_dirty(uint32_t begin, uint32_t end)
+    {
+        if (dirtyBegin == dirtyEnd) {
+            dirtyBegin = begin;
+            dirtyEnd = end;
+        }
+        else {
+            dirtyBegin = std::min(dirtyBegin, begin);
+            dirtyEnd = std::max(dirtyEnd, end);
+        }
+    }
+
+    void GPUScene::cull(const Mat4& viewProj)
+    {
+        if (dirtyBegin != dirtyEnd) {
+            glNamedBufferSubData(objectBufferID,
+                                 dirtyBegin * sizeof(GPUObject),
+                                 (dirtyEnd - dirtyBegin) * sizeof(GPUObject),
+                                 &objects[dirtyBegin]);
+            dirtyBegin = dirtyEnd = 0;
+        }
+
+        uint32_t zero = 0;
+        glClearNamedBufferData(countBufferID, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+        if (objects.empty())
+            return;
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, objectBufferID);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, commandBufferID);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNT_BINDING, countBufferID);
+
+        static const UniformName planes_names[6] = {
+            "u_planes[0]", "u_planes[1]", "u_planes[2]",
+            "u_planes[3]", "u_planes[4]", "u_planes[5]"
+        };
+
+        Frustum frustum {viewProj};
+        for (int i = 0; i < 6; i++)
+            cullShader->upload(planes_names[i], frustum.planes[i]);
+        cullShader->upload("u_objectCount", size());
+
+        cullShader->use();
+        RenderCommand::dispatch_compute((size() + 63) / 64, 1, 1);
+
+        // The commands and the count are read by the draw
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    void GPUScene::draw(const Ref<VertexArray>& vertexArray, Primitives drawPrimitive)
+    {
+        if (objects.empty())
+            return;
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, objectBufferID);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBufferID);
+        glBindBuffer(GL_PARAMETER_BUFFER, countBufferID);
+
+        vertexArray->bind();
+        RenderCommand::draw_indirect_count(vertexArray, size(), drawPrimitive);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "core.hpp"
+#include "geometry.hpp"
+#include "commands.hpp"
+#include "buffer.hpp"
+#include "shader.hpp"
+
+namespace minigl
+{
+    /// Object of a `GPUScene`, laid out like the `Object`
+    /// struct of the shaders (std430).
+    struct GPUObject
+    {
+        /// Model matrix
+        Mat4 transform {1.f};
+
+        /// Bounding box in model space (`w` unused)
+        Vec4 boundsMin {0.f};
+        Vec4 boundsMax {0.f};
+
+        /// Range of the object's mesh in the shared vertex and
+        /// index buffers
+        uint32_t index_count = 0;
+        uint32_t first_index = 0;
+        int32_t base_vertex = 0;
+        uint32_t padding = 0;
+    };
+
+    /// GPU-driven rendering of many objects sharing a vertex
+    /// array. The objects are stored in a shader storage
+    /// buffer; each frame, a compute shader frustum culls them
+    /// and writes the draw commands of the visible ones, which
+    /// are then drawn with a single multi draw indirect call
+    /// whose draw count is read from the GPU. The CPU cost is
+    /// one dispatch and one draw call, whatever the number of
+    /// objects.
+    ///
+    /// Each draw command has the index of its object as base
+    /// instance: vertex shaders find the object with
+    ///
+    /// ```glsl
+    /// #extension GL_ARB_shader_draw_parameters : require
+    /// layout(std430, binding = 8) readonly buffer Objects { Object objects[]; };
+    /// ...
+    /// mat4 model = objects[gl_BaseInstanceARB].transform;
+    /// ```
+    class GPUScene
+    {
+        public:
+
+            /// Shader storage binding point of the objects
+            static constexpr uint32_t OBJECT_BINDING = 8;
+
+            /// Shader storage binding point of the culled draw
+            /// commands
+            static constexpr uint32_t COMMAND_BINDING = 9;
+
+            /// Shader storage binding point of the draw count
+            static constexpr uint32_t COUNT_BINDING = 10;
+
+            /// Create a scene holding up to `capacity` objects
+            explicit GPUScene(uint32_t capacity);
+
+            /// Destructor: deletes the buffers.
+            virtual ~GPUScene();
+
+            GPUScene(const GPUScene&) = delete;
+            GPUScene& operator=(const GPUScene&) = delete;
+
+            /// Add an object and return its index
+            uint32_t add(const GPUObject& object);
+
+            /// Replace the object at `index`
+            void set(uint32_t index, const GPUObject& object);
+
+            const GPUObject& get(uint32_t index) const { return objects[index]; }
+
+            /// Remove all the objects
+            void clear();
+
+            uint32_t size() const { return (uint32_t)objects.size(); }
+            uint32_t capacity() const { return maxObjects; }
+
+            /// Upload the modified objects, and cull them
+            /// against the frustum of `viewProj` on the GPU.
+            void cull(const Mat4& viewProj);
+
+            /// Draw the objects that passed the last `cull()`,
+            /// with the given vertex array and the shader in
+            /// use.
+            void draw(const Ref<VertexArray>& vertexArray, Primitives drawPrimitive = Primitives::TRIANGLES);
+
+        private:
+
+            uint32_t maxObjects;
+            std::vector<GPUObject> objects;
+
+            /// Range of `objects` modified since the last
+            /// upload
+            uint32_t dirtyBegin = 0;
+            uint32_t dirtyEnd = 0;
+
+            uint32_t objectBufferID;
+            uint32_t commandBufferID;
+            uint32_t countBufferID;
+
+            Ref<Shader> cullShader;
+
+            void mark_dirty(uint32_t begin, uint32_t end);
+    };
+}
\ No newline at end of file
@@ -0,0 +1,431 @@
+#include "lod.hpp"
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+
+namespace minigl
+{
+    //----------- QUADRICS -----------//
+
+    /// Sum of squared distances to a set of weighted planes,
+    /// as the symmetric matrix `A`, the vector `b` and the
+    /// constant `c` of `p^T A p + 2 b.p + c`. Doubles, as
+    /// quadrics of large meshes accumulate many planes.
+    struct Quadric
+    {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0;
+        double c = 0;
+        double weight = 0;
+
+        /// Quadric of the plane of normal `n` (unit length)
+        /// through `p`
+        static Quadric plane(const Vec3& n, const Vec3& p, double weight)
+        {
+            double d = -glm::dot(n, p);
+            Quadric q {};
+            q.a00 = weight * n.x * n.x; q.a01 = weight * n.x * n.y; q.a02 = weight * n.x * n.z;
+            q.a11 = weight * n.y * n.y; q.a12 = weight * n.y * n.z;
+            q.a22 = weight * n.z * n.z;
+            q.b0 = weight * n.x * d; q.b1 = weight * n.y * d; q.b2 = weight * n.z * d;
+            q.c = weight * d * d;
+            q.weight = weight;
+            return q;
+        }
+
+        Quadric& operator+=(const Quadric& q)
+        {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02;
+            a11 += q.a11; a12 += q.a12; a22 += q.a22;
+            b0 += q.b0; b1 += q.b1; b2 += q.b2;
+            c += q.c;
+            weight += q.weight;
+            return *this;
+        }
+
+        /// Weighted mean squared distance of `p` to the planes
+        double error(const Vec3& p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double e = a00*x*x + a11*y*y + a22*z*z
+                     + 2 * (a01*x*y + a02*x*z + a12*y*z)
+                     + 2 * (b0*x + b1*y + b2*z) + c;
+            return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+        }
+    };
+
+    //----------- SIMPLIFICATION -----------//
+
+    /// Boundary planes weigh more than the surface ones, so
+    /// that borders and seams barely move.
+    static constexpr double BOUNDARY_WEIGHT = 10.0;
+
+    namespace
+    {
+        struct Collapse
+        {
+            double cost;
+            uint32_t from, to;
+            uint32_t fromVersion, toVersion;
+
+            bool operator>(const Collapse& other) const { return cost > other.cost; }
+        };
+
+        struct EdgeHash
+        {
+            size_t operator()(uint64_t edge) const { return std::hash<uint64_t>{}(edge * 0x9e3779b97f4a7c15ull); }
+        };
+
+        uint64_t edge_key(uint32_t a, uint32_t b)
+        {
+            return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+        }
+    }
+
+    std::vector<uint32_t> simplify(const std::vector<Vertex>& vertices,
+                                   const std::vector<uint32_t>& indices,
+                                   size_t target_index_count,
+                                   float max_error,
+                                   float* result_error)
+    {
+        uint32_t vertex_count = vertices.size();
+        uint32_t triangle_count = indices.size() / 3;
+
+        // Vertices at the same position (split on attribute
+        // seams) collapse together: the simplification works
+        // on positions, and every vertex is a wedge of its
+        // position.
+        std::vector<uint32_t> position_of(vertex_count);
+        std::vector<uint32_t> position_vertex {};
+        {
+            struct PositionHash
+            {
+                size_t operator()(const Vec3& p) const { return hash_bytes(&p, sizeof(p)); }
+            };
+
+            std::unordered_map<Vec3, uint32_t, PositionHash> unique {};
+            unique.reserve(vertex_count);
+            for (uint32_t v = 0; v < vertex_count; v++) {
+                auto [it, inserted] = unique.try_emplace(vertices[v].pos, (uint32_t)position_vertex.size());
+                if (inserted)
+                    position_vertex.push_back(v);
+                position_of[v] = it->second;
+            }
+        }
+
+        uint32_t position_count = position_vertex.size();
+        auto position = [&](uint32_t p) -> const Vec3& { return vertices[position_vertex[p]].pos; };
+
+        std::vector<std::vector<uint32_t>> wedges(position_count);
+        for (uint32_t v = 0; v < vertex_count; v++)
+            wedges[position_of[v]].push_back(v);
+
+        std::vector<uint32_t> corners = indices;
+        std::vector<bool> alive(triangle_count, true);
+        uint32_t alive_count = triangle_count;
+
+        std::vector<std::vector<uint32_t>> position_triangles(position_count);
+        for (uint32_t t = 0; t < triangle_count; t++)
+            for (int k = 0; k < 3; k++)
+                position_triangles[position_of[corners[3*t+k]]].push_back(t);
+
+        // Surface quadrics, weighted by triangle area
+        std::vector<Quadric> quadrics(position_count);
+        for (uint32_t t = 0; t < triangle_count; t++)
+        {
+            auto& p0 = vertices[corners[3*t+0]].pos;
+            auto& p1 = vertices[corners[3*t+1]].pos;
+            auto& p2 = vertices[corners[3*t+2]].pos;
+
+            Vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(n);
+            if (area == 0.f)
+                continue;
+
+            auto q = Quadric::plane(n / area, p0, area * 0.5);
+            for (int k = 0; k < 3; k++)
+                quadrics[position_of[corners[3*t+k]]] += q;
+        }
+
+        // Boundary quadrics: edges used by a single triangle,
+        // either on a border of the mesh or on a seam (the
+        // same positions with different wedges on each side),
+        // get a plane through the edge, perpendicular to the
+        // triangle.
+        {
+            std::unordered_map<uint64_t, uint32_t, EdgeHash> edge_uses {};
+            edge_uses.reserve(indices.size());
+            for (uint32_t i = 0; i < indices.size(); i++) {
+                uint32_t a = corners[i], b = corners[i - i % 3 + (i + 1) % 3];
+                edge_uses[edge_key(a, b)]++;
+            }
+
+            for (uint32_t t = 0; t < triangle_count; t++)
+            {
+                auto& p0 = vertices[corners[3*t+0]].pos;
+                auto& p1 = vertices[corners[3*t+1]].pos;
+                auto& p2 = vertices[corners[3*t+2]].pos;
+                Vec3 n = glm::cross(p1 - p0, p2 - p0);
+                if (glm::length(n) == 0.f)
+                    continue;
+
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t a = corners[3*t+k], b = corners[3*t+(k+1)%3];
+                    if (edge_uses[edge_key(a, b)] != 1)
+                        continue;
+
+                    Vec3 edge = vertices[b].pos - vertices[a].pos;
+                    float length = glm::length(edge);
+                    if (length == 0.f)
+                        continue;
+
+                    Vec3 normal = glm::normalize(glm::cross(edge, n));
+                    auto q = Quadric::plane(normal, vertices[a].pos, BOUNDARY_WEIGHT * length * length);
+                    quadrics[position_of[a]] += q;
+                    quadrics[position_of[b]] += q;
+                }
+            }
+        }
+
+        std::vector<uint32_t> version(position_count, 0);
+        std::vector<bool> removed(position_count, false);
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue {};
+
+        // Queue the cheapest direction of the collapse of the
+        // edge between positions `a` and `b`
+        auto push_edge = [&](uint32_t a, uint32_t b)
+        {
+            Quadric q = quadrics[a];
+            q += quadrics[b];
+            double to_b = q.error(position(b));
+            double to_a = q.error(position(a));
+
+            if (to_b <= to_a)
+                queue.push({to_b, a, b, version[a], version[b]});
+            else
+                queue.push({to_a, b, a, version[b], version[a]});
+        };
+
+        {
+            std::unordered_map<uint64_t, bool, EdgeHash> queued {};
+            queued.reserve(indices.size());
+            for (uint32_t t = 0; t < triangle_count; t++) {
+                for (int k = 0; k < 3; k++) {
+                    uint32_t a = position_of[corners[3*t+k]], b = position_of[corners[3*t+(k+1)%3]];
+                    if (a != b && queued.try_emplace(edge_key(a, b), true).second)
+                        push_edge(a, b);
+                }
+            }
+        }
+
+        auto contains = [&](uint32_t t, uint32_t p) {
+            return position_of[corners[3*t]] == p || position_of[corners[3*t+1]] == p || position_of[corners[3*t+2]] == p;
+        };
+
+        double max_cost = (double)max_error * max_error;
+        double worst = 0.0;
+
+        uint32_t target_triangles = target_index_count / 3;
+        std::vector<uint32_t> neighbours {};
+
+        while (alive_count > target_triangles && !queue.empty())
+        {
+            Collapse collapse = queue.top();
+            queue.pop();
+
+            uint32_t u = collapse.from, v = collapse.to;
+            if (removed[u] || removed[v] || version[u] != collapse.fromVersion || version[v] != collapse.toVersion)
+                continue;
+            if (collapse.cost > max_cost)
+                break;
+
+            // Reject collapses that flip a triangle
+            const Vec3& target = position(v);
+            bool flips = false;
+            for (auto t: position_triangles[u])
+            {
+                if (!alive[t] || contains(t, v))
+                    continue;
+
+                Vec3 p[3], moved[3];
+                for (int k = 0; k < 3; k++) {
+                    p[k] = vertices[corners[3*t+k]].pos;
+                    moved[k] = position_of[corners[3*t+k]] == u ? target : p[k];
+                }
+
+                Vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                Vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                if (glm::dot(before, after) <= 0.f) {
+                    flips = true;
+                    break;
+                }
+            }
+
+            if (flips)
+                continue;
+
+            // Each wedge of `u` becomes the wedge of `v` with
+            // the closest attributes.
+            auto wedge_of_v = [&](uint32_t wedge)
+            {
+                uint32_t best = wedges[v][0];
+                float best_distance = std::numeric_limits<float>::max();
+                for (auto candidate: wedges[v]) {
+                    Vec2 dt = vertices[candidate].tex - vertices[wedge].tex;
+                    Vec3 dn = vertices[candidate].normal - vertices[wedge].normal;
+                    float distance = glm::dot(dt, dt) + glm::dot(dn, dn);
+                    if (distance < best_distance) {
+                        best = candidate;
+                        best_distance = distance;
+                    }
+                }
+                return best;
+            };
+
+            for (auto t: position_triangles[u])
+            {
+                if (!alive[t])
+                    continue;
+
+                if (contains(t, v)) {
+                    alive[t] = false;
+                    alive_count--;
+                    continue;
+                }
+
+                for (int k = 0; k < 3; k++)
+                    if (position_of[corners[3*t+k]] == u)
+                        corners[3*t+k] = wedge_of_v(corners[3*t+k]);
+
+                position_triangles[v].push_back(t);
+            }
+
+            for (auto wedge: wedges[u])
+                position_of[wedge] = v;
+            wedges[v].insert(wedges[v].end(), wedges[u].begin(), wedges[u].end());
+
+            removed[u] = true;
+            position_triangles[u].clear();
+            position_triangles[u].shrink_to_fit();
+            quadrics[v] += quadrics[u];
+            version[v]++;
+            worst = std::max(worst, collapse.cost);
+
+            // Drop the dead triangles of `v`, and requeue the
+            // collapses of its edges, whose costs changed.
+            auto& triangles = position_triangles[v];
+            triangles.erase(std::remove_if(triangles.begin(), triangles.end(),
+                                           [&](uint32_t t) { return !alive[t]; }),
+                            triangles.end());
+
+            neighbours.clear();
+            for (auto t: triangles)
+                for (int k = 0; k < 3; k++)
+                    if (position_of[corners[3*t+k]] != v)
+                        neighbours.push_back(position_of[corners[3*t+k]]);
+
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+            for (auto n: neighbours)
+                push_edge(v, n);
+        }
+
+        std::vector<uint32_t> result {};
+        result.reserve(3 * alive_count);
+        for (uint32_t t = 0; t < triangle_count; t++)
+            if (alive[t])
+                result.insert(result.end(), {corners[3*t], corners[3*t+1], corners[3*t+2]});
+
+        if (result_error)
+            *result_error = (float)std::sqrt(worst);
+
+        return result;
+    }
+
+    //----------- LEVELS OF DETAIL -----------//
+
+    std::vector<LOD> build_lods(const std::vector<Vertex>& vertices,
+                                std::vector<uint32_t>& indices,
+                                uint32_t max_lods,
+                                float reduction,
+                                uint32_t min_triangles)
+    {
+        std::vector<LOD> lods {};
+        lods.push_back({0, (uint32_t)indices.size(), 0.f});
+
+        // Each level simplifies the previous one, which is
+        // faster than starting over from the full mesh; the
+        // errors add up.
+        std::vector<uint32_t> level(indices.begin(), indices.end());
+        while (lods.size() < max_lods && level.size() / 3 > min_triangles)
+        {
+            size_t target = std::max<size_t>((size_t)(level.size() * reduction) / 3, min_triangles) * 3;
+
+            float error = 0.f;
+            auto simplified = simplify(vertices, level, target, std::numeric_limits<float>::max(), &error);
+
+            // Stop once the mesh cannot be simplified further
+            if (simplified.size() > level.size() * 0.9f || simplified.empty())
+                break;
+
+            optimize_vertex_cache(simplified, vertices.size());
+
+            lods.push_back({(uint32_t)indices.size(), (uint32_t)simplified.size(), lods.back().error + error});
+            indices.insert(indices.end(), simplified.begin(), simplified.end());
+            level = std::move(simplified);
+        }
+
+        return lods;
+    }
+
+    Ref<Mesh> load_lod_mesh(const std::string& path, DataAccess usage)
+    {
+        std::vector<Vertex> vertices {};
+        std::vector<uint32_t> indices {};
+        load_mesh(path, vertices, indices);
+
+        auto lods = build_lods(vertices, indices);
+        trace("Built {} levels of detail for mesh '{}', down to {} triangles", lods.size(), path, lods.back().index_count / 3);
+
+        auto mesh = ref<Mesh>(vertices, indices, usage);
+        mesh->lods = std::move(lods);
+
+        return mesh;
+    }
+
+    uint32_t select_lod(const Mesh& mesh, const Mat4& model, const PerspectiveCamera& camera,
+                        float viewport_height, float max_pixel_error)
+    {
+        if (mesh.lods.size() <= 1)
+            return 0;
+
+        float scale = std::max({
+            glm::length(Vec3{model[0]}),
+            glm::length(Vec3{model[1]}),
+            glm::length(Vec3{model[2]})
+        });
+
+        Vec3 center = Vec3{model * Vec4{mesh.sphere.center, 1.f}};
+        float distance = glm::length(center - camera.getPosition()) - mesh.sphere.radius * scale;
+
+        // Inside the bounding sphere: full detail
+        if (distance <= 0.f)
+            return 0;
+
+        // An error of 1 at a distance of 1 spans proj[1][1]
+        // half viewports (1 / tan(fov/2)).
+        float pixels_per_unit = camera.proj[1][1] * viewport_height * 0.5f / distance;
+
+        uint32_t selected = 0;
+        for (uint32_t i = 1; i < mesh.lods.size(); i++) {
+            if (mesh.lods[i].error * scale * pixels_per_unit > max_pixel_error)
+                break;
+            selected = i;
+        }
+
+        return selected;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "core.hpp"
+#include "buffer.hpp"
+#include "mesh.hpp"
+#include "app/camera.hpp"
+
+namespace minigl
+{
+    /// Simplify a triangle mesh by quadric error metric edge
+    /// collapses (Garland and Heckbert), down to at most
+    /// `target_index_count` indices if possible. Vertices are
+    /// collapsed onto their neighbours, so the result indexes
+    /// the same vertex buffer. Borders and attribute seams are
+    /// preserved, and collapses that flip triangles or cost
+    /// more than `max_error` (model space distance) are
+    /// rejected. The largest error of the collapses is written
+    /// to `result_error`, if provided.
+    std::vector<uint32_t> simplify(const std::vector<Vertex>& vertices,
+                                   const std::vector<uint32_t>& indices,
+                                   size_t target_index_count,
+                                   float max_error = std::numeric_limits<float>::max(),
+                                   float* result_error = nullptr);
+
+    /// Build a chain of levels of detail for a mesh, each with
+    /// about `reduction` times the triangles of the previous
+    /// one, until `max_lods` levels or `min_triangles`
+    /// triangles. The levels are appended to `indices`, after
+    /// the full detail level, which is the first returned LOD.
+    std::vector<LOD> build_lods(const std::vector<Vertex>& vertices,
+                                std::vector<uint32_t>& indices,
+                                uint32_t max_lods = 8,
+                                float reduction = 0.5f,
+                                uint32_t min_triangles = 256);
+
+    /// Load the OBJ file at `path` and create a mesh with its
+    /// chain of levels of detail.
+    Ref<Mesh> load_lod_mesh(const std::string& path, DataAccess usage = DataAccess::Static);
+
+    /// Select the coarsest level of detail of `mesh` whose
+    /// error, projected on screen, stays below
+    /// `max_pixel_error` pixels, for an instance drawn with the
+    /// `model` matrix and seen from `camera` in a viewport of
+    /// `viewport_height` pixels. The error is projected at the
+    /// point of the bounding sphere closest to the camera.
+    uint32_t select_lod(const Mesh& mesh, const Mat4& model, const PerspectiveCamera& camera,
+                        float viewport_height, float max_pixel_error = 1.f);
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace minigl
+{
+#ifdef _WIN32
+    MappedFile::MappedFile(const std::string& path)
+    {
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            file = nullptr;
+            return;
+        }
+
+        LARGE_INTEGER file_size {};
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+            return;
+
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+            return;
+
+        ptr = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        length = ptr ? (size_t)file_size.QuadPart : 0;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (ptr)
+            UnmapViewOfFile(ptr);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file)
+            CloseHandle(file);
+    }
+#else
+    MappedFile::MappedFile(const std::string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+
+        struct stat st {};
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            // The mapping keeps its own reference to the file,
+            // so the descriptor can be closed right away.
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                ptr = (const uint8_t*)addr;
+                length = st.st_size;
+            }
+        }
+
+        close(fd);
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (ptr)
+            munmap((void*)ptr, length);
+    }
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "core.hpp"
+
+namespace minigl
+{
+    /// Read-only memory mapping of a whole file. The contents
+    /// are paged in by the OS on access, so large files can be
+    /// read without copying them into an intermediate buffer.
+    class MappedFile
+    {
+        public:
+
+            /// Map the file at `path`. If the file does not
+            /// exist or cannot be mapped, the mapping is left
+            /// invalid (see `valid()`).
+            explicit MappedFile(const std::string& path);
+
+            /// Destructor: unmaps the file.
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            bool valid() const { return ptr != nullptr; }
+            const uint8_t* data() const { return ptr; }
+            size_t size() const { return length; }
+
+        private:
+
+            const uint8_t* ptr = nullptr;
+            size_t length = 0;
+
+            // Native file and mapping handles (Windows only)
+            void* file = nullptr;
+            void* mapping = nullptr;
+    };
+}
\ No newline at end of file
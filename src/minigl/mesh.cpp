@@ -1,132 +1,204 @@
 #include "mesh.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "obj_parser.hpp"
+#include "thread_pool.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
 namespace minigl
 {
-    Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, DataAccess usage):
-        vertices(vertices), indices(indices)
+    /// Hash of a tinyobj (position, normal, texcoord) index
+    /// triple. Two face corners with the same triple describe
+    /// exactly the same vertex.
+    struct IndexHash
     {
-        auto vb = std::make_shared<VertexBuffer>(vertices, usage);
-        auto ib = std::make_shared<IndexBuffer>(indices, usage);
+        size_t operator()(const tinyobj::index_t& idx) const
+        {
+            size_t h = std::hash<int>{}(idx.vertex_index);
+            h ^= std::hash<int>{}(idx.normal_index) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            h ^= std::hash<int>{}(idx.texcoord_index) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
 
-        vertexArray = std::make_shared<VertexArray>(vb, ib);
+    struct IndexEqual
+    {
+        bool operator()(const tinyobj::index_t& a, const tinyobj::index_t& b) const
+        {
+            return a.vertex_index == b.vertex_index
+                && a.normal_index == b.normal_index
+                && a.texcoord_index == b.texcoord_index;
+        }
+    };
+
+    /// Vertex of the (position, normal, texcoord) index
+    /// triple `idx`.
+    static Vertex make_vertex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& idx)
+    {
+        Vertex vertex {};
+        vertex.pos = {
+            attrib.vertices[3*idx.vertex_index+0],
+            attrib.vertices[3*idx.vertex_index+1],
+            attrib.vertices[3*idx.vertex_index+2]
+        };
+
+        if (idx.normal_index >= 0) {
+            vertex.normal = {
+                attrib.normals[3*idx.normal_index+0],
+                attrib.normals[3*idx.normal_index+1],
+                attrib.normals[3*idx.normal_index+2]
+            };
+        }
+
+        if (idx.texcoord_index >= 0) {
+            vertex.tex = {
+                attrib.texcoords[2*idx.texcoord_index+0],
+                attrib.texcoords[2*idx.texcoord_index+1]
+            };
+        }
+
+        return vertex;
     }
 
-    Mesh::Mesh(const std::string& path, DataAccess usage)
+    /// Weld the face corners of an OBJ shape. OBJ files index
+    /// positions, normals and texture coordinates separately:
+    /// each unique index triple of the shape is added to
+    /// `keys`, in order of first use, and `indices` references
+    /// the triples by their position in `keys`.
+    static void weld_shape(const tinyobj::shape_t& shape,
+                           std::vector<tinyobj::index_t>& keys,
+                           std::vector<uint32_t>& indices)
     {
-        load_mesh(path, vertices, indices);
-        
-        auto vb = std::make_shared<VertexBuffer>(vertices, usage);
-        auto ib = std::make_shared<IndexBuffer>(indices, usage);
-        vertexArray = std::make_shared<VertexArray>(vb, ib);
+        // There is exactly one index per face corner, and
+        // usually a few corners per vertex.
+        indices.reserve(shape.mesh.indices.size());
+        keys.reserve(shape.mesh.indices.size()/4);
+
+        std::unordered_map<tinyobj::index_t, uint32_t, IndexHash, IndexEqual> unique {};
+        unique.reserve(shape.mesh.indices.size()/4);
+
+        for (auto& idx: shape.mesh.indices) {
+            auto [it, inserted] = unique.try_emplace(idx, (uint32_t)keys.size());
+            if (inserted)
+                keys.push_back(idx);
+
+            indices.push_back(it->second);
+        }
     }
 
-    void load_mesh(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
-        tinyobj::ObjReader reader {};
-        if (!reader.ParseFromFile(path))
-            MGL_ASSERT(false, "Failed to parse file '{}'", path);
-        if (!reader.Error().empty())
-            MGL_ASSERT(false, "TinyObjLoader error: {}", reader.Error());
-        if (!reader.Warning().empty())
-            warn("TinyObjLoader warning: {}", reader.Warning());
-        
-        auto& attrib = reader.GetAttrib();
-        auto& shapes = reader.GetShapes();
-
-        vertices.reserve(attrib.vertices.size()/3);
-        indices.reserve(vertices.size()*6);
-        
-        for (auto& shape: shapes) {
-            size_t index_offset = 0;
-            for (auto& fv: shape.mesh.num_face_vertices) {
-                for (size_t v = 0; v < fv; v++) {
-                    tinyobj::index_t idx = shape.mesh.indices[index_offset + v];
-                    
-                    Vertex vertex {};
-                    vertex.pos = {
-                        attrib.vertices[3*idx.vertex_index+0],
-                        attrib.vertices[3*idx.vertex_index+1],
-                        attrib.vertices[3*idx.vertex_index+2]
-                    };
-
-                    if (idx.normal_index >= 0) {
-                        vertex.normal = {
-                            attrib.normals[3*idx.normal_index+0],
-                            attrib.normals[3*idx.normal_index+1],
-                            attrib.normals[3*idx.normal_index+2]
-                        };
-                    }
-
-                    if (idx.texcoord_index >= 0) {
-                        vertex.tex = {
-                            attrib.texcoords[2*idx.texcoord_index+0],
-                            attrib.texcoords[2*idx.texcoord_index+1]
-                        };
-                    }
-
-                    vertices.push_back(vertex);
-                    indices.push_back(indices.size());
-                }
-                index_offset += fv;
+    /// Build the vertex and index buffers of all the OBJ
+    /// shapes. Two face corners with the same index triple
+    /// become a single vertex, even across shapes (`o`, `g`
+    /// and `usemtl` groups often share corners). The shapes
+    /// are welded in parallel; their unique triples, far fewer
+    /// than the corners, are then merged into global vertices,
+    /// and the shape indices remapped to them in parallel.
+    static void weld_vertices(const tinyobj::attrib_t& attrib,
+                              const std::vector<tinyobj::shape_t>& shapes,
+                              std::vector<Vertex>& vertices,
+                              std::vector<uint32_t>& indices)
+    {
+        std::vector<std::vector<tinyobj::index_t>> shape_keys(shapes.size());
+        std::vector<std::vector<uint32_t>> shape_indices(shapes.size());
+
+        parallel_for(shapes.size(), [&](size_t begin, size_t end) {
+            for (size_t s = begin; s < end; s++)
+                weld_shape(shapes[s], shape_keys[s], shape_indices[s]);
+        });
+
+        // Merge the triples of all the shapes, in order, so
+        // that vertices keep their order of first use.
+        size_t key_count = 0;
+        for (auto& keys: shape_keys)
+            key_count += keys.size();
+
+        std::unordered_map<tinyobj::index_t, uint32_t, IndexHash, IndexEqual> unique {};
+        unique.reserve(key_count);
+
+        std::vector<tinyobj::index_t> keys {};
+        std::vector<std::vector<uint32_t>> remap(shapes.size());
+        uint32_t base = vertices.size();
+
+        for (size_t s = 0; s < shapes.size(); s++) {
+            remap[s].reserve(shape_keys[s].size());
+            for (auto& idx: shape_keys[s]) {
+                auto [it, inserted] = unique.try_emplace(idx, base + (uint32_t)keys.size());
+                if (inserted)
+                    keys.push_back(idx);
+
+                remap[s].push_back(it->second);
             }
         }
 
-        trace("Imported mesh from file '{}'", path);
+        vertices.resize(base + keys.size());
+        parallel_for(keys.size(), [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++)
+                vertices[base + k] = make_vertex(attrib, keys[k]);
+        }, 1024);
+
+        std::vector<size_t> index_offset(shapes.size() + 1, indices.size());
+        for (size_t s = 0; s < shapes.size(); s++)
+            index_offset[s+1] = index_offset[s] + shape_indices[s].size();
+
+        indices.resize(index_offset.back());
+
+        parallel_for(shapes.size(), [&](size_t begin, size_t end) {
+            for (size_t s = begin; s < end; s++) {
+                auto& shape_remap = remap[s];
+                std::transform(shape_indices[s].begin(), shape_indices[s].end(), indices.begin() + index_offset[s],
+                               [&shape_remap](uint32_t index) { return shape_remap[index]; });
+            }
+        });
     }
 
-    void load_mesh(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Material>& materials) {
-        tinyobj::ObjReader reader {};
-        if (!reader.ParseFromFile(path))
-            MGL_ASSERT(false, "Failed to parse file '{}'", path);
-        if (!reader.Error().empty())
-            MGL_ASSERT(false, "TinyObjLoader error: {}", reader.Error());
-        if (!reader.Warning().empty())
-            warn("TinyObjLoader warning: {}", reader.Warning());
-        
-        auto& attrib = reader.GetAttrib();
-        auto& shapes = reader.GetShapes();
-        auto& mats = reader.GetMaterials();
-
-        vertices.reserve(attrib.vertices.size()/3);
-        indices.reserve(vertices.size()*6);
-        materials.reserve(indices.size()/3);
-        
-        for (auto& shape: shapes) {
-            size_t index_offset = 0;
-            for (auto& fv: shape.mesh.num_face_vertices) {
-                for (size_t v = 0; v < fv; v++) {
-                    tinyobj::index_t idx = shape.mesh.indices[index_offset + v];
-                    
-                    Vertex vertex {};
-                    vertex.pos = {
-                        attrib.vertices[3*idx.vertex_index+0],
-                        attrib.vertices[3*idx.vertex_index+1],
-                        attrib.vertices[3*idx.vertex_index+2]
-                    };
-
-                    if (idx.normal_index >= 0) {
-                        vertex.normal = {
-                            attrib.normals[3*idx.normal_index+0],
-                            attrib.normals[3*idx.normal_index+1],
-                            attrib.normals[3*idx.normal_index+2]
-                        };
-                    }
-
-                    if (idx.texcoord_index >= 0) {
-                        vertex.tex = {
-                            attrib.texcoords[2*idx.texcoord_index+0],
-                            attrib.texcoords[2*idx.texcoord_index+1]
-                        };
-                    }
-
-                    vertices.push_back(vertex);
-                    indices.push_back(indices.size());
-                }
-                index_offset += fv;
+    /// Parse the OBJ file at `path` with the given parser and
+    /// write its binary cache. The mesh is built in local
+    /// buffers, which then replace the contents of the output
+    /// vectors, so that only this file's data is optimized and
+    /// cached.
+    static void parse_mesh(const std::string& path, std::vector<Vertex>& out_vertices, std::vector<uint32_t>& out_indices, std::vector<Material>& out_materials, ObjParser parser)
+    {
+        std::vector<Vertex> vertices {};
+        std::vector<uint32_t> indices {};
+        std::vector<Material> materials {};
+
+        tinyobj::attrib_t attrib {};
+        std::vector<tinyobj::shape_t> shapes {};
+        std::vector<tinyobj::material_t> mats {};
+        std::string warning, err;
+
+        bool parsed = false;
+        switch (parser)
+        {
+            case ObjParser::TinyObj: {
+                // Look for the material files next to the OBJ
+                // file, like tinyobj::ObjReader does.
+                auto directory = std::filesystem::path(path).parent_path().string();
+                if (!directory.empty())
+                    directory += "/";
+
+                parsed = tinyobj::LoadObj(&attrib, &shapes, &mats, &warning, &err, path.c_str(), directory.c_str());
+                break;
             }
 
+            case ObjParser::Parallel:
+                parsed = parse_obj_parallel(path, attrib, shapes, mats, warning, err);
+                break;
+        }
+
+        if (!parsed)
+            MGL_ASSERT(false, "Failed to parse file '{}': {}", path, err);
+        if (!err.empty())
+            MGL_ASSERT(false, "OBJ parser error: {}", err);
+        if (!warning.empty())
+            warn("OBJ parser warning: {}", warning);
+
+        weld_vertices(attrib, shapes, vertices, indices);
+        materials.reserve(indices.size()/3);
+
+        for (auto& shape: shapes) {
             for (auto& mat_id: shape.mesh.material_ids) {
                 if (mat_id < 0) continue;
                 
@@ -145,5 +217,118 @@ namespace minigl
         }
 
         trace("Imported mesh from file '{}'", path);
+
+        // Optimized once here, the cache stores the
+        // optimized buffers.
+        auto stats = optimize_mesh(vertices, indices, materials);
+        trace("Optimized mesh '{}': ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", path,
+              stats.before.acmr, stats.after.acmr, stats.before.atvr, stats.after.atvr);
+
+        auto bounds = compute_bounds(vertices);
+        MeshCache::write(path, vertices, indices, materials, bounds, compute_sphere(vertices, bounds));
+
+        out_vertices = std::move(vertices);
+        out_indices = std::move(indices);
+        out_materials = std::move(materials);
+    }
+
+    Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, DataAccess usage):
+        vertices(vertices), indices(indices), bounds(compute_bounds(vertices)),
+        sphere(compute_sphere(vertices, bounds))
+    {
+        auto vb = std::make_shared<VertexBuffer>(vertices, usage);
+        auto ib = std::make_shared<IndexBuffer>(indices, usage);
+
+        vertexArray = std::make_shared<VertexArray>(vb, ib);
+    }
+
+    Mesh::Mesh(const std::string& path, DataAccess usage, ObjParser parser, bool keep_cpu_data)
+    {
+        {
+            MeshCache cache {path};
+            if (cache.valid()) {
+                // Upload the buffers straight from the mapping,
+                // without going through the vertex vectors.
+                auto vb = std::make_shared<VertexBuffer>(cache.vertices(), cache.vertex_count(), usage);
+                auto ib = std::make_shared<IndexBuffer>(cache.indices(), cache.index_count(), usage);
+                vertexArray = std::make_shared<VertexArray>(vb, ib);
+
+                if (keep_cpu_data) {
+                    vertices.assign(cache.vertices(), cache.vertices() + cache.vertex_count());
+                    indices.assign(cache.indices(), cache.indices() + cache.index_count());
+                }
+                materials.assign(cache.materials(), cache.materials() + cache.material_count());
+                bounds = cache.bounds();
+                sphere = cache.sphere();
+
+                trace("Loaded mesh from cache '{}'", MeshCache::cache_path(path));
+                return;
+            }
+        }
+
+        // The stale cache (if any) is unmapped at this point,
+        // so that it can be overwritten.
+        parse_mesh(path, vertices, indices, materials, parser);
+        bounds = compute_bounds(vertices);
+        sphere = compute_sphere(vertices, bounds);
+
+        auto vb = std::make_shared<VertexBuffer>(vertices, usage);
+        auto ib = std::make_shared<IndexBuffer>(indices, usage);
+        vertexArray = std::make_shared<VertexArray>(vb, ib);
+
+        // Same CPU data as a cache hit
+        if (!keep_cpu_data) {
+            vertices = {};
+            indices = {};
+        }
+    }
+
+    AABB compute_bounds(const std::vector<Vertex>& vertices)
+    {
+        AABB bounds {};
+        for (auto& vertex: vertices)
+            bounds.expand(vertex.pos);
+
+        return bounds;
+    }
+
+    Sphere compute_sphere(const std::vector<Vertex>& vertices, const AABB& bounds)
+    {
+        Sphere sphere {};
+        if (bounds.empty())
+            return sphere;
+
+        // Tighter than the sphere enclosing the box, whose
+        // corners are usually far from any vertex.
+        sphere.center = bounds.center();
+        float radius2 = 0.f;
+        for (auto& vertex: vertices) {
+            Vec3 d = vertex.pos - sphere.center;
+            radius2 = std::max(radius2, glm::dot(d, d));
+        }
+
+        sphere.radius = std::sqrt(radius2);
+        return sphere;
+    }
+
+    void load_mesh(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, ObjParser parser) {
+        std::vector<Material> materials {};
+        load_mesh(path, vertices, indices, materials, parser);
+    }
+
+    void load_mesh(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Material>& materials, ObjParser parser) {
+        {
+            MeshCache cache {path};
+            if (cache.valid()) {
+                vertices.assign(cache.vertices(), cache.vertices() + cache.vertex_count());
+                indices.assign(cache.indices(), cache.indices() + cache.index_count());
+                materials.assign(cache.materials(), cache.materials() + cache.material_count());
+
+                trace("Loaded mesh from cache '{}'", MeshCache::cache_path(path));
+                return;
+            }
+        }
+
+        parse_mesh(path, vertices, indices, materials, parser);
     }
 }
\ No newline at end of file
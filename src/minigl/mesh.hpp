@@ -5,6 +5,41 @@
 
 namespace minigl
 {
+    /// Cluster of neighbouring triangles of a mesh, with the
+    /// bounds used to cull it. Meshlets are contiguous ranges
+    /// of the mesh index buffer, so each one can be drawn with
+    /// a regular (indirect) draw command. Laid out like the
+    /// `Meshlet` struct of the culling shader (std430).
+    struct Meshlet
+    {
+        /// Bounding sphere, in model space
+        Vec3 center;
+        float radius;
+
+        /// Normal cone: all the triangles face away from any
+        /// camera position `p` for which
+        /// `dot(center - p, cone_axis) >= cone_cutoff *
+        /// length(center - p) + radius`. A cutoff of 1 means
+        /// the meshlet is never backface culled.
+        Vec3 cone_axis;
+        float cone_cutoff;
+
+        uint32_t first_index;
+        uint32_t index_count;
+        uint32_t vertex_count;
+        uint32_t padding;
+    };
+
+    /// Level of detail of a mesh: a range of its index buffer,
+    /// and the geometric error of the simplification, in model
+    /// space units
+    struct LOD
+    {
+        uint32_t first_index;
+        uint32_t index_count;
+        float error;
+    };
+
     struct Material
     {
         Color albedo;
@@ -13,6 +48,16 @@ namespace minigl
         float anisotropy;
     };
 
+    /// Parser used to read OBJ files
+    enum class ObjParser
+    {
+        /// tinyobjloader, single-threaded.
+        TinyObj,
+        /// Native parser that splits the file in chunks
+        /// parsed in parallel on all cores.
+        Parallel,
+    };
+
     /// A mesh is a collection of vertices and indices put
     /// together in a vertex array.
     struct Mesh
@@ -20,6 +65,22 @@ namespace minigl
         Ref<VertexArray> vertexArray;
         std::vector<Vertex> vertices;
         std::vector<uint32_t> indices;
+        std::vector<Material> materials;
+        AABB bounds;
+        Sphere sphere;
+
+        /// Clusters of triangles, if the mesh was split (see
+        /// `load_clustered_mesh()`)
+        std::vector<Meshlet> meshlets;
+
+        /// Transform from the stored positions to model space:
+        /// identity, unless the positions are quantized (see
+        /// `compress_mesh()`)
+        Mat4 dequantization {1.f};
+
+        /// Levels of detail, the full detail one first, if they
+        /// were generated (see `load_lod_mesh()`)
+        std::vector<LOD> lods;
 
         Mesh() = default;
 
@@ -32,10 +93,30 @@ namespace minigl
             DataAccess usage = DataAccess::Static);
 
         /// Load a mesh from an OBJ file at the given path. A
-        /// vertex array is created, but not bound.
-        Mesh(const std::string& path, DataAccess usage = DataAccess::Static);
+        /// vertex array is created, but not bound. If a valid
+        /// binary cache of the file exists (see `MeshCache`),
+        /// the mesh is read from it; otherwise, the file is
+        /// parsed and the cache is written for the next runs.
+        /// `vertices` and `indices` are only filled if
+        /// `keep_cpu_data` is set (e.g. to build meshlets or
+        /// LODs from them afterwards); otherwise a cached mesh
+        /// is uploaded straight from the mapped file.
+        Mesh(const std::string& path, DataAccess usage = DataAccess::Static, ObjParser parser = ObjParser::Parallel, bool keep_cpu_data = false);
     };
 
-    void load_mesh(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
-    void load_mesh(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Material>& materials);
+    /// Compute the bounding box of a set of vertices.
+    AABB compute_bounds(const std::vector<Vertex>& vertices);
+
+    /// Compute a bounding sphere of a set of vertices,
+    /// centered on their bounding box.
+    Sphere compute_sphere(const std::vector<Vertex>& vertices, const AABB& bounds);
+
+    /// Load the vertices and indices of the OBJ file at the
+    /// given path, from its binary cache if it is valid. The
+    /// cache is written otherwise. In both cases the contents
+    /// of the output vectors are replaced. The shapes of the file are
+    /// converted to vertices and indices in parallel; vertices
+    /// are welded across the whole file.
+    void load_mesh(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, ObjParser parser = ObjParser::Parallel);
+    void load_mesh(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Material>& materials, ObjParser parser = ObjParser::Parallel);
 }
\ No newline at end of file
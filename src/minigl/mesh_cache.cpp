@@ -0,0 +1,331 @@
+#include "mesh_cache.hpp"
+
+#include <cstring>
+#include <atomic>
+#include <random>
+
+namespace minigl
+{
+    namespace fs = std::filesystem;
+
+    /// Round `offset` up to the next multiple of 16.
+    static uint64_t align16(uint64_t offset)
+    {
+        return (offset + 15) & ~uint64_t(15);
+    }
+
+    /// Size and last write time of the file at `path`, or
+    /// false if the file does not exist.
+    static bool file_stats(const std::string& path, uint64_t& size, int64_t& mtime)
+    {
+        std::error_code ec;
+        size = fs::file_size(path, ec);
+        if (ec)
+            return false;
+
+        mtime = fs::last_write_time(path, ec).time_since_epoch().count();
+        return !ec;
+    }
+
+    /// Hash of the contents of the file at `path`.
+    static uint64_t file_hash(const std::string& path)
+    {
+        MappedFile source {path};
+        return source.valid() ? hash_bytes(source.data(), source.size()) : 0;
+    }
+
+    /// Current state of the file at `path`.
+    static MeshCacheStamp stamp_file(const std::string& path)
+    {
+        MeshCacheStamp stamp {};
+        if (!file_stats(path, stamp.size, stamp.mtime))
+            return MeshCacheStamp {MeshCacheStamp::missing, 0, 0};
+
+        stamp.hash = file_hash(path);
+        return stamp;
+    }
+
+    enum class Freshness
+    {
+        /// Same size and modification time
+        Fresh,
+        /// Same size and contents, but a different
+        /// modification time (`mtime`)
+        Touched,
+        Stale,
+    };
+
+    /// Compare the file at `path` with the state it had when
+    /// the cache was written.
+    static Freshness check_file(const std::string& path, const MeshCacheStamp& stamp, int64_t& mtime)
+    {
+        uint64_t size;
+        if (!file_stats(path, size, mtime))
+            return stamp.size == MeshCacheStamp::missing ? Freshness::Fresh : Freshness::Stale;
+
+        // The modification time is the fast path; if only it
+        // changed (the file was touched or copied), fall back
+        // to comparing the contents hash.
+        if (stamp.size != size)
+            return Freshness::Stale;
+        if (stamp.mtime == mtime)
+            return Freshness::Fresh;
+
+        return stamp.hash == file_hash(path) ? Freshness::Touched : Freshness::Stale;
+    }
+
+    /// Material libraries referenced by the OBJ file at
+    /// `path` (`mtllib` lines), relative to its directory.
+    /// Like tinyobj, a line can list several files, separated
+    /// by whitespace.
+    static std::vector<std::string> material_libraries(const std::string& path)
+    {
+        std::vector<std::string> libraries {};
+
+        MappedFile file {path};
+        if (!file.valid())
+            return libraries;
+
+        auto p = (const char*)file.data();
+        auto end = p + file.size();
+        auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+
+        while (p < end) {
+            auto eol = std::find(p, end, '\n');
+            while (p < eol && is_space(*p))
+                p++;
+
+            if (eol - p > 6 && std::memcmp(p, "mtllib", 6) == 0 && is_space(p[6])) {
+                for (p += 6; p < eol; ) {
+                    while (p < eol && is_space(*p))
+                        p++;
+
+                    auto name = p;
+                    while (p < eol && !is_space(*p))
+                        p++;
+
+                    std::string library(name, p);
+                    if (!library.empty() && std::find(libraries.begin(), libraries.end(), library) == libraries.end())
+                        libraries.push_back(library);
+                }
+            }
+
+            p = eol + 1;
+        }
+
+        return libraries;
+    }
+
+    std::string MeshCache::cache_path(const std::string& source)
+    {
+        return fs::path(source).replace_extension(".mglmesh").string();
+    }
+
+    MeshCache::MeshCache(const std::string& source)
+    {
+        std::string path = cache_path(source);
+        file = box<MappedFile>(path);
+        if (!file->valid() || file->size() < sizeof(MeshCacheHeader))
+            return;
+
+        auto h = (const MeshCacheHeader*)file->data();
+        if (std::memcmp(h->magic, "MGLM", 4) != 0
+            || h->version != version
+            || h->vertex_size != sizeof(Vertex))
+            return;
+
+        // Make sure the blobs actually fit in the file, in
+        // case it was truncated. Empty blobs are not written,
+        // so their offset may be past the end.
+        auto fits = [&](uint64_t offset, uint64_t size) { return size == 0 || offset + size <= file->size(); };
+        if (!fits(h->vertex_offset, (uint64_t)h->vertex_count * sizeof(Vertex))
+            || !fits(h->index_offset, (uint64_t)h->index_count * sizeof(uint32_t))
+            || !fits(h->material_offset, (uint64_t)h->material_count * sizeof(Material))
+            || !fits(h->dependency_offset, (uint64_t)h->dependency_count * sizeof(MeshCacheDependency)))
+            return;
+
+        // Offsets in the cache of the modification times to
+        // update, for the files that were only touched.
+        std::vector<std::pair<uint64_t, int64_t>> touched {};
+
+        int64_t mtime;
+        switch (check_file(source, h->source, mtime))
+        {
+            case Freshness::Stale:
+                return;
+            case Freshness::Touched:
+                touched.push_back({offsetof(MeshCacheHeader, source) + offsetof(MeshCacheStamp, mtime), mtime});
+                break;
+            case Freshness::Fresh:
+                break;
+        }
+
+        auto directory = fs::path(source).parent_path();
+        auto dependencies = (const MeshCacheDependency*)(file->data() + h->dependency_offset);
+        for (uint32_t i = 0; i < h->dependency_count; i++) {
+            auto& dependency = dependencies[i];
+            std::string name(dependency.path, strnlen(dependency.path, sizeof(dependency.path)));
+
+            switch (check_file((directory / name).string(), dependency.stamp, mtime))
+            {
+                case Freshness::Stale:
+                    return;
+                case Freshness::Touched:
+                    touched.push_back({h->dependency_offset + i * sizeof(MeshCacheDependency)
+                                       + offsetof(MeshCacheDependency, stamp) + offsetof(MeshCacheStamp, mtime), mtime});
+                    break;
+                case Freshness::Fresh:
+                    break;
+            }
+        }
+
+        if (!touched.empty()) {
+            // The file is unmapped while it is patched, since
+            // Windows does not allow writing to a mapped file.
+            size_t size = file->size();
+            file.reset();
+            {
+                std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+                for (auto& [offset, value]: touched) {
+                    out.seekp(offset);
+                    out.write((const char*)&value, sizeof(value));
+                }
+
+                if (!out)
+                    warn("Could not update mesh cache '{}'", path);
+            }
+
+            file = box<MappedFile>(path);
+            if (!file->valid() || file->size() != size)
+                return;
+            h = (const MeshCacheHeader*)file->data();
+        }
+
+        header = h;
+    }
+
+    const Vertex* MeshCache::vertices() const
+    {
+        return (const Vertex*)(file->data() + header->vertex_offset);
+    }
+
+    const uint32_t* MeshCache::indices() const
+    {
+        return (const uint32_t*)(file->data() + header->index_offset);
+    }
+
+    const Material* MeshCache::materials() const
+    {
+        return (const Material*)(file->data() + header->material_offset);
+    }
+
+    AABB MeshCache::bounds() const
+    {
+        return AABB {
+            .min = {header->bounds_min[0], header->bounds_min[1], header->bounds_min[2]},
+            .max = {header->bounds_max[0], header->bounds_max[1], header->bounds_max[2]}
+        };
+    }
+
+    Sphere MeshCache::sphere() const
+    {
+        return Sphere {
+            .center = {header->sphere[0], header->sphere[1], header->sphere[2]},
+            .radius = header->sphere[3]
+        };
+    }
+
+    void MeshCache::write(const std::string& source,
+                          const std::vector<Vertex>& vertices,
+                          const std::vector<uint32_t>& indices,
+                          const std::vector<Material>& materials,
+                          const AABB& bounds,
+                          const Sphere& sphere)
+    {
+        MeshCacheHeader h {};
+        std::memcpy(h.magic, "MGLM", 4);
+        h.version = version;
+
+        h.source = stamp_file(source);
+        if (h.source.size == MeshCacheStamp::missing)
+            return;
+
+        // Missing libraries are recorded too: the cache is
+        // stale once they appear.
+        auto directory = fs::path(source).parent_path();
+        std::vector<MeshCacheDependency> dependencies {};
+        for (auto& library: material_libraries(source)) {
+            MeshCacheDependency dependency {};
+            if (library.size() >= sizeof(dependency.path)) {
+                warn("Could not write mesh cache of '{}': material library path too long", source);
+                return;
+            }
+
+            std::memcpy(dependency.path, library.data(), library.size());
+            dependency.stamp = stamp_file((directory / library).string());
+            dependencies.push_back(dependency);
+        }
+
+        h.vertex_size = sizeof(Vertex);
+        h.vertex_count = vertices.size();
+        h.index_count = indices.size();
+        h.material_count = materials.size();
+        h.dependency_count = dependencies.size();
+
+        h.vertex_offset = align16(sizeof(MeshCacheHeader));
+        h.index_offset = align16(h.vertex_offset + vertices.size() * sizeof(Vertex));
+        h.material_offset = align16(h.index_offset + indices.size() * sizeof(uint32_t));
+        h.dependency_offset = align16(h.material_offset + materials.size() * sizeof(Material));
+
+        for (int i = 0; i < 3; i++) {
+            h.bounds_min[i] = bounds.min[i];
+            h.bounds_max[i] = bounds.max[i];
+            h.sphere[i] = sphere.center[i];
+        }
+        h.sphere[3] = sphere.radius;
+
+        // Write to a temporary file first and rename it when
+        // done, so that a reader never maps a half-written
+        // cache. The name is unique to this writer: the same
+        // mesh may be loaded by several threads or processes
+        // at once, and the last rename wins.
+        static std::atomic<uint32_t> writer_count = 0;
+        std::string path = cache_path(source);
+        std::string tmp_path = fmt::format("{}.{:08x}{:04x}.tmp", path, std::random_device{}(), writer_count++ & 0xffff);
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                warn("Could not write mesh cache '{}'", path);
+                return;
+            }
+
+            auto write_at = [&out](uint64_t offset, const void* data, size_t size) {
+                out.seekp(offset);
+                out.write((const char*)data, size);
+            };
+
+            write_at(0, &h, sizeof(h));
+            write_at(h.vertex_offset, vertices.data(), vertices.size() * sizeof(Vertex));
+            write_at(h.index_offset, indices.data(), indices.size() * sizeof(uint32_t));
+            write_at(h.material_offset, materials.data(), materials.size() * sizeof(Material));
+            write_at(h.dependency_offset, dependencies.data(), dependencies.size() * sizeof(MeshCacheDependency));
+
+            if (!out) {
+                warn("Could not write mesh cache '{}'", path);
+                out.close();
+                fs::remove(tmp_path);
+                return;
+            }
+        }
+
+        std::error_code ec;
+        fs::rename(tmp_path, path, ec);
+        if (ec) {
+            warn("Could not write mesh cache '{}': {}", path, ec.message());
+            fs::remove(tmp_path, ec);
+            return;
+        }
+
+        trace("Wrote mesh cache '{}'", path);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "core.hpp"
+#include "mesh.hpp"
+#include "mapped_file.hpp"
+
+namespace minigl
+{
+    /// State of a file the cache was built from, to detect
+    /// changes to it.
+    struct MeshCacheStamp
+    {
+        /// Size of the file in bytes, or `missing` if the file
+        /// did not exist
+        uint64_t size;
+        /// Last write time of the file
+        int64_t mtime;
+        /// Hash of the contents of the file
+        uint64_t hash;
+
+        static constexpr uint64_t missing = ~uint64_t(0);
+    };
+
+    /// File other than the OBJ file that the mesh was built
+    /// from: a material library referenced with `mtllib`.
+    struct MeshCacheDependency
+    {
+        /// Path relative to the directory of the OBJ file,
+        /// null terminated
+        char path[256];
+        MeshCacheStamp stamp;
+    };
+
+    /// Header of a binary mesh cache file. The file is laid
+    /// out as the header followed by the vertex, index,
+    /// material and dependency blobs, each one starting at the
+    /// offset stored in the header (aligned to 16 bytes), so
+    /// that the blobs can be used in place once the file is
+    /// mapped.
+    struct MeshCacheHeader
+    {
+        /// Magic number, always "MGLM"
+        char magic[4];
+        /// Format version. Caches with a different version
+        /// are considered stale.
+        uint32_t version;
+
+        /// State of the OBJ file
+        MeshCacheStamp source;
+
+        /// Size of a vertex in bytes, to reject caches written
+        /// with a different `Vertex` layout
+        uint32_t vertex_size;
+        uint32_t vertex_count;
+        uint32_t index_count;
+        uint32_t material_count;
+        uint32_t dependency_count;
+
+        uint64_t vertex_offset;
+        uint64_t index_offset;
+        uint64_t material_offset;
+        uint64_t dependency_offset;
+
+        /// Bounds of the mesh vertices
+        float bounds_min[3];
+        float bounds_max[3];
+        /// Bounding sphere (center and radius)
+        float sphere[4];
+    };
+
+    /// Binary cache of a mesh loaded from an OBJ file. The
+    /// cache lives alongside the source file, with the
+    /// `.mglmesh` extension, and is memory-mapped when opened:
+    /// its contents can be uploaded to the GPU straight from
+    /// the mapping (see `Mesh(path)` and `MeshLoader`).
+    class MeshCache
+    {
+        public:
+
+            static constexpr uint32_t version = 5;
+
+            /// Open the cache of the mesh at `source`. The
+            /// cache is invalid if it does not exist, has a
+            /// different version, or is stale relative to the
+            /// source file or one of its material libraries
+            /// (different size, or different modification time
+            /// and content hash). When only modification times
+            /// changed, they are updated in the cache, so that
+            /// the next loads skip hashing the files.
+            explicit MeshCache(const std::string& source);
+
+            bool valid() const { return header != nullptr; }
+
+            const Vertex* vertices() const;
+            const uint32_t* indices() const;
+            const Material* materials() const;
+
+            uint32_t vertex_count() const { return header->vertex_count; }
+            uint32_t index_count() const { return header->index_count; }
+            uint32_t material_count() const { return header->material_count; }
+
+            AABB bounds() const;
+            Sphere sphere() const;
+
+            /// Write the cache of the mesh at `source`. Errors
+            /// (e.g. a read-only directory) are reported as
+            /// warnings, since the cache is only an
+            /// optimization.
+            static void write(const std::string& source,
+                              const std::vector<Vertex>& vertices,
+                              const std::vector<uint32_t>& indices,
+                              const std::vector<Material>& materials,
+                              const AABB& bounds,
+                              const Sphere& sphere);
+
+            /// Path of the cache of the mesh at `source`.
+            static std::string cache_path(const std::string& source);
+
+        private:
+
+            Box<MappedFile> file;
+            const MeshCacheHeader* header = nullptr;
+    };
+}
\ No newline at end of file
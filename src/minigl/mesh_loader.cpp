@@ -0,0 +1,154 @@
+#include "mesh_loader.hpp"
+#include "thread_pool.hpp"
+
+namespace minigl
+{
+    MeshLoader::~MeshLoader()
+    {
+        for (auto& job: jobs) {
+            if (job->parsed.valid())
+                job->parsed.wait();
+        }
+    }
+
+    Ref<MeshHandle> MeshLoader::load(const std::string& path, DataAccess usage, ObjParser parser, bool keep_cpu_data)
+    {
+        auto job = box<Job>();
+        job->handle = ref<MeshHandle>();
+        job->handle->source = path;
+        job->usage = usage;
+        job->keep_cpu_data = keep_cpu_data;
+        job->mesh = ref<Mesh>();
+
+        // The job is heap-allocated, so the worker can keep a
+        // pointer to it while the queue changes.
+        job->parsed = ThreadPool::global().submit([job = job.get(), path, parser]() {
+            auto& mesh = *job->mesh;
+
+            // Keep the cache mapped until the upload is done,
+            // so that it can be sent from the mapping.
+            auto cache = box<MeshCache>(path);
+            if (cache->valid()) {
+                job->vertex_data = cache->vertices();
+                job->vertex_count = cache->vertex_count();
+                job->index_data = cache->indices();
+                job->index_count = cache->index_count();
+
+                if (job->keep_cpu_data) {
+                    mesh.vertices.assign(cache->vertices(), cache->vertices() + cache->vertex_count());
+                    mesh.indices.assign(cache->indices(), cache->indices() + cache->index_count());
+                }
+                mesh.materials.assign(cache->materials(), cache->materials() + cache->material_count());
+                mesh.bounds = cache->bounds();
+                mesh.sphere = cache->sphere();
+                job->cache = std::move(cache);
+                return;
+            }
+
+            // The stale cache is unmapped before parsing, which
+            // writes the cache for the next runs.
+            cache.reset();
+            load_mesh(path, mesh.vertices, mesh.indices, mesh.materials, parser);
+            mesh.bounds = compute_bounds(mesh.vertices);
+            mesh.sphere = compute_sphere(mesh.vertices, mesh.bounds);
+
+            job->vertex_data = mesh.vertices.data();
+            job->vertex_count = mesh.vertices.size();
+            job->index_data = mesh.indices.data();
+            job->index_count = mesh.indices.size();
+        });
+
+        auto handle = job->handle;
+        jobs.push_back(std::move(job));
+
+        return handle;
+    }
+
+    size_t MeshLoader::upload_job(Job& job, size_t budget)
+    {
+        size_t vertex_bytes = job.vertex_count * sizeof(Vertex);
+        size_t index_bytes = job.index_count * sizeof(uint32_t);
+
+        // Allocate the whole storage up front, then fill it
+        // piece by piece over the next frames. Empty buffers
+        // are not allocated: GL rejects storage of size 0.
+        if (!job.allocated) {
+            auto usage = DataAccess(job.usage | DataAccess::Dynamic);
+            if (job.vertex_count > 0)
+                job.vb = ref<VertexBuffer>((const Vertex*)nullptr, job.vertex_count, usage);
+            if (job.index_count > 0)
+                job.ib = ref<IndexBuffer>((const uint32_t*)nullptr, job.index_count, usage);
+            job.allocated = true;
+        }
+
+        size_t sent = 0;
+        if (job.uploaded < vertex_bytes) {
+            size_t size = std::min(budget, vertex_bytes - job.uploaded);
+            job.vb->upload((const uint8_t*)job.vertex_data + job.uploaded, size, job.uploaded);
+            job.uploaded += size;
+            sent += size;
+        }
+
+        if (job.uploaded >= vertex_bytes && job.uploaded < vertex_bytes + index_bytes && sent < budget) {
+            size_t offset = job.uploaded - vertex_bytes;
+            size_t size = std::min(budget - sent, index_bytes - offset);
+            job.ib->upload((const uint8_t*)job.index_data + offset, size, offset);
+            job.uploaded += size;
+            sent += size;
+        }
+
+        return sent;
+    }
+
+    void MeshLoader::upload(size_t budget)
+    {
+        for (auto it = jobs.begin(); it != jobs.end() && budget > 0; ) {
+            auto& job = **it;
+
+            // Meshes still being parsed are skipped, so that
+            // a large file does not hold back the others.
+            if (job.parsed.valid()) {
+                if (job.parsed.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    it++;
+                    continue;
+                }
+
+                // Rethrow the exception of the worker, if any,
+                // on this thread, without the failed job.
+                try {
+                    job.parsed.get();
+                }
+                catch (...) {
+                    jobs.erase(it);
+                    throw;
+                }
+            }
+
+            budget -= upload_job(job, budget);
+
+            size_t total = job.vertex_count * sizeof(Vertex) + job.index_count * sizeof(uint32_t);
+            if (job.uploaded < total) {
+                it++;
+                continue;
+            }
+
+            auto vertexArray = ref<VertexArray>();
+            if (job.vb)
+                vertexArray->add_vertex_buffer(job.vb);
+            if (job.ib)
+                vertexArray->set_index_buffer(job.ib);
+            else
+                warn("Mesh '{}' is empty", job.handle->source);
+
+            job.mesh->vertexArray = vertexArray;
+            if (!job.keep_cpu_data) {
+                job.mesh->vertices = {};
+                job.mesh->indices = {};
+            }
+            job.handle->mesh = job.mesh;
+            trace("Uploaded mesh '{}'", job.handle->source);
+
+            it = jobs.erase(it);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "core.hpp"
+#include "mesh.hpp"
+#include "mesh_cache.hpp"
+
+#include <future>
+#include <deque>
+
+namespace minigl
+{
+    /// Handle to a mesh loaded asynchronously by a
+    /// `MeshLoader`. The mesh is available once it has been
+    /// parsed and completely uploaded to the GPU.
+    class MeshHandle
+    {
+        public:
+
+            bool ready() const { return mesh != nullptr; }
+
+            /// The loaded mesh, or null if it is not ready
+            /// yet.
+            const Ref<Mesh>& get() const { return mesh; }
+
+            const std::string& path() const { return source; }
+
+        private:
+
+            friend class MeshLoader;
+
+            Ref<Mesh> mesh;
+            std::string source;
+    };
+
+    /// Asynchronous mesh loader. Files are parsed on the
+    /// global thread pool, and the finished CPU data is
+    /// uploaded on the GL thread by `upload()`, a bounded
+    /// number of bytes at a time, so that loading large meshes
+    /// is spread over several frames instead of stalling one.
+    class MeshLoader
+    {
+        public:
+
+            MeshLoader() = default;
+
+            /// Destructor: waits for the meshes being parsed,
+            /// since the workers write into the loader's jobs.
+            ~MeshLoader();
+
+            /// Queue the OBJ file at `path` for loading, and
+            /// return a handle to the future mesh. Like
+            /// `Mesh(path)`, the mesh only keeps its vertices
+            /// and indices on the CPU if `keep_cpu_data` is set.
+            Ref<MeshHandle> load(const std::string& path,
+                                 DataAccess usage = DataAccess::Static,
+                                 ObjParser parser = ObjParser::Parallel,
+                                 bool keep_cpu_data = false);
+
+            /// Upload the meshes that finished parsing, in
+            /// the order they were queued, sending at most
+            /// `budget` bytes to the GPU. Must be called on the
+            /// GL thread (`App::run()` calls it once per frame).
+            /// An exception thrown while parsing a mesh is
+            /// rethrown here, and its mesh is dropped.
+            void upload(size_t budget);
+
+            /// Number of meshes not ready yet.
+            size_t pending() const { return jobs.size(); }
+
+        private:
+
+            struct Job
+            {
+                Ref<MeshHandle> handle;
+                DataAccess usage;
+                bool keep_cpu_data;
+                std::future<void> parsed;
+
+                // CPU data, filled by the worker thread. The
+                // blobs point into the cache mapping on a hit,
+                // to the vectors of the mesh otherwise.
+                Ref<Mesh> mesh;
+                Box<MeshCache> cache;
+                const Vertex* vertex_data = nullptr;
+                size_t vertex_count = 0;
+                const uint32_t* index_data = nullptr;
+                size_t index_count = 0;
+
+                // GPU upload state
+                bool allocated = false;
+                Ref<VertexBuffer> vb;
+                Ref<IndexBuffer> ib;
+                size_t uploaded = 0;
+            };
+
+            std::deque<Box<Job>> jobs;
+
+            /// Upload at most `budget` bytes of the job data,
+            /// and return the number of bytes sent.
+            static size_t upload_job(Job& job, size_t budget);
+    };
+}
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace minigl
+{
+    //----------- ANALYSIS -----------//
+
+    VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size)
+    {
+        VertexCacheStats stats {};
+        if (indices.empty() || vertex_count == 0)
+            return stats;
+
+        // A vertex is in the cache if it was pushed less than
+        // `cache_size` misses ago.
+        std::vector<uint32_t> timestamp(vertex_count, 0);
+        uint32_t time = cache_size + 1;
+        uint32_t misses = 0;
+
+        for (auto index: indices) {
+            if (time - timestamp[index] > cache_size) {
+                timestamp[index] = time++;
+                misses++;
+            }
+        }
+
+        stats.acmr = (float)misses / (indices.size() / 3);
+        stats.atvr = (float)misses / vertex_count;
+        return stats;
+    }
+
+    /// Reorder the triangles of `indices` in `order`.
+    static void reorder_triangles(std::vector<uint32_t>& indices, const std::vector<uint32_t>& order)
+    {
+        std::vector<uint32_t> reordered(indices.size());
+        for (size_t t = 0; t < order.size(); t++)
+            for (int k = 0; k < 3; k++)
+                reordered[3*t+k] = indices[3*order[t]+k];
+
+        indices = std::move(reordered);
+    }
+
+    //----------- VERTEX CACHE -----------//
+
+    namespace forsyth
+    {
+        /// Size of the LRU cache the scores are computed for,
+        /// larger than the hardware caches so that the order
+        /// does not depend on their exact size.
+        constexpr int CACHE_SIZE = 32;
+        constexpr int MAX_VALENCE = 32;
+
+        /// Score of a vertex, from its position in the cache
+        /// (recent vertices score higher, but the last triangle
+        /// scores a fixed amount to avoid strips) and from its
+        /// number of remaining triangles (vertices with few
+        /// triangles left score higher, to avoid leaving single
+        /// triangles behind).
+        struct ScoreTable
+        {
+            float cache[CACHE_SIZE + 1];
+            float valence[MAX_VALENCE + 1];
+
+            ScoreTable()
+            {
+                for (int i = 0; i < CACHE_SIZE; i++) {
+                    if (i < 3)
+                        cache[i] = 0.75f;
+                    else
+                        cache[i] = std::pow(1.f - (float)(i - 3) / (CACHE_SIZE - 3), 1.5f);
+                }
+                cache[CACHE_SIZE] = 0.f;
+
+                valence[0] = 0.f;
+                for (int i = 1; i <= MAX_VALENCE; i++)
+                    valence[i] = 2.f / std::sqrt((float)i);
+            }
+
+            float score(int cache_position, uint32_t remaining) const
+            {
+                if (remaining == 0)
+                    return -1.f;
+
+                int position = cache_position < 0 ? CACHE_SIZE : cache_position;
+                return cache[position] + valence[std::min<uint32_t>(remaining, MAX_VALENCE)];
+            }
+        };
+    }
+
+    std::vector<uint32_t> optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertex_count)
+    {
+        using namespace forsyth;
+        static const ScoreTable table {};
+
+        uint32_t triangle_count = indices.size() / 3;
+        std::vector<uint32_t> order {};
+        order.reserve(triangle_count);
+        if (triangle_count == 0)
+            return order;
+
+        // Remaining triangles of each vertex. The first
+        // `remaining[v]` entries of the adjacency list of `v`
+        // are its triangles that were not emitted yet.
+        std::vector<uint32_t> remaining(vertex_count, 0);
+        for (auto index: indices)
+            remaining[index]++;
+
+        std::vector<uint32_t> adjacency_offset(vertex_count + 1, 0);
+        for (size_t v = 0; v < vertex_count; v++)
+            adjacency_offset[v+1] = adjacency_offset[v] + remaining[v];
+
+        std::vector<uint32_t> adjacency(indices.size());
+        {
+            auto fill = adjacency_offset;
+            for (uint32_t i = 0; i < indices.size(); i++)
+                adjacency[fill[indices[i]]++] = i / 3;
+        }
+
+        std::vector<int> cache_position(vertex_count, -1);
+        std::vector<float> vertex_score(vertex_count);
+        for (size_t v = 0; v < vertex_count; v++)
+            vertex_score[v] = table.score(-1, remaining[v]);
+
+        std::vector<float> triangle_score(triangle_count);
+        std::vector<bool> emitted(triangle_count, false);
+        for (uint32_t t = 0; t < triangle_count; t++)
+            triangle_score[t] = vertex_score[indices[3*t]] + vertex_score[indices[3*t+1]] + vertex_score[indices[3*t+2]];
+
+        // The cache holds 3 more entries while a triangle is
+        // being added.
+        std::vector<uint32_t> cache {}, next_cache {};
+        cache.reserve(CACHE_SIZE + 3);
+        next_cache.reserve(CACHE_SIZE + 3);
+
+        uint32_t best = 0;
+        float best_score = triangle_score[0];
+        for (uint32_t t = 1; t < triangle_count; t++) {
+            if (triangle_score[t] > best_score) {
+                best = t;
+                best_score = triangle_score[t];
+            }
+        }
+
+        uint32_t next_unemitted = 0;
+
+        while (true)
+        {
+            emitted[best] = true;
+            order.push_back(best);
+
+            // Move the vertices of the triangle to the front of
+            // the cache, and remove the triangle from their
+            // adjacency lists.
+            next_cache.clear();
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t v = indices[3*best+k];
+                next_cache.push_back(v);
+
+                uint32_t* first = &adjacency[adjacency_offset[v]];
+                uint32_t* last = first + remaining[v];
+                std::swap(*std::find(first, last, best), *(last - 1));
+                remaining[v]--;
+            }
+
+            for (auto v: cache)
+                if (v != next_cache[0] && v != next_cache[1] && v != next_cache[2])
+                    next_cache.push_back(v);
+
+            std::swap(cache, next_cache);
+
+            // Update the scores of the vertices in the cache,
+            // and those of the vertices pushed out of it.
+            for (size_t i = 0; i < cache.size(); i++)
+            {
+                uint32_t v = cache[i];
+                int position = i < CACHE_SIZE ? (int)i : -1;
+                cache_position[v] = position;
+
+                float score = table.score(position, remaining[v]);
+                float delta = score - vertex_score[v];
+                vertex_score[v] = score;
+
+                for (uint32_t a = 0; a < remaining[v]; a++)
+                    triangle_score[adjacency[adjacency_offset[v] + a]] += delta;
+            }
+
+            if (cache.size() > CACHE_SIZE)
+                cache.resize(CACHE_SIZE);
+
+            // The next triangle is the best one using a vertex
+            // of the cache, or the next one not emitted if no
+            // triangle uses the cache.
+            best_score = -std::numeric_limits<float>::infinity();
+            for (auto v: cache) {
+                for (uint32_t a = 0; a < remaining[v]; a++) {
+                    uint32_t t = adjacency[adjacency_offset[v] + a];
+                    if (triangle_score[t] > best_score) {
+                        best = t;
+                        best_score = triangle_score[t];
+                    }
+                }
+            }
+
+            if (best_score == -std::numeric_limits<float>::infinity())
+            {
+                while (next_unemitted < triangle_count && emitted[next_unemitted])
+                    next_unemitted++;
+                if (next_unemitted == triangle_count)
+                    break;
+
+                best = next_unemitted;
+            }
+        }
+
+        reorder_triangles(indices, order);
+        return order;
+    }
+
+    //----------- OVERDRAW -----------//
+
+    /// Split the triangles in clusters that can be reordered
+    /// without hurting the vertex cache much (Sander et al.):
+    /// each cluster starts with a cold cache, and ends as soon
+    /// as its own miss ratio is below `threshold` times the one
+    /// of the whole mesh.
+    static std::vector<uint32_t> split_clusters(const std::vector<uint32_t>& indices, size_t vertex_count, float threshold)
+    {
+        constexpr uint32_t cache_size = 16;
+        uint32_t triangle_count = indices.size() / 3;
+        float target = threshold * analyze_vertex_cache(indices, vertex_count, cache_size).acmr;
+
+        std::vector<uint32_t> timestamp(vertex_count, 0);
+        uint32_t time = cache_size + 1;
+
+        std::vector<uint32_t> clusters {0};
+        uint32_t misses = 0, start = 0;
+        for (uint32_t t = 0; t < triangle_count; t++)
+        {
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[3*t+k];
+                if (time - timestamp[v] > cache_size) {
+                    timestamp[v] = time++;
+                    misses++;
+                }
+            }
+
+            if (t + 1 < triangle_count && (float)misses / (t + 1 - start) <= target) {
+                clusters.push_back(t + 1);
+                start = t + 1;
+                misses = 0;
+
+                // Flush the cache
+                time += cache_size + 1;
+            }
+        }
+
+        return clusters;
+    }
+
+    std::vector<uint32_t> optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold)
+    {
+        uint32_t triangle_count = indices.size() / 3;
+        std::vector<uint32_t> order(triangle_count);
+        std::iota(order.begin(), order.end(), 0);
+        if (triangle_count == 0)
+            return order;
+
+        auto clusters = split_clusters(indices, vertices.size(), threshold);
+        clusters.push_back(triangle_count);
+
+        // Area weighted centroid of the mesh
+        Vec3 mesh_centroid {0.f};
+        float mesh_area = 0.f;
+        for (uint32_t t = 0; t < triangle_count; t++) {
+            auto& a = vertices[indices[3*t+0]].pos;
+            auto& b = vertices[indices[3*t+1]].pos;
+            auto& c = vertices[indices[3*t+2]].pos;
+            float area = glm::length(glm::cross(b - a, c - a));
+            mesh_centroid += (a + b + c) * area;
+            mesh_area += area;
+        }
+        if (mesh_area > 0.f)
+            mesh_centroid = mesh_centroid / (3.f * mesh_area);
+
+        // Clusters facing outwards, away from the centroid, are
+        // likely to occlude the others: draw them first.
+        size_t cluster_count = clusters.size() - 1;
+        std::vector<float> sort_key(cluster_count);
+        for (size_t c = 0; c < cluster_count; c++)
+        {
+            Vec3 centroid {0.f}, normal {0.f};
+            float area = 0.f;
+            for (uint32_t t = clusters[c]; t < clusters[c+1]; t++) {
+                auto& p0 = vertices[indices[3*t+0]].pos;
+                auto& p1 = vertices[indices[3*t+1]].pos;
+                auto& p2 = vertices[indices[3*t+2]].pos;
+                Vec3 n = glm::cross(p1 - p0, p2 - p0);
+                float triangle_area = glm::length(n);
+                centroid += (p0 + p1 + p2) * triangle_area;
+                normal += n;
+                area += triangle_area;
+            }
+
+            if (area > 0.f)
+                centroid = centroid / (3.f * area);
+
+            float length = glm::length(normal);
+            sort_key[c] = length > 0.f ? glm::dot(centroid - mesh_centroid, normal / length) : 0.f;
+        }
+
+        std::vector<uint32_t> cluster_order(cluster_count);
+        std::iota(cluster_order.begin(), cluster_order.end(), 0);
+        std::stable_sort(cluster_order.begin(), cluster_order.end(),
+                         [&](uint32_t a, uint32_t b) { return sort_key[a] > sort_key[b]; });
+
+        order.clear();
+        for (auto c: cluster_order)
+            for (uint32_t t = clusters[c]; t < clusters[c+1]; t++)
+                order.push_back(t);
+
+        reorder_triangles(indices, order);
+        return order;
+    }
+
+    //----------- VERTEX FETCH -----------//
+
+    void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        constexpr uint32_t unused = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> remap(vertices.size(), unused);
+
+        std::vector<Vertex> reordered {};
+        reordered.reserve(vertices.size());
+
+        for (auto& index: indices) {
+            if (remap[index] == unused) {
+                remap[index] = reordered.size();
+                reordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+
+        vertices = std::move(reordered);
+    }
+
+    //----------- MESH -----------//
+
+    MeshOptimizationStats optimize_mesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Material>& materials)
+    {
+        MeshOptimizationStats stats {};
+        stats.before = analyze_vertex_cache(indices, vertices.size());
+
+        auto order = optimize_vertex_cache(indices, vertices.size());
+        auto overdraw_order = optimize_overdraw(indices, vertices);
+
+        // Materials are only reordered if there is one per
+        // triangle.
+        if (materials.size() == order.size()) {
+            std::vector<Material> reordered(materials.size());
+            for (size_t t = 0; t < overdraw_order.size(); t++)
+                reordered[t] = materials[order[overdraw_order[t]]];
+
+            materials = std::move(reordered);
+        }
+
+        optimize_vertex_fetch(vertices, indices);
+        stats.after = analyze_vertex_cache(indices, vertices.size());
+
+        return stats;
+    }
+}
\ No newline at end of file
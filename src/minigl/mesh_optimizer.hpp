@@ -0,0 +1,57 @@
+#pragma once
+
+#include "core.hpp"
+#include "buffer.hpp"
+#include "mesh.hpp"
+
+namespace minigl
+{
+    /// Efficiency of a triangle order with a FIFO post-transform
+    /// vertex cache
+    struct VertexCacheStats
+    {
+        /// Average cache miss ratio: vertex shader invocations
+        /// per triangle (0.5 at best for a regular grid, 3 at
+        /// worst)
+        float acmr = 0.f;
+
+        /// Average transform to vertex ratio: vertex shader
+        /// invocations per vertex (1 at best)
+        float atvr = 0.f;
+    };
+
+    /// Simulate a FIFO vertex cache of `cache_size` entries on a
+    /// list of triangles.
+    VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size = 16);
+
+    /// Reorder the triangles for post-transform vertex cache
+    /// locality, with Tom Forsyth's linear-speed algorithm.
+    /// Returns the new triangle order: the original index of
+    /// each triangle.
+    std::vector<uint32_t> optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertex_count);
+
+    /// Reorder clusters of triangles to reduce overdraw, front
+    /// facing clusters first, at the cost of a cache miss ratio
+    /// at most `threshold` times higher. The indices should be
+    /// optimized for the vertex cache first. Returns the new
+    /// triangle order, as `optimize_vertex_cache()`.
+    std::vector<uint32_t> optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+    /// Reorder the vertices in the order in which they are first
+    /// used by the triangles, for vertex fetch locality, and
+    /// remap the indices. Vertices that are not referenced are
+    /// removed.
+    void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+    /// Cache statistics of a mesh before and after optimization
+    struct MeshOptimizationStats
+    {
+        VertexCacheStats before;
+        VertexCacheStats after;
+    };
+
+    /// Run all the optimizations on a mesh: vertex cache, then
+    /// overdraw, then vertex fetch. Per triangle materials are
+    /// reordered along with the triangles.
+    MeshOptimizationStats optimize_mesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Material>& materials);
+}
\ No newline at end of file
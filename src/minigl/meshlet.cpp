@@ -0,0 +1,341 @@
+#include "meshlet.hpp"
+
+namespace minigl
+{
+    static_assert(sizeof(Meshlet) == 48, "Meshlet must match the std430 layout of the culling shader");
+
+    /// Compute the bounding sphere and normal cone of a
+    /// meshlet from its triangles.
+    static void compute_meshlet_bounds(Meshlet& meshlet, const std::vector<Vertex>& vertices, const uint32_t* indices)
+    {
+        uint32_t triangle_count = meshlet.index_count / 3;
+
+        AABB box {};
+        for (uint32_t i = 0; i < meshlet.index_count; i++)
+            box.expand(vertices[indices[i]].pos);
+
+        meshlet.center = box.center();
+        float radius2 = 0.f;
+        for (uint32_t i = 0; i < meshlet.index_count; i++) {
+            Vec3 d = vertices[indices[i]].pos - meshlet.center;
+            radius2 = std::max(radius2, glm::dot(d, d));
+        }
+        meshlet.radius = std::sqrt(radius2);
+
+        // Cone axis: average of the triangle normals. The cutoff
+        // is derived from the normal furthest from the axis.
+        std::vector<Vec3> normals {};
+        normals.reserve(triangle_count);
+
+        Vec3 axis {0.f};
+        for (uint32_t t = 0; t < triangle_count; t++) {
+            auto& a = vertices[indices[3*t+0]].pos;
+            auto& b = vertices[indices[3*t+1]].pos;
+            auto& c = vertices[indices[3*t+2]].pos;
+
+            Vec3 normal = glm::cross(b - a, c - a);
+            float area = glm::length(normal);
+            if (area == 0.f)
+                continue;
+
+            normal = normal / area;
+            normals.push_back(normal);
+            axis += normal;
+        }
+
+        meshlet.cone_axis = Vec3{0.f, 0.f, 1.f};
+        meshlet.cone_cutoff = 1.f;
+
+        float axis_length = glm::length(axis);
+        if (normals.empty() || axis_length == 0.f)
+            return;
+
+        axis = axis / axis_length;
+
+        float min_dot = 1.f;
+        for (auto& normal: normals)
+            min_dot = std::min(min_dot, glm::dot(normal, axis));
+
+        // Cones wider than about 85 degrees are never worth
+        // testing.
+        meshlet.cone_axis = axis;
+        if (min_dot > 0.1f)
+            meshlet.cone_cutoff = std::sqrt(1.f - min_dot * min_dot);
+    }
+
+    std::vector<Meshlet> build_meshlets(const std::vector<Vertex>& vertices,
+                                        std::vector<uint32_t>& indices,
+                                        uint32_t max_vertices,
+                                        uint32_t max_triangles)
+    {
+        MGL_ASSERT(max_vertices >= 3 && max_triangles >= 1, "Invalid meshlet limits");
+
+        uint32_t triangle_count = indices.size() / 3;
+        std::vector<Meshlet> meshlets {};
+        if (triangle_count == 0)
+            return meshlets;
+
+        // Triangles of each vertex (compressed adjacency list)
+        std::vector<uint32_t> adjacency_offset(vertices.size() + 1, 0);
+        for (uint32_t i = 0; i < 3 * triangle_count; i++)
+            adjacency_offset[indices[i] + 1]++;
+        for (size_t v = 0; v < vertices.size(); v++)
+            adjacency_offset[v+1] += adjacency_offset[v];
+
+        std::vector<uint32_t> adjacency(3 * triangle_count);
+        {
+            auto fill = adjacency_offset;
+            for (uint32_t i = 0; i < 3 * triangle_count; i++)
+                adjacency[fill[indices[i]]++] = i / 3;
+        }
+
+        std::vector<bool> emitted(triangle_count, false);
+
+        // Meshlet of each vertex, to count the new vertices of
+        // a triangle without clearing a set between meshlets
+        std::vector<uint32_t> vertex_meshlet(vertices.size(), std::numeric_limits<uint32_t>::max());
+
+        std::vector<uint32_t> ordered {};
+        ordered.reserve(indices.size());
+
+        std::vector<uint32_t> candidates {};
+        uint32_t next_seed = 0;
+
+        while (true)
+        {
+            while (next_seed < triangle_count && emitted[next_seed])
+                next_seed++;
+            if (next_seed == triangle_count)
+                break;
+
+            uint32_t id = meshlets.size();
+            Meshlet meshlet {};
+            meshlet.first_index = ordered.size();
+
+            candidates.clear();
+            candidates.push_back(next_seed);
+
+            uint32_t meshlet_triangles = 0;
+            while (meshlet_triangles < max_triangles && !candidates.empty())
+            {
+                // Pick the candidate adding the fewest new
+                // vertices, which keeps the meshlet compact.
+                size_t best = candidates.size();
+                uint32_t best_new = 4;
+                for (size_t c = 0; c < candidates.size(); c++)
+                {
+                    uint32_t t = candidates[c];
+                    if (emitted[t])
+                        continue;
+
+                    uint32_t new_vertices = 0;
+                    for (int k = 0; k < 3; k++)
+                        new_vertices += vertex_meshlet[indices[3*t+k]] != id;
+
+                    if (new_vertices < best_new) {
+                        best = c;
+                        best_new = new_vertices;
+                    }
+                }
+
+                if (best == candidates.size() || meshlet.vertex_count + best_new > max_vertices)
+                    break;
+
+                uint32_t t = candidates[best];
+                candidates[best] = candidates.back();
+                candidates.pop_back();
+
+                emitted[t] = true;
+                meshlet_triangles++;
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t v = indices[3*t+k];
+                    ordered.push_back(v);
+                    if (vertex_meshlet[v] == id)
+                        continue;
+
+                    vertex_meshlet[v] = id;
+                    meshlet.vertex_count++;
+
+                    // The other triangles of the new vertex
+                    // become candidates.
+                    for (uint32_t a = adjacency_offset[v]; a < adjacency_offset[v+1]; a++)
+                        if (!emitted[adjacency[a]])
+                            candidates.push_back(adjacency[a]);
+                }
+
+                // Drop the candidates emitted in the meantime
+                // once in a while, to bound the scans
+                if (candidates.size() > 4 * max_triangles) {
+                    candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                                    [&](uint32_t c) { return emitted[c]; }),
+                                     candidates.end());
+                    std::sort(candidates.begin(), candidates.end());
+                    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+                }
+            }
+
+            meshlet.index_count = ordered.size() - meshlet.first_index;
+            compute_meshlet_bounds(meshlet, vertices, ordered.data() + meshlet.first_index);
+            meshlets.push_back(meshlet);
+        }
+
+        indices = std::move(ordered);
+        return meshlets;
+    }
+
+    Ref<Mesh> load_clustered_mesh(const std::string& path, DataAccess usage)
+    {
+        std::vector<Vertex> vertices {};
+        std::vector<uint32_t> indices {};
+        load_mesh(path, vertices, indices);
+
+        auto meshlets = build_meshlets(vertices, indices);
+        trace("Split mesh '{}' into {} meshlets", path, meshlets.size());
+
+        auto mesh = ref<Mesh>(vertices, indices, usage);
+        mesh->meshlets = std::move(meshlets);
+
+        return mesh;
+    }
+
+    /// Meshlet culling shader: one invocation per meshlet,
+    /// which appends the draw command of the meshlet if its
+    /// bounding sphere intersects the frustum and its normal
+    /// cone does not face away from the camera.
+    static const char* cluster_cull_source = R"glsl(
+#ifdef COMPUTE
+layout(local_size_x = 64) in;
+
+struct Meshlet
+{
+    vec3 center;
+    float radius;
+    vec3 coneAxis;
+    float coneCutoff;
+    uint firstIndex;
+    uint indexCount;
+    uint vertexCount;
+    uint padding;
+};
+
+struct DrawCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 11) readonly buffer Meshlets { Meshlet meshlets[]; };
+layout(std430, binding = 12) writeonly buffer Commands { DrawCommand commands[]; };
+layout(std430, binding = 13) buffer Count { uint drawCount; };
+
+uniform vec4 u_planes[6];
+uniform mat4 u_model;
+uniform float u_scale;
+uniform vec3 u_cameraPos;
+uniform uint u_meshletCount;
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= u_meshletCount)
+        return;
+
+    Meshlet meshlet = meshlets[id];
+
+    vec3 center = (u_model * vec4(meshlet.center, 1.0)).xyz;
+    float radius = meshlet.radius * u_scale;
+
+    for (int i = 0; i < 6; i++)
+    {
+        vec4 plane = u_planes[i];
+        if (dot(plane.xyz, center) + plane.w < -radius * length(plane.xyz))
+            return;
+    }
+
+    if (meshlet.coneCutoff < 1.0)
+    {
+        vec3 axis = normalize(mat3(u_model) * meshlet.coneAxis);
+        vec3 view = center - u_cameraPos;
+        if (dot(view, axis) >= meshlet.coneCutoff * length(view) + radius)
+            return;
+    }
+
+    uint slot = atomicAdd(drawCount, 1);
+    commands[slot] = DrawCommand(meshlet.indexCount, 1, meshlet.firstIndex, 0, id);
+}
+#endif
+)glsl";
+
+    ClusterCuller::ClusterCuller(const Ref<Mesh>& mesh):
+        mesh(mesh), meshletCount(mesh->meshlets.size())
+    {
+        MGL_ASSERT(meshletCount > 0, "Mesh has no meshlets");
+
+        glCreateBuffers(1, &meshletBufferID);
+        glNamedBufferStorage(meshletBufferID, meshletCount * sizeof(Meshlet), mesh->meshlets.data(), 0);
+
+        glCreateBuffers(1, &commandBufferID);
+        glNamedBufferStorage(commandBufferID, meshletCount * sizeof(DrawCommand), nullptr, 0);
+
+        glCreateBuffers(1, &countBufferID);
+        glNamedBufferStorage(countBufferID, sizeof(uint32_t), nullptr, 0);
+
+        cullShader = Shader::from_source(cluster_cull_source);
+    }
+
+    ClusterCuller::~ClusterCuller()
+    {
+        glDeleteBuffers(1, &meshletBufferID);
+        glDeleteBuffers(1, &commandBufferID);
+        glDeleteBuffers(1, &countBufferID);
+    }
+
+    void ClusterCuller::cull(const Mat4& viewProj, const Vec3& cameraPos, const Mat4& model)
+    {
+        uint32_t zero = 0;
+        glClearNamedBufferData(countBufferID, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_BINDING, meshletBufferID);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, commandBufferID);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNT_BINDING, countBufferID);
+
+        static const UniformName planes_names[6] = {
+            "u_planes[0]", "u_planes[1]", "u_planes[2]",
+            "u_planes[3]", "u_planes[4]", "u_planes[5]"
+        };
+
+        Frustum frustum {viewProj};
+        for (int i = 0; i < 6; i++)
+            cullShader->upload(planes_names[i], frustum.planes[i]);
+
+        // Spheres are scaled by the largest axis scale
+        float scale = std::max({
+            glm::length(Vec3{model[0]}),
+            glm::length(Vec3{model[1]}),
+            glm::length(Vec3{model[2]})
+        });
+
+        cullShader->upload("u_model", model);
+        cullShader->upload("u_scale", scale);
+        cullShader->upload("u_cameraPos", cameraPos);
+        cullShader->upload("u_meshletCount", meshletCount);
+
+        cullShader->use();
+        RenderCommand::dispatch_compute((meshletCount + 63) / 64, 1, 1);
+
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    void ClusterCuller::draw(Primitives drawPrimitive)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBufferID);
+        glBindBuffer(GL_PARAMETER_BUFFER, countBufferID);
+
+        mesh->vertexArray->bind();
+        RenderCommand::draw_indirect_count(mesh->vertexArray, meshletCount, drawPrimitive);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "core.hpp"
+#include "geometry.hpp"
+#include "commands.hpp"
+#include "buffer.hpp"
+#include "shader.hpp"
+#include "mesh.hpp"
+
+namespace minigl
+{
+    /// Split an indexed triangle mesh into meshlets of at most
+    /// `max_vertices` vertices and `max_triangles` triangles.
+    /// Triangles are grouped greedily with their neighbours,
+    /// and `indices` is reordered so that the triangles of
+    /// each meshlet are contiguous.
+    std::vector<Meshlet> build_meshlets(const std::vector<Vertex>& vertices,
+                                        std::vector<uint32_t>& indices,
+                                        uint32_t max_vertices = 64,
+                                        uint32_t max_triangles = 124);
+
+    /// Load the OBJ file at `path`, split it into meshlets, and
+    /// create a mesh from the reordered indices, with its
+    /// meshlets.
+    Ref<Mesh> load_clustered_mesh(const std::string& path, DataAccess usage = DataAccess::Static);
+
+    /// GPU culling of the meshlets of a mesh: a compute shader
+    /// tests each meshlet against the frustum and its normal
+    /// cone against the camera position, and writes the draw
+    /// commands of the visible ones, which are then drawn with
+    /// a single multi draw indirect call. Each draw command has
+    /// the index of its meshlet as base instance.
+    class ClusterCuller
+    {
+        public:
+
+            /// Shader storage binding points of the meshlets,
+            /// the culled draw commands and the draw count
+            static constexpr uint32_t MESHLET_BINDING = 11;
+            static constexpr uint32_t COMMAND_BINDING = 12;
+            static constexpr uint32_t COUNT_BINDING = 13;
+
+            /// Upload the meshlets of `mesh`
+            explicit ClusterCuller(const Ref<Mesh>& mesh);
+
+            /// Destructor: deletes the buffers.
+            virtual ~ClusterCuller();
+
+            ClusterCuller(const ClusterCuller&) = delete;
+            ClusterCuller& operator=(const ClusterCuller&) = delete;
+
+            /// Cull the meshlets of the mesh drawn with the
+            /// `model` matrix, seen from a camera at
+            /// `cameraPos` with the `viewProj` matrix.
+            void cull(const Mat4& viewProj, const Vec3& cameraPos, const Mat4& model = Mat4{1.f});
+
+            /// Draw the meshlets that passed the last `cull()`,
+            /// with the shader in use.
+            void draw(Primitives drawPrimitive = Primitives::TRIANGLES);
+
+        private:
+
+            Ref<Mesh> mesh;
+            uint32_t meshletCount;
+
+            uint32_t meshletBufferID;
+            uint32_t commandBufferID;
+            uint32_t countBufferID;
+
+            Ref<Shader> cullShader;
+    };
+}
\ No newline at end of file
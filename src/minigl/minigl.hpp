@@ -16,11 +16,30 @@ using minigl::println;
 #include "app/app_3d.hpp"
 
 #include "geometry.hpp"
+#include "culling.hpp"
+#include "bvh.hpp"
+#include "thread_pool.hpp"
 #include "color.hpp"
 
 #include "commands.hpp"
+#include "command_buffer.hpp"
+#include "render_state.hpp"
+#include "sync.hpp"
 #include "buffer.hpp"
 #include "shader.hpp"
+#include "gpu_scene.hpp"
 
 #include "mesh.hpp"
-#include "texture.hpp"
\ No newline at end of file
+#include "mesh_loader.hpp"
+#include "geometry_pool.hpp"
+#include "mesh_optimizer.hpp"
+#include "vertex_compression.hpp"
+#include "lod.hpp"
+#include "meshlet.hpp"
+#include "texture.hpp"
+#include "texture_loader.hpp"
+#include "atlas.hpp"
+#include "mipmap.hpp"
+#include "compressed_texture.hpp"
+#include "bc_encoder.hpp"
+#include "texture_streamer.hpp"
\ No newline at end of file
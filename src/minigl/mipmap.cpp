@@ -0,0 +1,220 @@
+#include "mipmap.hpp"
+#include "thread_pool.hpp"
+
+#include <cmath>
+
+namespace minigl
+{
+    //----------- COLOR SPACE -----------//
+
+    static float srgb_to_linear(float c)
+    {
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    static float linear_to_srgb(float c)
+    {
+        return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+    }
+
+    /// Conversion of 8-bit channels to floats, sRGB decoded or
+    /// not
+    struct DecodeTable
+    {
+        float linear[256];
+        float srgb[256];
+
+        DecodeTable()
+        {
+            for (int i = 0; i < 256; i++) {
+                linear[i] = i / 255.f;
+                srgb[i] = srgb_to_linear(i / 255.f);
+            }
+        }
+    };
+
+    static uint8_t encode(float value, bool srgb)
+    {
+        value = std::clamp(value, 0.f, 1.f);
+        if (srgb)
+            value = linear_to_srgb(value);
+
+        return (uint8_t)(value * 255.f + 0.5f);
+    }
+
+    //----------- FILTERS -----------//
+
+    /// Zeroth order modified Bessel function of the first kind
+    static double bessel_i0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; k++) {
+            double f = x / (2.0 * k);
+            term *= f * f;
+            sum += term;
+            if (term < sum * 1e-12)
+                break;
+        }
+
+        return sum;
+    }
+
+    /// Kaiser windowed sinc, as in NVIDIA's texture tools
+    /// (width 3, alpha 4). `t` is in destination pixels.
+    static float kaiser(float t)
+    {
+        constexpr float width = 3.f, alpha = 4.f;
+        if (std::abs(t) >= width)
+            return 0.f;
+
+        float sinc = t == 0.f ? 1.f : std::sin(3.14159265f * t) / (3.14159265f * t);
+        float r = t / width;
+        float window = bessel_i0(alpha * std::sqrt(1.f - r * r)) / bessel_i0(alpha);
+
+        return sinc * window;
+    }
+
+    /// Source pixels and weights contributing to each pixel of
+    /// the destination, along one axis
+    struct FilterTaps
+    {
+        std::vector<uint32_t> offsets;
+        std::vector<int> first;
+        std::vector<float> weights;
+    };
+
+    /// Taps to resample `source` pixels into `destination`
+    /// pixels. Pixels past the edges are clamped.
+    static FilterTaps compute_taps(int source, int destination, MipmapGeneration filter)
+    {
+        FilterTaps taps {};
+        taps.offsets.push_back(0);
+
+        float scale = (float)source / destination;
+        float support = filter == MipmapGeneration::CPUKaiser ? 3.f : 0.5f;
+
+        for (int x = 0; x < destination; x++)
+        {
+            // Center of the destination pixel, in source pixels
+            float center = (x + 0.5f) * scale;
+            int first = (int)std::floor(center - support * scale);
+            int last = (int)std::ceil(center + support * scale);
+
+            size_t begin = taps.weights.size();
+            float total = 0.f;
+            for (int s = first; s <= last; s++)
+            {
+                float t = (s + 0.5f - center) / scale;
+
+                float weight;
+                if (filter == MipmapGeneration::CPUKaiser)
+                    weight = kaiser(t);
+                else
+                    weight = std::abs(t) < 0.5f ? 1.f : (std::abs(t) == 0.5f ? 0.5f : 0.f);
+
+                taps.weights.push_back(weight);
+                total += weight;
+            }
+
+            for (size_t i = begin; i < taps.weights.size(); i++)
+                taps.weights[i] /= total;
+
+            taps.first.push_back(first);
+            taps.offsets.push_back(taps.weights.size());
+        }
+
+        return taps;
+    }
+
+    /// Resample a `width` x `height` float image to half its
+    /// size (rounded down, at least 1), separably: rows first,
+    /// then columns.
+    static std::vector<float> downsample(const std::vector<float>& image, int width, int height, int channels,
+                                         int new_width, int new_height, MipmapGeneration filter)
+    {
+        auto horizontal = compute_taps(width, new_width, filter);
+        auto vertical = compute_taps(height, new_height, filter);
+
+        std::vector<float> rows((size_t)new_width * height * channels);
+        parallel_for(height, [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; y++) {
+                const float* src = &image[y * width * channels];
+                float* dst = &rows[y * new_width * channels];
+
+                for (int x = 0; x < new_width; x++) {
+                    for (int c = 0; c < channels; c++) {
+                        float sum = 0.f;
+                        for (uint32_t i = horizontal.offsets[x]; i < horizontal.offsets[x+1]; i++) {
+                            int s = std::clamp(horizontal.first[x] + (int)(i - horizontal.offsets[x]), 0, width - 1);
+                            sum += horizontal.weights[i] * src[s * channels + c];
+                        }
+                        dst[x * channels + c] = sum;
+                    }
+                }
+            }
+        }, 16);
+
+        std::vector<float> result((size_t)new_width * new_height * channels);
+        parallel_for(new_height, [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; y++) {
+                float* dst = &result[y * new_width * channels];
+                std::fill(dst, dst + new_width * channels, 0.f);
+
+                for (uint32_t i = vertical.offsets[y]; i < vertical.offsets[y+1]; i++) {
+                    int s = std::clamp(vertical.first[y] + (int)(i - vertical.offsets[y]), 0, height - 1);
+                    const float* src = &rows[(size_t)s * new_width * channels];
+                    float weight = vertical.weights[i];
+
+                    for (int j = 0; j < new_width * channels; j++)
+                        dst[j] += weight * src[j];
+                }
+            }
+        }, 8);
+
+        return result;
+    }
+
+    //----------- MIP CHAIN -----------//
+
+    std::vector<MipLevel> generate_mipmaps(const uint8_t* pixels, int width, int height, int channels,
+                                           bool srgb, MipmapGeneration filter)
+    {
+        MGL_ASSERT(filter == MipmapGeneration::CPUBox || filter == MipmapGeneration::CPUKaiser,
+                   "Mipmaps can only be generated on the CPU with a box or Kaiser filter");
+
+        static const DecodeTable table {};
+
+        // Alpha (the 4th channel) is never sRGB encoded
+        auto is_srgb = [&](int c) { return srgb && c < 3; };
+
+        size_t count = (size_t)width * height * channels;
+        std::vector<float> image(count);
+        parallel_for(count, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                image[i] = is_srgb(i % channels) ? table.srgb[pixels[i]] : table.linear[pixels[i]];
+        }, 1 << 16);
+
+        std::vector<MipLevel> levels {};
+        while (width > 1 || height > 1)
+        {
+            int new_width = std::max(width / 2, 1);
+            int new_height = std::max(height / 2, 1);
+
+            // Each level is filtered from the previous one, in
+            // float, so the rounding errors do not add up.
+            image = downsample(image, width, height, channels, new_width, new_height, filter);
+            width = new_width;
+            height = new_height;
+
+            MipLevel level {width, height, std::vector<uint8_t>(image.size())};
+            parallel_for(image.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                    level.pixels[i] = encode(image[i], is_srgb(i % channels));
+            }, 1 << 16);
+
+            levels.push_back(std::move(level));
+        }
+
+        return levels;
+    }
+}
\ No newline at end of file
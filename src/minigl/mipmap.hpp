@@ -0,0 +1,25 @@
+#pragma once
+
+#include "core.hpp"
+#include "texture.hpp"
+
+namespace minigl
+{
+    /// Level of a mip chain: 8-bit pixels, with the channels
+    /// of the source image
+    struct MipLevel
+    {
+        int width, height;
+        std::vector<uint8_t> pixels;
+    };
+
+    /// Downsample an 8-bit image of `channels` channels into
+    /// all the levels of its mip chain below the first one, each
+    /// level being filtered from the previous one with a box
+    /// (`MipmapGeneration::CPUBox`) or a Kaiser windowed sinc
+    /// (`MipmapGeneration::CPUKaiser`) filter. Color channels of
+    /// sRGB images are filtered in linear space; alpha is always
+    /// linear. Rows are filtered in parallel.
+    std::vector<MipLevel> generate_mipmaps(const uint8_t* pixels, int width, int height, int channels,
+                                           bool srgb, MipmapGeneration filter = MipmapGeneration::CPUKaiser);
+}
\ No newline at end of file
@@ -0,0 +1,500 @@
+#include "obj_parser.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <atomic>
+
+namespace minigl
+{
+    /// Files are split in chunks of at least this size, so that
+    /// small files are not spread over threads for nothing.
+    constexpr size_t min_chunk_size = 1 << 20;
+
+    /// Faces of a chunk that belong to the same shape, from
+    /// `first_face` up to the first face of the next span.
+    struct ObjShapeSpan
+    {
+        std::string name;
+        /// False if the span continues the shape of the
+        /// previous chunk.
+        bool starts_shape;
+        size_t first_face;
+    };
+
+    /// Data parsed from a chunk of the file. Attribute indices
+    /// are 0-based; relative (negative) indices are resolved
+    /// against the attributes of the chunk, and offset by the
+    /// attributes of the previous chunks when merging.
+    struct ObjChunk
+    {
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<float> texcoords;
+
+        /// Triangle corners, three per face
+        std::vector<tinyobj::index_t> corners;
+        /// Per-corner mask of the relative components (1:
+        /// position, 2: texcoord, 4: normal). Only filled once
+        /// the chunk has a relative index.
+        std::vector<uint8_t> relative;
+        bool has_relative = false;
+
+        /// Per-face index in `material_names`, or -1 if the
+        /// face uses the material active at the chunk start.
+        std::vector<int> face_materials;
+        std::vector<std::string> material_names;
+        /// Last `usemtl` of the chunk, or -1 if there is none.
+        int last_material = -1;
+
+        std::vector<ObjShapeSpan> spans;
+        std::vector<std::string> mtllibs;
+
+        std::string error;
+    };
+
+    static const char* skip_space(const char* p, const char* end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t'))
+            p++;
+        return p;
+    }
+
+    static const char* parse_float(const char* p, const char* end, float& value)
+    {
+        p = skip_space(p, end);
+        if (p < end && *p == '+')
+            p++;
+
+        auto [ptr, ec] = std::from_chars(p, end, value);
+        return ec == std::errc() ? ptr : nullptr;
+    }
+
+    static const char* parse_int(const char* p, const char* end, int& value)
+    {
+        auto [ptr, ec] = std::from_chars(p, end, value);
+        return ec == std::errc() ? ptr : nullptr;
+    }
+
+    /// Rest of the line after the keyword, without the
+    /// surrounding whitespace.
+    static std::string parse_name(const char* p, const char* end)
+    {
+        p = skip_space(p, end);
+        while (end > p && (end[-1] == ' ' || end[-1] == '\t'))
+            end--;
+        return std::string(p, end);
+    }
+
+    /// Check whether the line starts with `keyword` followed
+    /// by a space, and return the position after it.
+    static const char* match(const char* p, const char* end, const char* keyword)
+    {
+        size_t n = std::strlen(keyword);
+        if (size_t(end - p) > n && std::memcmp(p, keyword, n) == 0 && (p[n] == ' ' || p[n] == '\t'))
+            return p + n;
+        return nullptr;
+    }
+
+    /// Parse one attribute index of a face corner into
+    /// `index`, resolving it against the `count` attributes
+    /// parsed so far in the chunk.
+    static bool resolve_index(int value, size_t count, int& index, bool& relative)
+    {
+        if (value > 0) {
+            index = value - 1;
+            relative = false;
+        }
+        else if (value < 0) {
+            // May be negative if it points to a previous
+            // chunk; fixed up when merging.
+            index = (int)count + value;
+            relative = true;
+        }
+        else {
+            return false;
+        }
+
+        return true;
+    }
+
+    static const char* parse_corner(const char* p, const char* end, ObjChunk& chunk, tinyobj::index_t& idx, uint8_t& relative)
+    {
+        idx = {-1, -1, -1};
+        relative = 0;
+        bool rel = false;
+
+        int v;
+        p = parse_int(p, end, v);
+        if (!p || !resolve_index(v, chunk.positions.size()/3, idx.vertex_index, rel))
+            return nullptr;
+        relative |= rel ? 1 : 0;
+
+        if (p < end && *p == '/') {
+            p++;
+            if (p < end && *p != '/') {
+                p = parse_int(p, end, v);
+                if (!p || !resolve_index(v, chunk.texcoords.size()/2, idx.texcoord_index, rel))
+                    return nullptr;
+                relative |= rel ? 2 : 0;
+            }
+
+            if (p < end && *p == '/') {
+                p++;
+                p = parse_int(p, end, v);
+                if (!p || !resolve_index(v, chunk.normals.size()/3, idx.normal_index, rel))
+                    return nullptr;
+                relative |= rel ? 4 : 0;
+            }
+        }
+
+        return p;
+    }
+
+    static bool parse_face(const char* p, const char* end, ObjChunk& chunk, int material)
+    {
+        // Fan triangulation: (c0, c1, c2), (c0, c2, c3), ...
+        tinyobj::index_t first {}, prev {};
+        uint8_t first_rel = 0, prev_rel = 0;
+        int corner_count = 0;
+
+        while (true) {
+            p = skip_space(p, end);
+            if (p >= end)
+                break;
+
+            tinyobj::index_t idx;
+            uint8_t rel;
+            p = parse_corner(p, end, chunk, idx, rel);
+            if (!p)
+                return false;
+
+            if (corner_count >= 2) {
+                if ((first_rel | prev_rel | rel) && !chunk.has_relative) {
+                    chunk.relative.assign(chunk.corners.size(), 0);
+                    chunk.has_relative = true;
+                }
+
+                chunk.corners.insert(chunk.corners.end(), {first, prev, idx});
+                if (chunk.has_relative)
+                    chunk.relative.insert(chunk.relative.end(), {first_rel, prev_rel, rel});
+                chunk.face_materials.push_back(material);
+            }
+            else if (corner_count == 0) {
+                first = idx;
+                first_rel = rel;
+            }
+
+            prev = idx;
+            prev_rel = rel;
+            corner_count++;
+        }
+
+        return corner_count >= 3;
+    }
+
+    static void parse_chunk(const char* begin, const char* end, ObjChunk& chunk)
+    {
+        chunk.spans.push_back({"", false, 0});
+        int material = -1;
+
+        for (const char* line = begin; line < end; ) {
+            const char* eol = (const char*)std::memchr(line, '\n', end - line);
+            if (!eol)
+                eol = end;
+
+            const char* p = skip_space(line, eol);
+            const char* q = eol;
+            if (q > p && q[-1] == '\r')
+                q--;
+
+            bool ok = true;
+            const char* args;
+            if (p == q || *p == '#') {
+                // Empty line or comment
+            }
+            else if ((args = match(p, q, "v"))) {
+                float x, y, z;
+                ok = (args = parse_float(args, q, x)) && (args = parse_float(args, q, y)) && parse_float(args, q, z);
+                chunk.positions.insert(chunk.positions.end(), {x, y, z});
+            }
+            else if ((args = match(p, q, "vn"))) {
+                float x, y, z;
+                ok = (args = parse_float(args, q, x)) && (args = parse_float(args, q, y)) && parse_float(args, q, z);
+                chunk.normals.insert(chunk.normals.end(), {x, y, z});
+            }
+            else if ((args = match(p, q, "vt"))) {
+                float u, v = 0.f;
+                ok = (args = parse_float(args, q, u));
+                if (ok)
+                    parse_float(args, q, v);
+                chunk.texcoords.insert(chunk.texcoords.end(), {u, v});
+            }
+            else if ((args = match(p, q, "f"))) {
+                ok = parse_face(args, q, chunk, material);
+            }
+            else if ((args = match(p, q, "o")) || (args = match(p, q, "g"))) {
+                chunk.spans.push_back({parse_name(args, q), true, chunk.face_materials.size()});
+            }
+            else if ((args = match(p, q, "usemtl"))) {
+                auto name = parse_name(args, q);
+                auto it = std::find(chunk.material_names.begin(), chunk.material_names.end(), name);
+                material = int(it - chunk.material_names.begin());
+                if (it == chunk.material_names.end())
+                    chunk.material_names.push_back(name);
+                chunk.last_material = material;
+            }
+            else if ((args = match(p, q, "mtllib"))) {
+                chunk.mtllibs.push_back(parse_name(args, q));
+            }
+
+            if (!ok) {
+                chunk.error = fmt::format("malformed line '{}'", std::string(p, q));
+                return;
+            }
+
+            line = eol + 1;
+        }
+    }
+
+    /// Parse the materials of a MTL file, appending them to
+    /// `materials`.
+    static void parse_mtl(const std::string& path, std::vector<tinyobj::material_t>& materials, std::string& warn)
+    {
+        std::ifstream file(path);
+        if (!file) {
+            warn += fmt::format("Material file '{}' not found.\n", path);
+            return;
+        }
+
+        std::string line;
+        tinyobj::material_t* material = nullptr;
+        while (std::getline(file, line)) {
+            const char* p = skip_space(line.data(), line.data() + line.size());
+            const char* q = line.data() + line.size();
+            if (q > p && q[-1] == '\r')
+                q--;
+
+            const char* args;
+            if ((args = match(p, q, "newmtl"))) {
+                material = &materials.emplace_back();
+                material->name = parse_name(args, q);
+            }
+            else if (!material) {
+                continue;
+            }
+            else if ((args = match(p, q, "Kd"))) {
+                for (int i = 0; i < 3 && args; i++)
+                    args = parse_float(args, q, material->diffuse[i]);
+            }
+            else if ((args = match(p, q, "Pm"))) {
+                parse_float(args, q, material->metallic);
+            }
+            else if ((args = match(p, q, "Pr"))) {
+                parse_float(args, q, material->roughness);
+            }
+            else if ((args = match(p, q, "aniso"))) {
+                parse_float(args, q, material->anisotropy);
+            }
+            else if ((args = match(p, q, "map_Kd"))) {
+                material->diffuse_texname = parse_name(args, q);
+            }
+        }
+    }
+
+    bool parse_obj_parallel(const std::string& path,
+                            tinyobj::attrib_t& attrib,
+                            std::vector<tinyobj::shape_t>& shapes,
+                            std::vector<tinyobj::material_t>& materials,
+                            std::string& warn,
+                            std::string& err)
+    {
+        // Empty files cannot be mapped, but are valid (and
+        // empty) meshes, like with tinyobjloader.
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(path, ec) && std::filesystem::file_size(path, ec) == 0)
+            return true;
+
+        MappedFile file {path};
+        if (!file.valid()) {
+            err = fmt::format("Cannot open file '{}'", path);
+            return false;
+        }
+
+        auto data = (const char*)file.data();
+        size_t size = file.size();
+
+        // Split the file in chunks, moving each boundary after
+        // the end of the line it falls in.
+        size_t chunk_count = std::clamp<size_t>(size / min_chunk_size, 1, ThreadPool::global().size() * 4);
+        std::vector<size_t> bounds(chunk_count + 1, size);
+        bounds[0] = 0;
+        for (size_t c = 1; c < chunk_count; c++) {
+            size_t pos = std::max(c * size / chunk_count, bounds[c-1]);
+            auto eol = (const char*)std::memchr(data + pos, '\n', size - pos);
+            bounds[c] = eol ? size_t(eol - data) + 1 : size;
+        }
+
+        std::vector<ObjChunk> chunks(chunk_count);
+        parallel_for(chunk_count, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++)
+                parse_chunk(data + bounds[c], data + bounds[c+1], chunks[c]);
+        });
+
+        for (auto& chunk: chunks) {
+            if (!chunk.error.empty()) {
+                err = fmt::format("Failed to parse '{}': {}", path, chunk.error);
+                return false;
+            }
+        }
+
+        // Materials: read every library once, then map the
+        // names used by `usemtl` to material IDs.
+        auto directory = std::filesystem::path(path).parent_path();
+        std::vector<std::string> libraries {};
+        for (auto& chunk: chunks) {
+            for (auto& lib: chunk.mtllibs) {
+                if (std::find(libraries.begin(), libraries.end(), lib) == libraries.end()) {
+                    libraries.push_back(lib);
+                    parse_mtl((directory / lib).string(), materials, warn);
+                }
+            }
+        }
+
+        std::unordered_map<std::string, int> material_ids {};
+        for (size_t i = 0; i < materials.size(); i++)
+            material_ids[materials[i].name] = i;
+
+        // Per-chunk attribute offsets and material tables.
+        std::vector<size_t> position_base(chunk_count + 1, 0);
+        std::vector<size_t> normal_base(chunk_count + 1, 0);
+        std::vector<size_t> texcoord_base(chunk_count + 1, 0);
+        std::vector<std::vector<int>> chunk_material_ids(chunk_count);
+        std::vector<int> start_material(chunk_count, -1);
+
+        int active_material = -1;
+        for (size_t c = 0; c < chunk_count; c++) {
+            auto& chunk = chunks[c];
+            position_base[c+1] = position_base[c] + chunk.positions.size();
+            normal_base[c+1] = normal_base[c] + chunk.normals.size();
+            texcoord_base[c+1] = texcoord_base[c] + chunk.texcoords.size();
+
+            for (auto& name: chunk.material_names) {
+                auto it = material_ids.find(name);
+                if (it == material_ids.end())
+                    warn += fmt::format("Material '{}' not found.\n", name);
+                chunk_material_ids[c].push_back(it != material_ids.end() ? it->second : -1);
+            }
+
+            start_material[c] = active_material;
+            if (chunk.last_material >= 0)
+                active_material = chunk_material_ids[c][chunk.last_material];
+        }
+
+        // Shapes: a span either starts a new shape or extends
+        // the current one. Record where each span goes.
+        struct SpanTarget { size_t shape; size_t first_face; };
+        std::vector<std::vector<SpanTarget>> targets(chunk_count);
+        std::vector<size_t> shape_faces {};
+
+        for (size_t c = 0; c < chunk_count; c++) {
+            auto& chunk = chunks[c];
+            for (size_t s = 0; s < chunk.spans.size(); s++) {
+                auto& span = chunk.spans[s];
+                size_t end_face = s + 1 < chunk.spans.size() ? chunk.spans[s+1].first_face : chunk.face_materials.size();
+                size_t face_count = end_face - span.first_face;
+
+                if (span.starts_shape || shapes.empty()) {
+                    // Reuse the current shape if it is still
+                    // empty (e.g. "o" followed by "g").
+                    if (shapes.empty() || shape_faces.back() > 0) {
+                        shapes.emplace_back();
+                        shape_faces.push_back(0);
+                    }
+                    shapes.back().name = span.name;
+                }
+
+                targets[c].push_back({shapes.size() - 1, shape_faces.back()});
+                shape_faces.back() += face_count;
+            }
+        }
+
+        if (!shapes.empty() && shape_faces.back() == 0) {
+            shapes.pop_back();
+            shape_faces.pop_back();
+        }
+
+        for (size_t s = 0; s < shapes.size(); s++) {
+            auto& mesh = shapes[s].mesh;
+            mesh.indices.resize(shape_faces[s] * 3);
+            mesh.num_face_vertices.assign(shape_faces[s], 3);
+            mesh.material_ids.resize(shape_faces[s]);
+            mesh.smoothing_group_ids.assign(shape_faces[s], 0);
+        }
+
+        attrib.vertices.resize(position_base.back());
+        attrib.normals.resize(normal_base.back());
+        attrib.texcoords.resize(texcoord_base.back());
+
+        // Gather the chunks into the attributes and shapes,
+        // resolving the relative indices.
+        int vertex_count = position_base.back() / 3;
+        int normal_count = normal_base.back() / 3;
+        int texcoord_count = texcoord_base.back() / 2;
+        std::atomic<bool> out_of_range = false;
+
+        parallel_for(chunk_count, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; c++) {
+                auto& chunk = chunks[c];
+                std::copy(chunk.positions.begin(), chunk.positions.end(), attrib.vertices.begin() + position_base[c]);
+                std::copy(chunk.normals.begin(), chunk.normals.end(), attrib.normals.begin() + normal_base[c]);
+                std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), attrib.texcoords.begin() + texcoord_base[c]);
+
+                int vertex_offset = position_base[c] / 3;
+                int normal_offset = normal_base[c] / 3;
+                int texcoord_offset = texcoord_base[c] / 2;
+
+                for (size_t s = 0; s < chunk.spans.size(); s++) {
+                    if (targets[c][s].shape >= shapes.size())
+                        continue;
+
+                    auto& mesh = shapes[targets[c][s].shape].mesh;
+                    size_t first_face = chunk.spans[s].first_face;
+                    size_t end_face = s + 1 < chunk.spans.size() ? chunk.spans[s+1].first_face : chunk.face_materials.size();
+
+                    for (size_t f = first_face; f < end_face; f++) {
+                        size_t dst_face = targets[c][s].first_face + f - first_face;
+
+                        int local = chunk.face_materials[f];
+                        mesh.material_ids[dst_face] = local >= 0 ? chunk_material_ids[c][local] : start_material[c];
+
+                        for (size_t k = 0; k < 3; k++) {
+                            auto idx = chunk.corners[3*f + k];
+                            uint8_t rel = chunk.has_relative ? chunk.relative[3*f + k] : 0;
+                            if (rel & 1) idx.vertex_index += vertex_offset;
+                            if (rel & 2) idx.texcoord_index += texcoord_offset;
+                            if (rel & 4) idx.normal_index += normal_offset;
+
+                            if (idx.vertex_index < 0 || idx.vertex_index >= vertex_count
+                                || idx.texcoord_index >= texcoord_count
+                                || idx.normal_index >= normal_count
+                                || (rel & 2 && idx.texcoord_index < 0)
+                                || (rel & 4 && idx.normal_index < 0))
+                                out_of_range = true;
+
+                            mesh.indices[3*dst_face + k] = idx;
+                        }
+                    }
+                }
+            }
+        });
+
+        if (out_of_range) {
+            err = fmt::format("Failed to parse '{}': face index out of range", path);
+            return false;
+        }
+
+        return true;
+    }
+}
\ No newline at end of file
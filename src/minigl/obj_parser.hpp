@@ -0,0 +1,26 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <tiny_obj_loader.h>
+
+namespace minigl
+{
+    /// Parse the OBJ file at `path` into tinyobj's data
+    /// structures, splitting the file in chunks parsed in
+    /// parallel on the global thread pool. Faces are
+    /// triangulated as fans, and materials are read from the
+    /// `mtllib` files found next to the OBJ file. Only the
+    /// statements used by `load_mesh` are supported (`v`,
+    /// `vn`, `vt`, `f`, `o`, `g`, `usemtl` and `mtllib`); the
+    /// others are ignored.
+    ///
+    /// @return False if the file could not be read or is
+    ///     malformed, in which case `err` holds the reason.
+    bool parse_obj_parallel(const std::string& path,
+                            tinyobj::attrib_t& attrib,
+                            std::vector<tinyobj::shape_t>& shapes,
+                            std::vector<tinyobj::material_t>& materials,
+                            std::string& warn,
+                            std::string& err);
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "render_state.hpp"
+
+namespace minigl
+{
+    /// Value of a shadowed state, which is unknown until it
+    /// is first set.
+    template<typename T>
+    struct Shadowed
+    {
+        T value {};
+        bool known = false;
+
+        /// Record `v`, and return whether it differs from
+        /// the current value.
+        bool set(const T& v)
+        {
+            if (known && value == v)
+                return false;
+
+            value = v;
+            known = true;
+            return true;
+        }
+    };
+
+    struct ShadowState
+    {
+        Shadowed<bool> depthTest, depthClamp, faceCulling;
+        Shadowed<std::array<float, 4>> clearColor;
+        Shadowed<std::array<int, 4>> viewport;
+        Shadowed<GLenum> polygonMode;
+        Shadowed<GLuint> program, vertexArray;
+        std::vector<Shadowed<GLuint>> textures;
+
+        RenderStateStats stats;
+    };
+
+    static ShadowState state {};
+
+    /// Count the change, and return whether it has to be
+    /// issued.
+    static bool update(bool changed)
+    {
+        changed ? state.stats.issued++
+                : state.stats.skipped++;
+        return changed;
+    }
+
+    void RenderState::set_capability(GLenum capability, bool enabled)
+    {
+        Shadowed<bool>* shadow = nullptr;
+        switch (capability)
+        {
+            case GL_DEPTH_TEST: shadow = &state.depthTest; break;
+            case GL_DEPTH_CLAMP: shadow = &state.depthClamp; break;
+            case GL_CULL_FACE: shadow = &state.faceCulling; break;
+        }
+
+        if (shadow && !update(shadow->set(enabled)))
+            return;
+
+        enabled ? glEnable(capability)
+                : glDisable(capability);
+    }
+
+    void RenderState::set_clear_color(const Color& color)
+    {
+        if (update(state.clearColor.set({ color.r, color.g, color.b, color.a })))
+            glClearColor(color.r, color.g, color.b, color.a);
+    }
+
+    void RenderState::set_viewport(int x, int y, int width, int height)
+    {
+        if (update(state.viewport.set({ x, y, width, height })))
+            glViewport(x, y, width, height);
+    }
+
+    void RenderState::set_polygon_mode(GLenum mode)
+    {
+        if (update(state.polygonMode.set(mode)))
+            glPolygonMode(GL_FRONT_AND_BACK, mode);
+    }
+
+    void RenderState::use_program(GLuint program)
+    {
+        if (update(state.program.set(program)))
+            glUseProgram(program);
+    }
+
+    void RenderState::bind_vertex_array(GLuint vertexArray)
+    {
+        if (update(state.vertexArray.set(vertexArray)))
+            glBindVertexArray(vertexArray);
+    }
+
+    void RenderState::bind_texture_unit(uint32_t unit, GLuint texture)
+    {
+        if (unit >= state.textures.size())
+            state.textures.resize(unit + 1);
+
+        if (update(state.textures[unit].set(texture)))
+            glBindTextureUnit(unit, texture);
+    }
+
+    void RenderState::invalidate()
+    {
+        auto stats = state.stats;
+        state = ShadowState {};
+        state.stats = stats;
+    }
+
+    const RenderStateStats& RenderState::stats()
+    {
+        return state.stats;
+    }
+
+    void RenderState::reset_stats()
+    {
+        state.stats = RenderStateStats {};
+    }
+}
\ No newline at end of file
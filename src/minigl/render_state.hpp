@@ -0,0 +1,52 @@
+#pragma once
+
+#include "mglpch.hpp"
+#include "color.hpp"
+
+#include <glad/glad.h>
+
+namespace minigl
+{
+    /// Number of state changes requested to `RenderState`
+    struct RenderStateStats
+    {
+        /// Changes which reached the driver
+        uint64_t issued = 0;
+
+        /// Redundant changes, which were dropped
+        uint64_t skipped = 0;
+    };
+
+    /// Shadow copy of the OpenGL state. The render commands,
+    /// shaders, vertex arrays and textures change the state
+    /// through this class, which only forwards the calls that
+    /// actually change a value. Like the rest of the library,
+    /// it assumes a single context, used from one thread.
+    ///
+    /// Code that changes the state with raw OpenGL calls must
+    /// call `invalidate()` afterwards.
+    class RenderState
+    {
+        public:
+
+            /// Enable or disable a capability. Only depth
+            /// testing, depth clamping and face culling are
+            /// tracked, other capabilities are always set.
+            static void set_capability(GLenum capability, bool enabled);
+
+            static void set_clear_color(const Color& color);
+            static void set_viewport(int x, int y, int width, int height);
+            static void set_polygon_mode(GLenum mode);
+
+            static void use_program(GLuint program);
+            static void bind_vertex_array(GLuint vertexArray);
+            static void bind_texture_unit(uint32_t unit, GLuint texture);
+
+            /// Forget the shadowed state: the next calls are
+            /// all issued.
+            static void invalidate();
+
+            static const RenderStateStats& stats();
+            static void reset_stats();
+    };
+}
\ No newline at end of file
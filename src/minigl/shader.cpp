@@ -1,5 +1,14 @@
 #include "core.hpp"
 #include "shader.hpp"
+#include "render_state.hpp"
+
+#include <mutex>
+#include <shared_mutex>
+#include <deque>
+#include <cstring>
+#include <thread>
+
+#include <GLFW/glfw3.h>
 
 namespace minigl
 {
@@ -16,6 +25,79 @@ namespace minigl
         return "UNKNOWN";
     }
 
+    /// Global uniform name interning table. Names are never
+    /// removed, so their IDs stay valid for the whole program.
+    struct UniformNames
+    {
+        std::shared_mutex mutex;
+        std::unordered_map<std::string, uint32_t> ids;
+        std::deque<std::string> names;
+
+        static UniformNames& get()
+        {
+            static UniformNames table {};
+            return table;
+        }
+
+        uint32_t intern(const std::string& name)
+        {
+            {
+                std::shared_lock lock {mutex};
+                auto it = ids.find(name);
+                if (it != ids.end())
+                    return it->second;
+            }
+
+            std::unique_lock lock {mutex};
+            auto [it, inserted] = ids.try_emplace(name, (uint32_t)names.size());
+            if (inserted)
+                names.push_back(name);
+
+            return it->second;
+        }
+    };
+
+    UniformName::UniformName(const char* name):
+        index(UniformNames::get().intern(name))
+    {}
+
+    UniformName::UniformName(const std::string& name):
+        index(UniformNames::get().intern(name))
+    {}
+
+    const std::string& UniformName::str() const
+    {
+        auto& table = UniformNames::get();
+        std::shared_lock lock {table.mutex};
+        return table.names[index];
+    }
+
+    /// Header of the program binary cache files, followed by
+    /// the binary itself.
+    struct ProgramBinaryHeader
+    {
+        char magic[4];
+        GLenum format;
+        uint64_t key;
+        uint64_t length;
+    };
+
+    static std::string binary_cache_directory = "shader_cache";
+
+    static std::filesystem::path binary_path(uint64_t key)
+    {
+        return std::filesystem::path(binary_cache_directory) / fmt::format("{:016x}.bin", key);
+    }
+
+    /// Whether the driver supports at least one program
+    /// binary format.
+    static bool binaries_supported()
+    {
+        GLint format_count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+        return format_count > 0;
+    }
+
     Shader::Shader(const std::string& filepath)
     {
         // Read the source file, extract the shader sources and
@@ -37,6 +119,14 @@ namespace minigl
         compile(sources);
     }
 
+    Ref<Shader> Shader::from_source(const std::string& source)
+    {
+        auto shader = ref<Shader>();
+        shader->compile(shader->preprocess(source));
+
+        return shader;
+    }
+
     Shader::~Shader()
     {
         glDeleteProgram(shaderID);
@@ -95,15 +185,182 @@ namespace minigl
         return shader_sources;
     }
 
+    void Shader::set_binary_cache(const std::string& directory)
+    {
+        binary_cache_directory = directory;
+    }
+
+    uint64_t Shader::binary_key(const std::unordered_map<GLenum, std::string>& shaderSources)
+    {
+        // Hash the stages in a fixed order, since the map
+        // order is unspecified.
+        std::vector<GLenum> types {};
+        for (auto& [type, source]: shaderSources)
+            types.push_back(type);
+        std::sort(types.begin(), types.end());
+
+        uint64_t key = hash_bytes(nullptr, 0);
+        for (auto type: types) {
+            auto& source = shaderSources.at(type);
+            key = hash_bytes(&type, sizeof(type), key);
+            key = hash_bytes(source.data(), source.size(), key);
+        }
+
+        // A binary is only valid for the driver that produced
+        // it.
+        for (GLenum name: { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+            auto str = (const char*)glGetString(name);
+            if (str)
+                key = hash_bytes(str, std::strlen(str), key);
+        }
+
+        return key;
+    }
+
+    bool Shader::load_binary(uint64_t key)
+    {
+        if (binary_cache_directory.empty() || !binaries_supported())
+            return false;
+
+        std::ifstream file(binary_path(key), std::ios::binary);
+        if (!file)
+            return false;
+
+        ProgramBinaryHeader header {};
+        file.read((char*)&header, sizeof(header));
+        if (!file || std::memcmp(header.magic, "MGLP", 4) != 0 || header.key != key)
+            return false;
+
+        std::vector<char> binary(header.length);
+        file.read(binary.data(), binary.size());
+        if (!file)
+            return false;
+
+        shaderID = glCreateProgram();
+        glProgramBinary(shaderID, header.format, binary.data(), binary.size());
+
+        // The driver may reject binaries it produced itself
+        // (e.g. after an update that kept the version string).
+        int isLinked = 0;
+        glGetProgramiv(shaderID, GL_LINK_STATUS, &isLinked);
+        if (isLinked == GL_FALSE) {
+            trace("Cached program binary {:016x} rejected by the driver, recompiling", key);
+            glDeleteProgram(shaderID);
+            shaderID = 0;
+            return false;
+        }
+
+        return true;
+    }
+
+    void Shader::save_binary(uint64_t key) const
+    {
+        if (binary_cache_directory.empty() || !binaries_supported())
+            return;
+
+        int isLinked = 0;
+        glGetProgramiv(shaderID, GL_LINK_STATUS, &isLinked);
+        if (isLinked == GL_FALSE)
+            return;
+
+        GLint length = 0;
+        glGetProgramiv(shaderID, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        ProgramBinaryHeader header {};
+        std::memcpy(header.magic, "MGLP", 4);
+        header.key = key;
+
+        std::vector<char> binary(length);
+        glGetProgramBinary(shaderID, length, nullptr, &header.format, binary.data());
+        header.length = binary.size();
+
+        std::error_code ec;
+        std::filesystem::create_directories(binary_cache_directory, ec);
+
+        // Write to a temporary file and rename it, so that a
+        // concurrent run never reads a partial binary.
+        auto path = binary_path(key);
+        auto tmp_path = path;
+        tmp_path += ".tmp";
+        {
+            std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+            file.write((const char*)&header, sizeof(header));
+            file.write(binary.data(), binary.size());
+            if (!file) {
+                warn("Could not write program binary '{}'", path.string());
+                return;
+            }
+        }
+
+        std::filesystem::rename(tmp_path, path, ec);
+        if (ec)
+            std::filesystem::remove(tmp_path, ec);
+    }
+
+    /// Entry point and enum of KHR_parallel_shader_compile,
+    /// which are not part of the core profile loaded by GLAD.
+    #define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+    #define GL_COMPLETION_STATUS_KHR 0x91B1
+    typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+    /// Whether the driver supports KHR_parallel_shader_compile
+    /// (or its ARB predecessor). On the first call, also lets
+    /// the driver use as many compiler threads as it wants.
+    static bool parallel_compile_supported()
+    {
+        static const bool supported = [] {
+            GLint extension_count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+
+            bool found = false;
+            for (GLint i = 0; i < extension_count && !found; i++) {
+                auto name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+                found = std::strcmp(name, "GL_KHR_parallel_shader_compile") == 0
+                     || std::strcmp(name, "GL_ARB_parallel_shader_compile") == 0;
+            }
+
+            if (!found) {
+                trace("Parallel shader compilation is not supported");
+                return false;
+            }
+
+            auto max_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+            if (!max_threads)
+                max_threads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+            if (max_threads)
+                max_threads(0xFFFFFFFF);
+
+            return true;
+        }();
+
+        return supported;
+    }
+
     void Shader::compile(const std::unordered_map<GLenum, std::string>& shaderSources)
     {
+        submit(shaderSources);
+        finish();
+    }
+
+    void Shader::submit(const std::unordered_map<GLenum, std::string>& shaderSources)
+    {
+        binaryKey = binary_key(shaderSources);
+        if (load_binary(binaryKey))
+            return;
+
         shaderID = glCreateProgram();
 
+        // Tell the driver the binary will be retrieved, so
+        // that it keeps it around after linking.
+        glProgramParameteri(shaderID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
         MGL_ASSERT(shaderSources.size() <= 3, "Too many shaders.");
-        std::array<GLenum, 3> glShaderIDs {};
 
-        // Compile the shaders
-        int shaderIndex = 0;
+        // Compile the shaders and link the program without
+        // querying any status: the driver is free to do the
+        // work in the background until finish() is called.
         for (auto&[type, source]: shaderSources)
         {
             GLuint shader = glCreateShader(type);
@@ -112,126 +369,259 @@ namespace minigl
             glShaderSource(shader, 1, &source_c_str, nullptr);
             glCompileShader(shader);
 
-            // Check if the compilation fails
-            int isCompiled = 0;
-            glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
-
-            if(isCompiled == GL_FALSE)
-            {
-                int maxLength = 0;
-                glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+            glAttachShader(shaderID, shader);
+            stageIDs.push_back(shader);
+        }
 
-                std::vector<char> infoLog(maxLength);
-                glGetShaderInfoLog(shader, maxLength, &maxLength, &infoLog[0]);
+        glLinkProgram(shaderID);
+    }
 
-                glDeleteShader(shader);
+    bool Shader::completed() const
+    {
+        if (stageIDs.empty() || !parallel_compile_supported())
+            return true;
 
-                error("Shader {} compilation failure !", type);
-                error("{}", infoLog.data());
-                MGL_ASSERT(false, "OpenGL shader compilation failure !");
-            }
+        int isCompleted = 0;
+        glGetProgramiv(shaderID, GL_COMPLETION_STATUS_KHR, &isCompleted);
+        return isCompleted == GL_TRUE;
+    }
 
-            glAttachShader(shaderID, shader);
-            glShaderIDs[shaderIndex++] = shader;
+    void Shader::finish()
+    {
+        // Loaded from the binary cache
+        if (stageIDs.empty()) {
+            cache_locations();
+            return;
         }
 
-        // Link our bufferID
-        glLinkProgram(shaderID);
-
         int isLinked = 0;
         glGetProgramiv(shaderID, GL_LINK_STATUS, (int*)&isLinked);
         if (isLinked == GL_FALSE)
         {
+            // Report the stages which failed to compile, as
+            // their log is more useful than the link log.
+            bool compiled = true;
+            for (auto& id: stageIDs)
+            {
+                int isCompiled = 0;
+                glGetShaderiv(id, GL_COMPILE_STATUS, &isCompiled);
+                if (isCompiled == GL_TRUE)
+                    continue;
+
+                int maxLength = 0;
+                glGetShaderiv(id, GL_INFO_LOG_LENGTH, &maxLength);
+
+                std::vector<char> infoLog(maxLength + 1);
+                glGetShaderInfoLog(id, maxLength, &maxLength, &infoLog[0]);
+
+                int type = 0;
+                glGetShaderiv(id, GL_SHADER_TYPE, &type);
+
+                error("Shader {} compilation failure !", to_string(ShaderType(type)));
+                error("{}", infoLog.data());
+                compiled = false;
+            }
+
             int maxLength = 0;
             glGetProgramiv(shaderID, GL_INFO_LOG_LENGTH, &maxLength);
 
-            std::vector<char> infoLog(maxLength);
+            std::vector<char> infoLog(maxLength + 1);
             glGetProgramInfoLog(shaderID, maxLength, &maxLength, &infoLog[0]);
 
             glDeleteProgram(shaderID);
 
-            for (auto& id: glShaderIDs)
+            for (auto& id: stageIDs)
                 glDeleteShader(id);
+            stageIDs.clear();
+
+            MGL_ASSERT(compiled, "OpenGL shader compilation failure !");
 
             error("Shader link failure !");
             error("{}", infoLog.data());
             MGL_ASSERT(false, "OpenGL shader link failure !");
         }
 
-        for (auto& id: glShaderIDs)
+        for (auto& id: stageIDs)
         {
-            // Always detach the shaders after a succesful linkage
+            // Always detach the shaders after a succesful
+            // linkage, they are not needed anymore.
             glDetachShader(shaderID, id);
+            glDeleteShader(id);
+        }
+        stageIDs.clear();
+
+        cache_locations();
+        save_binary(binaryKey);
+    }
+
+    Ref<Shader> ShaderBatch::add(const std::string& filepath)
+    {
+        auto shader = ref<Shader>();
+        auto shaderSources = shader->preprocess(shader->readFile(filepath));
+        queued.push_back({ shader, std::move(shaderSources), filepath });
+
+        return shader;
+    }
+
+    Ref<Shader> ShaderBatch::add(const std::string& vertexSrc,
+                                 const std::string& fragmentSrc)
+    {
+        std::unordered_map<GLenum, std::string> sources;
+        sources[GL_VERTEX_SHADER] = vertexSrc;
+        sources[GL_FRAGMENT_SHADER] = fragmentSrc;
+
+        auto shader = ref<Shader>();
+        queued.push_back({ shader, std::move(sources), {} });
+
+        return shader;
+    }
+
+    void ShaderBatch::submit()
+    {
+        for (auto& entry: queued) {
+            entry.shader->submit(entry.sources);
+            pending.push_back(std::move(entry));
+        }
+        queued.clear();
+    }
+
+    bool ShaderBatch::poll()
+    {
+        submit();
+
+        // Finish the programs as soon as they are ready,
+        // while the others keep compiling.
+        auto done = std::partition(pending.begin(), pending.end(), [](const Entry& entry) {
+            return !entry.shader->completed();
+        });
+
+        for (auto it = done; it != pending.end(); it++) {
+            it->shader->finish();
+            if (!it->path.empty())
+                trace("Loaded shader from file '{}'", it->path);
+        }
+        pending.erase(done, pending.end());
+
+        return pending.empty();
+    }
+
+    void ShaderBatch::build()
+    {
+        while (!poll())
+            std::this_thread::yield();
+    }
+
+    void Shader::cache_locations()
+    {
+        GLint uniform_count = 0;
+        glGetProgramInterfaceiv(shaderID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniform_count);
+
+        locations.clear();
+        std::string name;
+        for (GLint i = 0; i < uniform_count; i++)
+        {
+            const GLenum props[] = { GL_NAME_LENGTH, GL_LOCATION, GL_ARRAY_SIZE };
+            GLint values[3] {};
+            glGetProgramResourceiv(shaderID, GL_UNIFORM, i, 3, props, 3, nullptr, values);
+
+            // Uniforms in blocks have no location
+            GLint location = values[1];
+            if (location < 0)
+                continue;
+
+            name.resize(values[0]);
+            glGetProgramResourceName(shaderID, GL_UNIFORM, i, values[0], nullptr, name.data());
+            name.resize(values[0] - 1);
+
+            auto add = [this](const UniformName& name, GLint location) {
+                uint32_t id = UniformName(name).id();
+                if (id >= locations.size())
+                    locations.resize(id + 1, -1);
+                locations[id] = location;
+            };
+
+            add(name, location);
+
+            // Arrays are reported as "name[0]": register the
+            // bare name and every element, which have
+            // consecutive locations.
+            if (name.ends_with("[0]"))
+            {
+                auto base = name.substr(0, name.size() - 3);
+                add(base, location);
+                for (GLint e = 1; e < values[2]; e++)
+                    add(base + "[" + std::to_string(e) + "]", location + e);
+            }
         }
     }
 
     void Shader::use() const
     {
-        glUseProgram(shaderID);
+        RenderState::use_program(shaderID);
     }
 
     void Shader::unbind() const
     {
-        glUseProgram(0);
+        RenderState::use_program(0);
     }
 
-    void Shader::upload(const std::string& name, bool val)
+    void Shader::upload(const UniformName& name, bool val)
     {
-        GLint location = glGetUniformLocation(shaderID, name.c_str());
+        GLint location = this->location(name);
         glProgramUniform1i(shaderID, location, (int)val);
     }
 
-    void Shader::upload(const std::string& name, uint32_t val)
+    void Shader::upload(const UniformName& name, uint32_t val)
     {
-        GLint location = glGetUniformLocation(shaderID, name.c_str());
+        GLint location = this->location(name);
         glProgramUniform1ui(shaderID, location, val);
     }
 
-    void Shader::upload(const std::string& name, int val)
+    void Shader::upload(const UniformName& name, int val)
     {
-        GLint location = glGetUniformLocation(shaderID, name.c_str());
+        GLint location = this->location(name);
         glProgramUniform1i(shaderID, location, val);
     }
 
-    void Shader::upload(const std::string& name, float val)
+    void Shader::upload(const UniformName& name, float val)
     {
-        GLint location = glGetUniformLocation(shaderID, name.c_str());
+        GLint location = this->location(name);
         glProgramUniform1f(shaderID, location, val);
     }
 
-    void Shader::upload(const std::string& name, const Vec2& val)
+    void Shader::upload(const UniformName& name, const Vec2& val)
     {
-        GLint location = glGetUniformLocation(shaderID, name.c_str());
+        GLint location = this->location(name);
         glProgramUniform2f(shaderID, location, val.x, val.y);
     }
 
-    void Shader::upload(const std::string& name, const Vec3& val)
+    void Shader::upload(const UniformName& name, const Vec3& val)
     {
-        GLint location = glGetUniformLocation(shaderID, name.c_str());
+        GLint location = this->location(name);
         glProgramUniform3f(shaderID, location, val.x, val.y, val.z);
     }
 
-    void Shader::upload(const std::string& name, const Vec4& val)
+    void Shader::upload(const UniformName& name, const Vec4& val)
     {
-        GLint location = glGetUniformLocation(shaderID, name.c_str());
+        GLint location = this->location(name);
         glProgramUniform4f(shaderID, location, val.x, val.y, val.z, val.w);
     }
 
-    void Shader::upload(const std::string& name, const Mat3& matrix)
+    void Shader::upload(const UniformName& name, const Mat3& matrix)
     {
-        GLint location = glGetUniformLocation(shaderID, name.c_str());
+        GLint location = this->location(name);
         glProgramUniformMatrix3fv(shaderID, location, 1, GL_FALSE, &matrix[0][0]);
     }
 
-    void Shader::upload(const std::string& name, const Mat4& matrix)
+    void Shader::upload(const UniformName& name, const Mat4& matrix)
     {
-        GLint location = glGetUniformLocation(shaderID, name.c_str());
+        GLint location = this->location(name);
         glProgramUniformMatrix4fv(shaderID, location, 1, GL_FALSE, &matrix[0][0]);
     }
 
-    void Shader::texture(const std::string& name, Ref<Texture> texture, uint32_t slot)
+    void Shader::texture(const UniformName& name, Ref<Texture> texture, uint32_t slot)
     {
-        GLint location = glGetUniformLocation(shaderID, name.c_str());
+        GLint location = this->location(name);
         glProgramUniform1i(shaderID, location, slot);
     }
 }
\ No newline at end of file
@@ -16,6 +16,30 @@ namespace minigl
         COMPUTE = GL_COMPUTE_SHADER,
     };
 
+    /// Interned uniform name. Each distinct name is mapped
+    /// once to a small global ID, which indexes the location
+    /// tables of the shaders: uploading to a `UniformName`
+    /// built once (e.g. a static) costs an array lookup,
+    /// without hashing the name or querying the driver.
+    /// Strings convert implicitly, at the cost of a hash
+    /// lookup in the interning table.
+    class UniformName
+    {
+        public:
+
+            UniformName(const char* name);
+            UniformName(const std::string& name);
+
+            uint32_t id() const { return index; }
+
+            /// The name of the uniform
+            const std::string& str() const;
+
+        private:
+
+            uint32_t index;
+    };
+
     /// Shader abstraction class, in order to easily load and
     /// execute GLSL programs.
     class Shader
@@ -33,27 +57,78 @@ namespace minigl
             Shader(const std::string& vertexSrc,
                    const std::string& fragmentSrc);
             
+            /// Create a shader from GLSL source, with the stages
+            /// in `#ifdef` blocks like in a shader file
+            static Ref<Shader> from_source(const std::string& source);
+
             /// Destructor: calls `glDeleteProgram()`.
             virtual ~Shader();
 
             void use() const;
             void unbind() const;
 
-            void upload(const std::string& name, bool val);
-            void upload(const std::string& name, uint32_t val);
-            void upload(const std::string& name, int val);
-            void upload(const std::string& name, float val);
-            void upload(const std::string& name, const Vec2& val);
-            void upload(const std::string& name, const Vec3& val);
-            void upload(const std::string& name, const Vec4& val);
-            void upload(const std::string& name, const Mat3& matrix);
-            void upload(const std::string& name, const Mat4& matrix);
+            void upload(const UniformName& name, bool val);
+            void upload(const UniformName& name, uint32_t val);
+            void upload(const UniformName& name, int val);
+            void upload(const UniformName& name, float val);
+            void upload(const UniformName& name, const Vec2& val);
+            void upload(const UniformName& name, const Vec3& val);
+            void upload(const UniformName& name, const Vec4& val);
+            void upload(const UniformName& name, const Mat3& matrix);
+            void upload(const UniformName& name, const Mat4& matrix);
+
+            void texture(const UniformName& name, Ref<Texture> texture, uint32_t slot = 0);
+
+            /// Set the directory of the program binary cache
+            /// (`shader_cache` by default). Linked programs are
+            /// saved there with `glGetProgramBinary`, and loaded
+            /// back on the next runs instead of being compiled,
+            /// as long as the sources and the driver did not
+            /// change. An empty path disables the cache.
+            static void set_binary_cache(const std::string& directory);
 
-            void texture(const std::string& name, Ref<Texture> texture, uint32_t slot = 0);
+            /// Location of the uniform in the program, or -1 if
+            /// the program has no such active uniform.
+            GLint location(const UniformName& name) const
+            {
+                return name.id() < locations.size() ? locations[name.id()] : -1;
+            }
 
         private:
 
-            uint32_t shaderID;
+            friend class ShaderBatch;
+
+            uint32_t shaderID = 0;
+
+            /// Shader objects of a submitted build, which is not
+            /// finished yet. Empty when the program was loaded
+            /// from the binary cache.
+            std::vector<GLuint> stageIDs;
+
+            /// Key of the program in the binary cache
+            uint64_t binaryKey = 0;
+
+            /// Uniform locations, indexed by `UniformName` ID.
+            /// Filled after linking from the program's active
+            /// uniforms.
+            std::vector<GLint> locations;
+
+            /// Query the active uniforms of the linked program
+            /// and fill the location table.
+            void cache_locations();
+
+            /// Key of the program in the binary cache: hash of
+            /// the sources and of the driver identification
+            /// strings.
+            static uint64_t binary_key(const std::unordered_map<GLenum, std::string>& shaderSources);
+
+            /// Create the program from its cached binary.
+            /// Returns false if there is no cached binary or if
+            /// the driver rejects it.
+            bool load_binary(uint64_t key);
+
+            /// Save the binary of the linked program.
+            void save_binary(uint64_t key) const;
 
             /// Reads the file in `filepath` and returns the
             /// result
@@ -67,5 +142,61 @@ namespace minigl
             /// Compiles the sources from the preprocessing
             /// stage
             void compile(const std::unordered_map<GLenum, std::string>& shaderSources);
+
+            /// Start compiling and linking the sources, without
+            /// waiting for the driver.
+            void submit(const std::unordered_map<GLenum, std::string>& shaderSources);
+
+            /// Whether the driver is done with the submitted
+            /// build. Always true without
+            /// KHR_parallel_shader_compile.
+            bool completed() const;
+
+            /// Check the status of the submitted build, and
+            /// assert on compilation or link errors.
+            void finish();
+    };
+
+    /// Builds several shaders at once. All the programs are
+    /// submitted to the driver before any status is queried,
+    /// so that they compile concurrently on the driver threads
+    /// when KHR_parallel_shader_compile is supported. Without
+    /// it, this is no slower than building them one by one.
+    ///
+    /// The shaders returned by `add()` can be used once
+    /// `build()` returns, or once `poll()` returns true.
+    class ShaderBatch
+    {
+        public:
+
+            /// Queue the GLSL file at `filepath`
+            Ref<Shader> add(const std::string& filepath);
+
+            /// Queue a vertex and fragment source
+            Ref<Shader> add(const std::string& vertexSrc,
+                            const std::string& fragmentSrc);
+
+            /// Submit the queued shaders to the driver
+            void submit();
+
+            /// Submit the queued shaders, and finish the ones
+            /// the driver is done with. Returns true when all
+            /// the shaders are built.
+            bool poll();
+
+            /// Build all the queued shaders and wait for them
+            void build();
+
+        private:
+
+            struct Entry
+            {
+                Ref<Shader> shader;
+                std::unordered_map<GLenum, std::string> sources;
+                std::string path;
+            };
+
+            std::vector<Entry> queued;
+            std::vector<Entry> pending;
     };
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "sync.hpp"
+
+#include <thread>
+
+namespace minigl
+{
+    //----------- FENCE -----------//
+
+    Fence::~Fence()
+    {
+        clear();
+    }
+
+    Fence::Fence(Fence&& other) noexcept: fence(other.fence)
+    {
+        other.fence = nullptr;
+    }
+
+    Fence& Fence::operator=(Fence&& other) noexcept
+    {
+        if (this != &other) {
+            clear();
+            fence = other.fence;
+            other.fence = nullptr;
+        }
+
+        return *this;
+    }
+
+    void Fence::reset()
+    {
+        clear();
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void Fence::clear()
+    {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    bool Fence::is_signaled() const
+    {
+        if (!fence)
+            return true;
+
+        GLint status = GL_UNSIGNALED;
+        glGetSynciv(fence, GL_SYNC_STATUS, 1, nullptr, &status);
+        return status == GL_SIGNALED;
+    }
+
+    bool Fence::wait(std::chrono::nanoseconds timeout)
+    {
+        using clock = std::chrono::steady_clock;
+
+        if (!fence)
+            return true;
+
+        // Check once, flushing the command queue so that the
+        // fence is guaranteed to be signaled eventually.
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+            return true;
+        if (result == GL_WAIT_FAILED)
+            return false;
+
+        auto start = clock::now();
+        auto deadline = timeout >= clock::time_point::max() - start ? clock::time_point::max() : start + timeout;
+
+        // Spin for a few microseconds, then back off with
+        // sleeps doubling up to 1 ms.
+        constexpr auto spin_time = std::chrono::microseconds(50);
+        constexpr auto max_sleep = std::chrono::microseconds(1000);
+        auto sleep = std::chrono::microseconds(10);
+
+        while (true) {
+            result = glClientWaitSync(fence, 0, 0);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+                return true;
+            if (result == GL_WAIT_FAILED)
+                return false;
+
+            auto now = clock::now();
+            if (now >= deadline)
+                return false;
+
+            if (now - start < spin_time) {
+                std::this_thread::yield();
+            }
+            else {
+                std::this_thread::sleep_for(std::min<clock::duration>(sleep, deadline - now));
+                sleep = std::min(sleep * 2, max_sleep);
+            }
+        }
+    }
+
+    //----------- FRAME SYNC -----------//
+
+    FrameSync::FrameSync(uint32_t frames_in_flight):
+        fences(std::max<uint32_t>(frames_in_flight, 1))
+    {}
+
+    uint32_t FrameSync::begin_frame()
+    {
+        slot = frameNumber % fences.size();
+        frameNumber++;
+
+        fences[slot].wait();
+        fences[slot].clear();
+
+        return slot;
+    }
+
+    void FrameSync::end_frame()
+    {
+        fences[slot].reset();
+    }
+}
\ No newline at end of file
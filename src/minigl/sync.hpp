@@ -0,0 +1,101 @@
+#pragma once
+
+#include "mglpch.hpp"
+
+#include <chrono>
+#include <glad/glad.h>
+
+namespace minigl
+{
+    /// GPU fence: a sync object inserted in the command
+    /// stream, which becomes signaled once the GPU has
+    /// executed all the commands issued before it. The fence
+    /// owns its sync object, which is deleted when the fence is
+    /// reset or destroyed.
+    class Fence
+    {
+        public:
+
+            Fence() = default;
+
+            /// Destructor: deletes the sync object, if any.
+            ~Fence();
+
+            Fence(const Fence&) = delete;
+            Fence& operator=(const Fence&) = delete;
+
+            Fence(Fence&& other) noexcept;
+            Fence& operator=(Fence&& other) noexcept;
+
+            /// Insert a new fence in the command stream,
+            /// replacing the previous one.
+            void reset();
+
+            /// Delete the sync object. An empty fence is
+            /// always considered signaled.
+            void clear();
+
+            /// Check whether the fence is signaled, without
+            /// blocking. The command queue has to be flushed
+            /// for the fence to ever be signaled (swapping
+            /// buffers or calling `wait()` does it).
+            bool is_signaled() const;
+
+            /// Wait for the fence to be signaled, for at most
+            /// `timeout`. The commands are flushed, then the
+            /// fence is polled in a short spin loop (for fences
+            /// about to be signaled), then with increasing
+            /// sleeps to leave the CPU to other threads.
+            ///
+            /// @return True if the fence is signaled, false if
+            ///     the wait timed out or failed.
+            bool wait(std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max());
+
+            /// True if the fence holds a sync object.
+            bool valid() const { return fence != nullptr; }
+
+        private:
+
+            GLsync fence = nullptr;
+    };
+
+    /// Frames-in-flight manager: lets the CPU record up to
+    /// `frames_in_flight` frames ahead of the GPU. Each frame in
+    /// flight has a slot (`frame_index()`) that can be used to
+    /// index per-frame resources, such as the regions of a
+    /// persistently mapped buffer; `begin_frame()` only returns
+    /// once the GPU is done with the frame that last used the
+    /// slot, so its resources can be safely overwritten.
+    class FrameSync
+    {
+        public:
+
+            explicit FrameSync(uint32_t frames_in_flight = 2);
+
+            /// Move to the next slot and wait for the GPU to
+            /// be done with the frame that last used it.
+            ///
+            /// @return The slot of the new frame.
+            uint32_t begin_frame();
+
+            /// Fence the commands of the current frame. Call
+            /// after the last command reading the resources of
+            /// the frame's slot.
+            void end_frame();
+
+            /// Slot of the current frame, in `[0,
+            /// frames_in_flight)`.
+            uint32_t frame_index() const { return slot; }
+
+            uint32_t frames_in_flight() const { return fences.size(); }
+
+            /// Number of frames begun so far.
+            uint64_t frame_number() const { return frameNumber; }
+
+        private:
+
+            std::vector<Fence> fences;
+            uint32_t slot = 0;
+            uint64_t frameNumber = 0;
+    };
+}
\ No newline at end of file
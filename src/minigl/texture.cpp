@@ -1,42 +1,98 @@
 #include "texture.hpp"
+#include "texture_loader.hpp"
+#include "render_state.hpp"
 
 #include "core.hpp"
 #include <glad/glad.h>
-#include <stb_image.h>
 
 namespace minigl
 {
-    Texture::Texture(int width, int height, TextureFormat format):
-        width(width), height(height), format(format)
+    uint32_t Texture::mip_count(int width, int height)
+    {
+        uint32_t count = 1;
+        for (int size = std::max(width, height); size > 1; size /= 2)
+            count++;
+
+        return count;
+    }
+
+    Texture::Texture(int width, int height, TextureFormat format, uint32_t levels):
+        width(width), height(height), levels(levels == 0 ? mip_count(width, height) : levels), format(format)
     {
         // Create a 2D texture handle with the retrieved ID.
         glCreateTextures(GL_TEXTURE_2D, 1, &id);
 
         // Allocate storage for width x height pixels in the
-        // given format and with 1 mip level.
-        glTextureStorage2D(id, 1, (GLenum)format, width, height);
+        // given format and with the requested mip levels.
+        glTextureStorage2D(id, this->levels, (GLenum)format, width, height);
 
         // Set the min and mag filters to linear (perform
         // linear interpolation when the texels are smaller or
         // larger than the screen pixels).
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        set_filtering(TextureFiltering::Trilinear);
 
         // Set the wrap mode to repeat (repeat the texture when
         // the texture coordinates are outside the [0, 1]
         // range).
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_REPEAT);
     }
 
-    Texture::Texture(const std::string& path)
+    Texture::Texture(int width, int height, int layers, TextureFormat format, uint32_t levels):
+        width(width), height(height), levels(levels == 0 ? mip_count(width, height) : levels),
+        target(GL_TEXTURE_2D_ARRAY), layers(layers), format(format)
     {
-        // Load the texture with stbi. The coordinates are
-        // flipped because OpenGL expects the origin to be at
-        // the bottom left corner.
-        int channels;
-        stbi_set_flip_vertically_on_load(1);
-        stbi_uc* data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+        // Layers share the size, format and mip levels of the
+        // texture, and are never filtered with each other.
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &id);
+        glTextureStorage3D(id, this->levels, (GLenum)format, width, height, layers);
+
+        set_filtering(TextureFiltering::Trilinear);
+        glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    }
+
+    /// Load a block compressed image (see `CompressedImage`)
+    /// into `texture`, with the mip levels of the file.
+    static void load_compressed(Texture& texture, const CompressedImage& image, const std::string& path, const TextureOptions& options)
+    {
+        texture.width = image.width;
+        texture.height = image.height;
+        texture.levels = image.levels.size();
+
+        // Compressed levels cannot be generated by the driver:
+        // the mip chain is the one of the file.
+        GLenum internalFormat = compressed_gl_format(image.format, image.srgb || options.srgb);
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture.id);
+        glTextureStorage2D(texture.id, texture.levels, internalFormat, texture.width, texture.height);
+        texture.set_filtering(options.filtering, options.anisotropy);
+
+        for (uint32_t level = 0; level < texture.levels; level++) {
+            auto& mip = image.levels[level];
+            glCompressedTextureSubImage2D(texture.id, level, 0, 0, mip.width, mip.height, internalFormat, mip.size, mip.data);
+        }
+
+        trace("Created compressed texture from '{}' ({} levels)", path, texture.levels);
+    }
+
+    Texture::Texture(const std::string& path, const TextureOptions& options):
+        Texture(TextureData(path, options), options)
+    {
+    }
+
+    Texture::Texture(const TextureData& image, const TextureOptions& options)
+    {
+        auto& path = image.path;
+        if (image.compressed) {
+            load_compressed(*this, *image.compressed, path, options);
+            return;
+        }
+
+        width = image.width;
+        height = image.height;
+        int channels = image.channels;
+        const uint8_t* data = image.pixels.get();
 
         // - Data format: format of the pixel data.
         // - Internal format: format used by OpenGL to store
@@ -45,12 +101,12 @@ namespace minigl
         if(channels == 3)
         {
             dataFormat = GL_RGB;
-            internalFormat = GL_RGB8;
+            internalFormat = options.srgb ? GL_SRGB8 : GL_RGB8;
         }
         else if(channels == 4)
         {
             dataFormat = GL_RGBA;
-            internalFormat = GL_RGBA8;
+            internalFormat = options.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
         }
         MGL_ASSERT(internalFormat & dataFormat, "Texture at path '{}': format not supported or texture not found.", path);
 
@@ -59,30 +115,106 @@ namespace minigl
         // Generate and bind the texture to OpenGL.
         glCreateTextures(GL_TEXTURE_2D, 1, &id);
         
-        // Tell how many mipmaps levels there are, the internal
+        // Tell how many mipmaps levels there are (the full
+        // chain down to 1x1, unless disabled), the internal
         // format of the texture (that is, how it shall be
         // stored in GPU), its width and its height.
-        glTextureStorage2D(id, 1, internalFormat, width, height);
+        levels = options.mipmaps == MipmapGeneration::None ? 1 : mip_count(width, height);
+        glTextureStorage2D(id, levels, internalFormat, width, height);
 
         // Magnification and minification filter, that is,
         // which algorithms are used to make our texture bigger
         // or smaller.
-        glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        set_filtering(options.filtering, options.anisotropy);
 
         // Specify the texture sub-image that will be used: the
         // pixel data, its format (memory layout), and a type.
         // The pixel data will be converted from 'dataformat'
         // to 'internalformat' in order to be used by OpenGL.
         glTextureSubImage2D(id, 0, 0, 0, width, height, dataFormat, GL_UNSIGNED_BYTE, data);
-        stbi_image_free(data);
+
+        switch (options.mipmaps)
+        {
+            case MipmapGeneration::None:
+                break;
+
+            case MipmapGeneration::GPU:
+                generate_mipmaps();
+                break;
+
+            case MipmapGeneration::CPUBox:
+            case MipmapGeneration::CPUKaiser: {
+                // Generated when decoding, unless the image was
+                // decoded without them: fall back to the GPU.
+                if (image.mips.size() != levels - 1) {
+                    warn("Texture at path '{}': decoded without CPU mip levels, generating them on the GPU.", path);
+                    generate_mipmaps();
+                    break;
+                }
+
+                for (uint32_t level = 1; level < levels; level++) {
+                    auto& mip = image.mips[level - 1];
+                    glTextureSubImage2D(id, level, 0, 0, mip.width, mip.height, dataFormat, GL_UNSIGNED_BYTE, mip.pixels.data());
+                }
+                break;
+            }
+        }
 
         trace("Created texture from image at path '{}'", path);
     }
 
     void Texture::bind(uint32_t unit) const
     {
-        glBindTextureUnit(unit, id);
+        RenderState::bind_texture_unit(unit, id);
+    }
+
+    void Texture::upload_layer(int layer, int x, int y, int width, int height, GLenum data_format, const void* pixels, uint32_t level)
+    {
+        MGL_ASSERT(layer < layers, "Texture layer {} out of range ({} layers).", layer, layers);
+
+        if (target == GL_TEXTURE_2D_ARRAY)
+            glTextureSubImage3D(id, level, x, y, layer, width, height, 1, data_format, GL_UNSIGNED_BYTE, pixels);
+        else
+            glTextureSubImage2D(id, level, x, y, width, height, data_format, GL_UNSIGNED_BYTE, pixels);
+    }
+
+    void Texture::generate_mipmaps()
+    {
+        // sRGB textures are filtered in linear space.
+        if (levels > 1)
+            glGenerateTextureMipmap(id);
+    }
+
+    void Texture::set_filtering(TextureFiltering filtering, float anisotropy)
+    {
+        // Without mip levels, trilinear filtering falls back
+        // to bilinear.
+        GLenum min_filter = GL_LINEAR, mag_filter = GL_LINEAR;
+        switch (filtering)
+        {
+            case TextureFiltering::Nearest:
+                min_filter = levels > 1 ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST;
+                mag_filter = GL_NEAREST;
+                break;
+            case TextureFiltering::Bilinear:
+                min_filter = levels > 1 ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR;
+                break;
+            case TextureFiltering::Trilinear:
+                min_filter = levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+                break;
+        }
+
+        glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, min_filter);
+        glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, mag_filter);
+
+        // Anisotropic filtering is core since OpenGL 4.6
+        static float max_anisotropy = [] {
+            float value = 1.f;
+            glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &value);
+            return value;
+        }();
+
+        glTextureParameterf(id, GL_TEXTURE_MAX_ANISOTROPY, std::clamp(anisotropy, 1.f, max_anisotropy));
     }
 
     void Texture::bind_image(uint32_t unit, ImageAccess access) const
@@ -90,6 +222,8 @@ namespace minigl
         // The format could actually be different from the
         // texture format, as long as it is compatible (see
         // https://docs.gl/gl4/glBindImageTexture#description).
-        glBindImageTexture(unit, id, 0, GL_FALSE, 0, (GLenum)access, (GLenum)format);
+        // Array textures are bound whole (layered).
+        GLboolean layered = target == GL_TEXTURE_2D_ARRAY ? GL_TRUE : GL_FALSE;
+        glBindImageTexture(unit, id, 0, layered, 0, (GLenum)access, (GLenum)format);
     }
 }
\ No newline at end of file
@@ -9,6 +9,10 @@ namespace minigl
     {
         /// 8-bit 3-channel color.
         COLOR_RGB = GL_RGB8,
+        /// 8-bit 4-channel color.
+        COLOR_RGBA8 = GL_RGBA8,
+        /// 8-bit 4-channel sRGB color, with linear alpha.
+        COLOR_SRGB_ALPHA = GL_SRGB8_ALPHA8,
         /// 32-bit floating point 4-channel color.
         COLOR_RGBA = GL_RGBA32F,
         /// 32-bit floating point depth.
@@ -24,15 +28,81 @@ namespace minigl
         READ_WRITE = GL_READ_WRITE,
     };
 
+    /// How texels are interpolated when sampling
+    enum class TextureFiltering
+    {
+        /// Nearest texel of the nearest mip level
+        Nearest,
+        /// Linear interpolation within the nearest mip level
+        Bilinear,
+        /// Linear interpolation within and between the two
+        /// nearest mip levels
+        Trilinear,
+    };
+
+    /// How the mip levels of a texture are generated
+    enum class MipmapGeneration
+    {
+        /// Single level, no mipmaps
+        None,
+        /// `glGenerateTextureMipmap()`: fast, quality depends
+        /// on the driver (usually a box filter)
+        GPU,
+        /// Downsampled on the CPU with a box filter, on all
+        /// cores (see `generate_mipmaps()`)
+        CPUBox,
+        /// Downsampled on the CPU with a Kaiser windowed sinc,
+        /// sharper than the box filter
+        CPUKaiser,
+    };
+
+    /// Options of textures loaded from images
+    struct TextureOptions
+    {
+        MipmapGeneration mipmaps = MipmapGeneration::GPU;
+
+        /// The image is sRGB encoded color (as opposed to
+        /// linear data such as normal maps): it is stored in
+        /// an sRGB format, so that it is filtered and sampled
+        /// in linear space. Shaders then write linear colors,
+        /// which need an sRGB framebuffer or a conversion.
+        bool srgb = false;
+
+        TextureFiltering filtering = TextureFiltering::Trilinear;
+
+        /// Maximum anisotropy of the filtering, clamped to the
+        /// limit of the driver; 1 disables anisotropic
+        /// filtering.
+        float anisotropy = 8.f;
+    };
+
+    struct TextureData;
+
     struct Texture
     {
         /// Create a blank texture of specified width and
-        /// height.
-        Texture(int width, int height, TextureFormat type);
+        /// height, with `levels` mip levels (0 for the full
+        /// chain).
+        Texture(int width, int height, TextureFormat type, uint32_t levels = 1);
+
+        /// Create a blank array texture (`GL_TEXTURE_2D_ARRAY`)
+        /// of `layers` layers of width x height, with `levels`
+        /// mip levels (0 for the full chain). Shaders sample it
+        /// with a `sampler2DArray`, the layer being the third
+        /// texture coordinate, so that draws using different
+        /// images can share a single binding.
+        Texture(int width, int height, int layers, TextureFormat type, uint32_t levels = 1);
         
         /// Create a texture from the image at the
-        /// specified path.
-        Texture(const std::string& path);
+        /// specified path. Block compressed images (.dds and
+        /// .ktx2 files, see `CompressedImage`) are uploaded
+        /// as is, with the mip levels they contain.
+        Texture(const std::string& path, const TextureOptions& options = {});
+
+        /// Create a texture from an image decoded beforehand,
+        /// possibly on another thread (see `load_textures()`
+        /// to load many images at once).
+        Texture(const TextureData& data, const TextureOptions& options = {});
 
         void bind(uint32_t unit) const;
 
@@ -40,8 +110,31 @@ namespace minigl
         /// shader.
         void bind_image(uint32_t unit, ImageAccess access) const;
 
+        /// Upload 8-bit pixels of format `data_format` (e.g.
+        /// `GL_RGBA`) to a region of a layer (which must be 0
+        /// for regular textures) at a mip level.
+        void upload_layer(int layer, int x, int y, int width, int height, GLenum data_format, const void* pixels, uint32_t level = 0);
+
+        /// Fill the mip levels below the first one from it, on
+        /// the GPU.
+        void generate_mipmaps();
+
+        /// Set the filtering used to sample the texture, and
+        /// its maximum anisotropy.
+        void set_filtering(TextureFiltering filtering, float anisotropy = 1.f);
+
+        /// Number of levels of the full mip chain of a
+        /// `width` x `height` texture
+        static uint32_t mip_count(int width, int height);
+
         GLuint id;
         int width, height;
+        uint32_t levels = 1;
+
+        /// `GL_TEXTURE_2D`, or `GL_TEXTURE_2D_ARRAY` for array
+        /// textures
+        GLenum target = GL_TEXTURE_2D;
+        int layers = 1;
         TextureFormat format;
     };
 }
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "texture_loader.hpp"
+#include "thread_pool.hpp"
+
+#include <stb_image.h>
+
+namespace minigl
+{
+    TextureData::TextureData(const std::string& path, const TextureOptions& options):
+        path(path)
+    {
+        if (CompressedImage::is_container(path)) {
+            compressed = ref<CompressedImage>(path);
+            MGL_ASSERT(compressed->valid(), "Texture at path '{}': compressed format not supported or texture not found.", path);
+
+            width = compressed->width;
+            height = compressed->height;
+            return;
+        }
+
+        // The coordinates are flipped because OpenGL expects
+        // the origin to be at the bottom left corner. The flag
+        // is set for the calling thread only, unlike
+        // `stbi_set_flip_vertically_on_load()`, so images can
+        // be decoded concurrently.
+        stbi_set_flip_vertically_on_load_thread(1);
+        stbi_uc* data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+        MGL_ASSERT(data && (channels == 3 || channels == 4), "Texture at path '{}': format not supported or texture not found.", path);
+
+        pixels = Ref<uint8_t>(data, stbi_image_free);
+
+        if (options.mipmaps == MipmapGeneration::CPUBox || options.mipmaps == MipmapGeneration::CPUKaiser)
+            mips = generate_mipmaps(data, width, height, channels, options.srgb, options.mipmaps);
+    }
+
+    std::vector<Ref<Texture>> load_textures(const std::vector<std::string>& paths, const TextureOptions& options)
+    {
+        std::vector<Box<TextureData>> images(paths.size());
+        parallel_for(paths.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                images[i] = box<TextureData>(paths[i], options);
+        });
+
+        std::vector<Ref<Texture>> textures {};
+        textures.reserve(paths.size());
+
+        for (auto& image: images) {
+            textures.push_back(ref<Texture>(*image, options));
+
+            // Free the pixels as soon as they are on the GPU
+            image.reset();
+        }
+
+        trace("Loaded {} textures", textures.size());
+        return textures;
+    }
+}
\ No newline at end of file
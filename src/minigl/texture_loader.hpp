@@ -0,0 +1,40 @@
+#pragma once
+
+#include "core.hpp"
+#include "texture.hpp"
+#include "mipmap.hpp"
+#include "compressed_texture.hpp"
+
+namespace minigl
+{
+    /// Image decoded on the CPU, ready to be uploaded to a
+    /// `Texture`. Decoding does not touch OpenGL, so it can
+    /// run on any thread.
+    struct TextureData
+    {
+        /// Decode the image at `path`, and generate its mip
+        /// levels if `options` asks for CPU mipmaps. Block
+        /// compressed containers (.dds, .ktx2) are mapped, not
+        /// decoded.
+        TextureData(const std::string& path, const TextureOptions& options = {});
+
+        std::string path;
+        int width = 0, height = 0, channels = 0;
+
+        /// Decoded pixels (freed with stbi)
+        Ref<uint8_t> pixels;
+
+        /// CPU generated mip levels, below the first one
+        std::vector<MipLevel> mips;
+
+        /// Compressed image, for containers
+        Ref<CompressedImage> compressed;
+    };
+
+    /// Load the images at `paths` into textures. The images
+    /// are decoded in parallel on the global thread pool, then
+    /// uploaded in a single pass on the calling thread, which
+    /// must be the GL thread. The textures are returned in the
+    /// order of `paths`.
+    std::vector<Ref<Texture>> load_textures(const std::vector<std::string>& paths, const TextureOptions& options = {});
+}
\ No newline at end of file
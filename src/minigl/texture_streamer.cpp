@@ -0,0 +1,304 @@
+#include "texture_streamer.hpp"
+#include "thread_pool.hpp"
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+namespace minigl
+{
+    /// Alignment of the staging allocations, enough for any
+    /// pixel or block size
+    static constexpr size_t STAGING_ALIGNMENT = 16;
+
+    /// Size of a row of pixels of a level, or of a row of 4x4
+    /// blocks for compressed textures
+    static size_t level_row_size(const CompressedLevel& level, bool compressed)
+    {
+        int block = compressed ? 4 : 1;
+        return level.size / ((level.height + block - 1) / block);
+    }
+
+    TextureStreamer::Job::~Job()
+    {
+        if (pixels)
+            stbi_image_free(pixels);
+    }
+
+    TextureStreamer::TextureStreamer(size_t staging_size):
+        stagingSize((staging_size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT)
+    {
+    }
+
+    TextureStreamer::~TextureStreamer()
+    {
+        for (auto& job: jobs) {
+            if (job->decoded.valid())
+                job->decoded.wait();
+        }
+
+        if (bufferID) {
+            glUnmapNamedBuffer(bufferID);
+            glDeleteBuffers(1, &bufferID);
+        }
+    }
+
+    Ref<TextureHandle> TextureStreamer::load(const std::string& path, const TextureOptions& options)
+    {
+        if (!bufferID) {
+            // Coherent mapping: the rows copied into the
+            // buffer are visible to the GPU without explicit
+            // flushes.
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+            glCreateBuffers(1, &bufferID);
+            glNamedBufferStorage(bufferID, stagingSize, nullptr, flags);
+            mapped = (uint8_t*)glMapNamedBufferRange(bufferID, 0, stagingSize, flags);
+        }
+
+        if (!placeholder) {
+            const uint8_t grey[3] = {128, 128, 128};
+            placeholder = ref<Texture>(1, 1, TextureFormat::COLOR_RGB);
+            glTextureSubImage2D(placeholder->id, 0, 0, 0, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, grey);
+        }
+
+        auto job = box<Job>();
+        job->handle = ref<TextureHandle>();
+        job->handle->source = path;
+        job->handle->placeholder = placeholder;
+        job->options = options;
+
+        // The job is heap-allocated, so the worker can keep a
+        // pointer to it while the queue changes.
+        job->decoded = ThreadPool::global().submit([job = job.get(), path]() {
+            auto& options = job->options;
+
+            if (CompressedImage::is_container(path)) {
+                job->compressed = box<CompressedImage>(path);
+                if (!job->compressed->valid()) {
+                    job->failed = true;
+                    return;
+                }
+
+                job->levels = job->compressed->levels;
+                return;
+            }
+
+            // Always decoded to RGBA: 4-byte pixels keep every
+            // row aligned in the staging buffer. The flip is
+            // set for this thread only (see `Texture`).
+            int width, height, channels;
+            stbi_set_flip_vertically_on_load_thread(1);
+            job->pixels = stbi_load(path.c_str(), &width, &height, &channels, 4);
+            if (!job->pixels) {
+                job->failed = true;
+                return;
+            }
+
+            job->levels.push_back({width, height, job->pixels, (size_t)width * height * 4});
+
+            if (options.mipmaps == MipmapGeneration::CPUBox || options.mipmaps == MipmapGeneration::CPUKaiser) {
+                job->mips = generate_mipmaps(job->pixels, width, height, 4, options.srgb, options.mipmaps);
+                for (auto& mip: job->mips)
+                    job->levels.push_back({mip.width, mip.height, mip.pixels.data(), mip.pixels.size()});
+            }
+        });
+
+        auto handle = job->handle;
+        jobs.push_back(std::move(job));
+
+        return handle;
+    }
+
+    bool TextureStreamer::allocate(size_t size, size_t& offset)
+    {
+        size = (size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+        if (used == 0)
+            head = tail = 0;
+
+        // Free space right after the head: up to the end of
+        // the buffer, or up to the tail once wrapped around.
+        bool wrapped = used > 0 && head <= tail;
+        size_t contiguous = wrapped ? tail - head : stagingSize - head;
+
+        if (size <= contiguous) {
+            offset = head;
+        }
+        else if (!wrapped && size <= tail) {
+            // Skip the end of the buffer; it is freed with
+            // the region that skipped it.
+            used += stagingSize - head;
+            frameBytes += stagingSize - head;
+            offset = 0;
+        }
+        else {
+            return false;
+        }
+
+        head = offset + size;
+        used += size;
+        frameBytes += size;
+        return true;
+    }
+
+    void TextureStreamer::reclaim()
+    {
+        while (!regions.empty() && regions.front().fence.is_signaled()) {
+            tail = regions.front().end;
+            used -= regions.front().size;
+            regions.pop_front();
+        }
+    }
+
+    size_t TextureStreamer::upload_job(Job& job, size_t budget)
+    {
+        // Allocate the whole storage up front, then fill it
+        // row by row over the next frames.
+        if (!job.texture) {
+            auto& base = job.levels[0];
+            auto& options = job.options;
+            uint32_t levels = job.levels.size();
+
+            if (job.compressed) {
+                job.format = compressed_gl_format(job.compressed->format, job.compressed->srgb || options.srgb);
+            }
+            else {
+                job.format = options.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+                if (options.mipmaps == MipmapGeneration::GPU)
+                    levels = Texture::mip_count(base.width, base.height);
+            }
+
+            // `TextureFormat` holds the GL internal format.
+            job.texture = ref<Texture>(base.width, base.height, (TextureFormat)job.format, levels);
+            job.texture->set_filtering(options.filtering, options.anisotropy);
+        }
+
+        size_t sent = 0;
+        while (job.level < job.levels.size()) {
+            auto& level = job.levels[job.level];
+
+            // Uploads are made of whole rows of pixels, or of
+            // 4x4 blocks for compressed textures.
+            int block = job.compressed ? 4 : 1;
+            int rows = (level.height + block - 1) / block;
+            size_t row_size = level_row_size(level, job.compressed != nullptr);
+
+            // At least one row per frame, even if it exceeds
+            // the budget, so that streaming always progresses.
+            size_t count = std::min<size_t>(rows - job.row, (sent < budget ? budget - sent : 0) / row_size);
+            if (count == 0 && frameBytes == 0)
+                count = 1;
+
+            size_t offset = 0;
+            while (count > 0 && !allocate(count * row_size, offset))
+                count /= 2;
+            if (count == 0)
+                break;
+
+            size_t size = count * row_size;
+            std::memcpy(mapped + offset, level.data + job.row * row_size, size);
+
+            // With a pixel unpack buffer bound, the data
+            // pointer is an offset into the buffer.
+            int y = job.row * block;
+            int height = std::min<int>(count * block, level.height - y);
+            if (job.compressed)
+                glCompressedTextureSubImage2D(job.texture->id, job.level, 0, y, level.width, height, job.format, size, (const void*)offset);
+            else
+                glTextureSubImage2D(job.texture->id, job.level, 0, y, level.width, height, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)offset);
+
+            sent += size;
+            job.row += count;
+            if (job.row == rows) {
+                job.row = 0;
+                job.level++;
+            }
+        }
+
+        return sent;
+    }
+
+    void TextureStreamer::upload(size_t budget)
+    {
+        reclaim();
+        if (jobs.empty())
+            return;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, bufferID);
+
+        for (auto it = jobs.begin(); it != jobs.end(); ) {
+            auto& job = **it;
+
+            // Images still being decoded are skipped, so that
+            // a large file does not hold back the others.
+            if (job.decoded.valid()) {
+                if (job.decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    it++;
+                    continue;
+                }
+
+                // Rethrow the exception of the worker, if any,
+                // on this thread, without the failed job.
+                try {
+                    job.decoded.get();
+                }
+                catch (...) {
+                    jobs.erase(it);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                    throw;
+                }
+            }
+
+            // Failed jobs are dropped: their handle keeps the
+            // placeholder.
+            if (job.failed) {
+                error("Texture at path '{}': format not supported or texture not found.", job.handle->source);
+                it = jobs.erase(it);
+                continue;
+            }
+
+            // A row that does not fit in the staging buffer
+            // could never be allocated, and would stall the
+            // queue.
+            if (!job.texture) {
+                size_t largest = 0;
+                for (auto& level: job.levels)
+                    largest = std::max(largest, level_row_size(level, job.compressed != nullptr));
+
+                if (largest > stagingSize) {
+                    error("Texture '{}': rows of {} bytes do not fit in the {} bytes staging buffer.", job.handle->source, largest, stagingSize);
+                    it = jobs.erase(it);
+                    continue;
+                }
+            }
+
+            size_t sent = upload_job(job, budget);
+            budget -= std::min(sent, budget);
+
+            if (job.level < job.levels.size()) {
+                // Out of budget or out of staging space: the
+                // other jobs would not get further.
+                break;
+            }
+
+            if (job.options.mipmaps == MipmapGeneration::GPU && !job.compressed)
+                job.texture->generate_mipmaps();
+
+            job.handle->texture = job.texture;
+            trace("Streamed texture '{}' ({} levels)", job.handle->source, job.texture->levels);
+
+            // Frees the decoded pixels, or unmaps the file.
+            it = jobs.erase(it);
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        // Fence the staging bytes written this frame: they
+        // are reused once the GPU has read them.
+        if (frameBytes > 0) {
+            Region region {head, frameBytes, {}};
+            region.fence.reset();
+            regions.push_back(std::move(region));
+            frameBytes = 0;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "core.hpp"
+#include "texture.hpp"
+#include "mipmap.hpp"
+#include "compressed_texture.hpp"
+#include "sync.hpp"
+
+#include <future>
+#include <deque>
+
+namespace minigl
+{
+    /// Handle to a texture streamed by a `TextureStreamer`.
+    /// Until the image is decoded and completely uploaded,
+    /// `get()` returns the placeholder texture of the
+    /// streamer, so the handle can be bound right away.
+    class TextureHandle
+    {
+        public:
+
+            bool ready() const { return texture != nullptr; }
+
+            /// The streamed texture, or the placeholder if it
+            /// is not ready yet.
+            const Ref<Texture>& get() const { return texture ? texture : placeholder; }
+
+            const std::string& path() const { return source; }
+
+        private:
+
+            friend class TextureStreamer;
+
+            Ref<Texture> texture;
+            Ref<Texture> placeholder;
+            std::string source;
+    };
+
+    /// Asynchronous texture loader. Images are decoded (and
+    /// their mip levels generated on the CPU, if requested) on
+    /// the global thread pool. `upload()` then copies the
+    /// pixels into a persistently mapped pixel unpack buffer
+    /// and issues `glTextureSubImage2D` from it, a bounded
+    /// number of bytes per frame. Each frame's region of the
+    /// staging buffer is fenced and only reused once the GPU
+    /// has read it, so the GL thread never waits for a decode
+    /// or a transfer: when the staging buffer is full, uploads
+    /// resume on a later frame.
+    class TextureStreamer
+    {
+        public:
+
+            /// Create a streamer with a staging buffer of
+            /// `staging_size` bytes. The buffer and the default
+            /// placeholder are created on the first `load()`.
+            explicit TextureStreamer(size_t staging_size = 16 << 20);
+
+            /// Destructor: waits for the images being decoded,
+            /// since the workers write into the streamer's
+            /// jobs, and deletes the staging buffer.
+            ~TextureStreamer();
+
+            TextureStreamer(const TextureStreamer&) = delete;
+            TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+            /// Queue the image at `path` for streaming, and
+            /// return a handle to the future texture. Block
+            /// compressed containers (.dds, .ktx2) are streamed
+            /// as is.
+            Ref<TextureHandle> load(const std::string& path, const TextureOptions& options = {});
+
+            /// Upload the images that finished decoding, in the
+            /// order they were queued, sending at most `budget`
+            /// bytes to the GPU. Must be called on the GL thread
+            /// (`App::run()` calls it once per frame). An
+            /// exception thrown while decoding an image is
+            /// rethrown here, and its texture is dropped.
+            /// Images that fail to decode, or whose rows do not
+            /// fit in the staging buffer, are dropped with an
+            /// error: their handle keeps the placeholder.
+            void upload(size_t budget);
+
+            /// Texture returned by the handles until their
+            /// texture is ready (a 1x1 grey texture by default)
+            void set_placeholder(const Ref<Texture>& texture) { placeholder = texture; }
+
+            /// Number of textures not ready yet.
+            size_t pending() const { return jobs.size(); }
+
+        private:
+
+            struct Job
+            {
+                Ref<TextureHandle> handle;
+                TextureOptions options;
+                std::future<void> decoded;
+
+                // CPU data, filled by the worker thread: the
+                // levels point either to the decoded pixels
+                // and CPU mip levels, or to the mapped
+                // compressed file.
+                uint8_t* pixels = nullptr;
+                std::vector<MipLevel> mips;
+                Box<CompressedImage> compressed;
+                std::vector<CompressedLevel> levels;
+                bool failed = false;
+
+                // GPU upload state: next level and row (or row
+                // of blocks) to upload
+                Ref<Texture> texture;
+                uint32_t format = 0;
+                uint32_t level = 0;
+                int row = 0;
+
+                ~Job();
+            };
+
+            /// Bytes of the staging buffer written in a frame,
+            /// read by the GPU until `fence` is signaled
+            struct Region
+            {
+                size_t end, size;
+                Fence fence;
+            };
+
+            size_t stagingSize;
+            uint32_t bufferID = 0;
+            uint8_t* mapped = nullptr;
+
+            // The staging buffer is a ring: bytes are written
+            // at `head`, and the oldest region still read by
+            // the GPU starts at `tail`. `used` counts the bytes
+            // in between (including the unused end of the
+            // buffer when an allocation wraps around), and
+            // `frameBytes` those written by the current
+            // `upload()`, not fenced yet.
+            size_t head = 0, tail = 0, used = 0, frameBytes = 0;
+            std::deque<Region> regions;
+
+            Ref<Texture> placeholder;
+            std::deque<Box<Job>> jobs;
+
+            /// Reserve `size` contiguous bytes of the staging
+            /// buffer, or return false if there is not enough
+            /// room until the GPU catches up.
+            bool allocate(size_t size, size_t& offset);
+
+            /// Free the regions that the GPU is done with
+            void reclaim();
+
+            /// Upload at most `budget` bytes of the job data,
+            /// and return the number of bytes sent.
+            size_t upload_job(Job& job, size_t budget);
+    };
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "thread_pool.hpp"
+
+#include <atomic>
+
+namespace minigl
+{
+    ThreadPool::ThreadPool(size_t thread_count)
+    {
+        thread_count = std::max<size_t>(thread_count, 1);
+        threads.reserve(thread_count);
+
+        for (size_t i = 0; i < thread_count; i++)
+            threads.emplace_back([this]() { worker(); });
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard lock {mutex};
+            stopping = true;
+        }
+        cv.notify_all();
+
+        for (auto& thread: threads)
+            thread.join();
+    }
+
+    void ThreadPool::worker()
+    {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock lock {mutex};
+                cv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+                if (stopping && tasks.empty())
+                    return;
+
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+
+            task();
+        }
+    }
+
+    bool ThreadPool::run_pending_task()
+    {
+        std::function<void()> task;
+        {
+            std::lock_guard lock {mutex};
+            if (tasks.empty())
+                return false;
+
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+
+        task();
+        return true;
+    }
+
+    ThreadPool& ThreadPool::global()
+    {
+        static ThreadPool pool {};
+        return pool;
+    }
+
+    void parallel_for(size_t count, const std::function<void(size_t, size_t)>& func, size_t min_chunk)
+    {
+        if (count == 0)
+            return;
+
+        auto& pool = ThreadPool::global();
+
+        // A few chunks per thread, to balance uneven work.
+        size_t chunk_count = std::min((count + min_chunk - 1) / std::max<size_t>(min_chunk, 1), pool.size() * 4);
+        if (chunk_count <= 1) {
+            func(0, count);
+            return;
+        }
+
+        size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+        chunk_count = (count + chunk_size - 1) / chunk_size;
+
+        // The first exception thrown by a chunk is kept and
+        // rethrown once all the chunks are done: they reference
+        // the locals of this function, so it must not return
+        // before them.
+        std::exception_ptr error = nullptr;
+        std::mutex error_mutex;
+        auto run = [&func, &error, &error_mutex](size_t begin, size_t end) {
+            try {
+                func(begin, end);
+            }
+            catch (...) {
+                std::lock_guard lock {error_mutex};
+                if (!error)
+                    error = std::current_exception();
+            }
+        };
+
+        std::atomic<size_t> remaining = chunk_count - 1;
+        for (size_t c = 1; c < chunk_count; c++) {
+            size_t begin = c * chunk_size;
+            size_t end = std::min(begin + chunk_size, count);
+
+            pool.submit([&run, &remaining, begin, end]() {
+                // Counted as done even if the chunk throws
+                struct Done { std::atomic<size_t>& remaining; ~Done() { remaining--; } } done {remaining};
+                run(begin, end);
+            });
+        }
+
+        // Do the first chunk ourselves, then help with the
+        // others until they are all done.
+        run(0, std::min(chunk_size, count));
+        while (remaining > 0) {
+            if (!pool.run_pending_task())
+                std::this_thread::yield();
+        }
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "core.hpp"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <queue>
+
+namespace minigl
+{
+    /// Fixed-size pool of worker threads executing tasks from
+    /// a shared FIFO queue. Tasks must not issue OpenGL calls,
+    /// since the context is only current on the main thread.
+    class ThreadPool
+    {
+        public:
+
+            /// Create a pool of `thread_count` workers (one per
+            /// hardware thread by default).
+            explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency());
+
+            /// Destructor: finishes the queued tasks and joins
+            /// the workers.
+            ~ThreadPool();
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            /// Queue a task for execution on a worker, and
+            /// return a future holding its result.
+            template<typename F>
+            auto submit(F&& task) -> std::future<std::invoke_result_t<F>>
+            {
+                using result_t = std::invoke_result_t<F>;
+
+                // std::function needs a copyable callable, so
+                // the packaged task is shared.
+                auto packaged = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(task));
+                auto future = packaged->get_future();
+                {
+                    std::lock_guard lock {mutex};
+                    tasks.emplace([packaged]() { (*packaged)(); });
+                }
+                cv.notify_one();
+
+                return future;
+            }
+
+            /// Execute one queued task on the calling thread, if
+            /// there is any. Returns false if the queue was
+            /// empty. Threads waiting on other tasks use this to
+            /// help instead of blocking, which also prevents
+            /// deadlocks when tasks wait on nested tasks.
+            bool run_pending_task();
+
+            size_t size() const { return threads.size(); }
+
+            /// Pool shared by the library, with one worker per
+            /// hardware thread.
+            static ThreadPool& global();
+
+        private:
+
+            std::vector<std::thread> threads;
+            std::queue<std::function<void()>> tasks;
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool stopping = false;
+
+            void worker();
+    };
+
+    /// Split the range `[0, count)` in chunks of at least
+    /// `min_chunk` elements and call `func(begin, end)` on each
+    /// of them in parallel on the global thread pool. The
+    /// calling thread takes part in the work, and the function
+    /// returns when all chunks are done. If chunks throw, the
+    /// first exception is rethrown once all of them are done.
+    void parallel_for(size_t count, const std::function<void(size_t, size_t)>& func, size_t min_chunk = 1);
+}
\ No newline at end of file
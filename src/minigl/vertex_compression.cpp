@@ -0,0 +1,221 @@
+#include "vertex_compression.hpp"
+
+#include <bit>
+#include <cstring>
+
+namespace minigl
+{
+    static_assert(sizeof(CompressedVertex) == 20, "CompressedVertex must be tightly packed");
+
+    //----------- SCALAR FORMATS -----------//
+
+    uint16_t float_to_half(float value)
+    {
+        uint32_t bits = std::bit_cast<uint32_t>(value);
+        uint16_t sign = (bits >> 16) & 0x8000;
+        uint32_t magnitude = bits & 0x7fffffff;
+
+        // NaN stays NaN, overflows become infinities
+        if (magnitude > 0x7f800000)
+            return sign | 0x7e00;
+        if (magnitude >= 0x477ff000)
+            return sign | 0x7c00;
+
+        // Normal numbers: rebias the exponent, and round the
+        // mantissa to nearest even.
+        if (magnitude >= 0x38800000) {
+            uint32_t rounded = magnitude - 0x38000000;
+            rounded += 0x0fff + ((rounded >> 13) & 1);
+            return sign | (uint16_t)(rounded >> 13);
+        }
+
+        // Subnormal numbers: shift the mantissa, with its
+        // implicit leading 1, into place.
+        if (magnitude >= 0x33000000) {
+            uint32_t exponent = magnitude >> 23;
+            uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+            uint32_t shift = 126 - exponent;
+            uint32_t rounded = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1);
+            uint32_t half = 1u << (shift - 1);
+            if (remainder > half || (remainder == half && (rounded & 1)))
+                rounded++;
+            return sign | (uint16_t)rounded;
+        }
+
+        return sign;
+    }
+
+    float half_to_float(uint16_t value)
+    {
+        uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+        uint32_t exponent = (value >> 10) & 0x1f;
+        uint32_t mantissa = value & 0x3ff;
+
+        if (exponent == 0x1f)
+            return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+
+        if (exponent == 0) {
+            float subnormal = std::ldexp((float)mantissa, -24);
+            return sign ? -subnormal : subnormal;
+        }
+
+        return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+    }
+
+    static uint32_t quantize_unorm(float value, int bits)
+    {
+        float scale = (float)((1u << bits) - 1);
+        return (uint32_t)(std::clamp(value, 0.f, 1.f) * scale + 0.5f);
+    }
+
+    static int32_t quantize_snorm(float value, int bits)
+    {
+        float scale = (float)((1u << (bits - 1)) - 1);
+        return (int32_t)std::round(std::clamp(value, -1.f, 1.f) * scale);
+    }
+
+    //----------- VECTOR FORMATS -----------//
+
+    Vec2 octahedral_encode(const Vec3& normal)
+    {
+        float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (sum == 0.f)
+            return Vec2{0.f};
+
+        Vec2 e {normal.x / sum, normal.y / sum};
+        if (normal.z < 0.f) {
+            // Fold the lower half over the diagonals
+            Vec2 folded {
+                (1.f - std::abs(e.y)) * (e.x >= 0.f ? 1.f : -1.f),
+                (1.f - std::abs(e.x)) * (e.y >= 0.f ? 1.f : -1.f)
+            };
+            e = folded;
+        }
+
+        return e;
+    }
+
+    Vec3 octahedral_decode(const Vec2& encoded)
+    {
+        Vec3 n {encoded.x, encoded.y, 1.f - std::abs(encoded.x) - std::abs(encoded.y)};
+        float t = std::max(-n.z, 0.f);
+        n.x += n.x >= 0.f ? -t : t;
+        n.y += n.y >= 0.f ? -t : t;
+
+        return glm::normalize(n);
+    }
+
+    uint32_t pack_snorm_10_10_10_2(const Vec4& value)
+    {
+        return  ((uint32_t)quantize_snorm(value.x, 10) & 0x3ff)
+             | (((uint32_t)quantize_snorm(value.y, 10) & 0x3ff) << 10)
+             | (((uint32_t)quantize_snorm(value.z, 10) & 0x3ff) << 20)
+             | (((uint32_t)quantize_snorm(value.w, 2) & 0x3) << 30);
+    }
+
+    uint32_t pack_unorm_10_10_10_2(const Vec4& value)
+    {
+        return  quantize_unorm(value.x, 10)
+             | (quantize_unorm(value.y, 10) << 10)
+             | (quantize_unorm(value.z, 10) << 20)
+             | (quantize_unorm(value.w, 2) << 30);
+    }
+
+    uint32_t pack_rgba8(const Color& color)
+    {
+        // Stored as r, g, b, a bytes in memory
+        uint8_t bytes[4] = {
+            (uint8_t)quantize_unorm(color.r, 8),
+            (uint8_t)quantize_unorm(color.g, 8),
+            (uint8_t)quantize_unorm(color.b, 8),
+            (uint8_t)quantize_unorm(color.a, 8)
+        };
+
+        uint32_t packed;
+        std::memcpy(&packed, bytes, sizeof(packed));
+        return packed;
+    }
+
+    //----------- COMPRESSED VERTICES -----------//
+
+    BufferLayout CompressedVertex::layout()
+    {
+        return {{DataType::UShort4, "a_pos", 0, true},
+                {DataType::Short2, "a_normal", 0, true},
+                {DataType::Half2, "a_tex"},
+                {DataType::UByte4, "a_color", 0, true}};
+    }
+
+    std::vector<CompressedVertex> compress_vertices(const std::vector<Vertex>& vertices, const AABB& bounds)
+    {
+        std::vector<CompressedVertex> compressed(vertices.size());
+
+        // Flat boxes keep a 0 extent on their flat axes.
+        Vec3 extent = bounds.max - bounds.min;
+        Vec3 scale {
+            extent.x > 0.f ? 1.f / extent.x : 0.f,
+            extent.y > 0.f ? 1.f / extent.y : 0.f,
+            extent.z > 0.f ? 1.f / extent.z : 0.f
+        };
+
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            auto& vertex = vertices[i];
+            auto& out = compressed[i];
+
+            Vec3 p = (vertex.pos - bounds.min) * scale;
+            out.pos[0] = quantize_unorm(p.x, 16);
+            out.pos[1] = quantize_unorm(p.y, 16);
+            out.pos[2] = quantize_unorm(p.z, 16);
+            out.pos[3] = 0xffff;
+
+            Vec2 n = octahedral_encode(vertex.normal);
+            out.normal[0] = quantize_snorm(n.x, 16);
+            out.normal[1] = quantize_snorm(n.y, 16);
+
+            out.tex[0] = float_to_half(vertex.tex.x);
+            out.tex[1] = float_to_half(vertex.tex.y);
+
+            out.color = pack_rgba8(vertex.color);
+        }
+
+        return compressed;
+    }
+
+    Mat4 dequantization_matrix(const AABB& bounds)
+    {
+        Mat4 dequantize {1.f};
+        Vec3 extent = bounds.max - bounds.min;
+        dequantize[0][0] = extent.x;
+        dequantize[1][1] = extent.y;
+        dequantize[2][2] = extent.z;
+        dequantize[3] = Vec4{bounds.min, 1.f};
+
+        return dequantize;
+    }
+
+    Ref<Mesh> compress_mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, DataAccess usage)
+    {
+        auto mesh = ref<Mesh>();
+        mesh->bounds = compute_bounds(vertices);
+        mesh->sphere = compute_sphere(vertices, mesh->bounds);
+        mesh->dequantization = dequantization_matrix(mesh->bounds);
+
+        auto vb = ref<VertexBuffer>(compress_vertices(vertices, mesh->bounds), CompressedVertex::layout(), usage);
+        auto ib = ref<IndexBuffer>(indices, usage);
+        mesh->vertexArray = ref<VertexArray>(vb, ib);
+
+        return mesh;
+    }
+
+    const char* const compressed_vertex_glsl = R"glsl(
+vec3 octahedral_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+)glsl";
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "core.hpp"
+#include "buffer.hpp"
+#include "mesh.hpp"
+
+namespace minigl
+{
+    /// Convert a float to a 16-bit float (round to nearest
+    /// even; out of range values become infinities)
+    uint16_t float_to_half(float value);
+    float half_to_float(uint16_t value);
+
+    /// Map a unit vector to the [-1, 1] square, by projecting
+    /// it on the octahedron and unfolding the lower half.
+    Vec2 octahedral_encode(const Vec3& normal);
+    Vec3 octahedral_decode(const Vec2& encoded);
+
+    /// Pack a vector of [-1, 1] components (signed) or [0, 1]
+    /// components (unsigned) in the 10_10_10_2 formats
+    uint32_t pack_snorm_10_10_10_2(const Vec4& value);
+    uint32_t pack_unorm_10_10_10_2(const Vec4& value);
+
+    /// Pack a [0, 1] color in 8 bits per channel
+    uint32_t pack_rgba8(const Color& color);
+
+    /// Vertex stored in 20 bytes instead of 48:
+    /// - the position is quantized to 16 bits per axis within
+    ///   the bounding box of the mesh (see
+    ///   `dequantization_matrix()`),
+    /// - the normal is octahedral encoded in two 16-bit
+    ///   components,
+    /// - the texture coordinates are half floats,
+    /// - the color is 8 bits per channel.
+    struct CompressedVertex
+    {
+        uint16_t pos[4];
+        int16_t normal[2];
+        uint16_t tex[2];
+        uint32_t color;
+
+        /// Layout of a buffer of compressed vertices: the
+        /// attributes are normalized, except the texture
+        /// coordinates. The shader gets the position in
+        /// [0, 1] and the encoded normal in [-1, 1] (see
+        /// `compressed_vertex_glsl`).
+        static BufferLayout layout();
+    };
+
+    /// Compress vertices, quantizing the positions to `bounds`,
+    /// which must contain all the vertices.
+    std::vector<CompressedVertex> compress_vertices(const std::vector<Vertex>& vertices, const AABB& bounds);
+
+    /// Transform from quantized positions, in [0, 1], to the
+    /// box `bounds`.
+    Mat4 dequantization_matrix(const AABB& bounds);
+
+    /// Create a mesh whose vertex buffer holds compressed
+    /// vertices. Its `dequantization` matrix must be applied
+    /// to the positions (e.g. multiplied with the model
+    /// matrix); normals are not affected by it.
+    Ref<Mesh> compress_mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, DataAccess usage = DataAccess::Static);
+
+    /// GLSL function `vec3 octahedral_decode(vec2 e)`, to be
+    /// prepended to the source of the shaders drawing
+    /// compressed vertices.
+    extern const char* const compressed_vertex_glsl;
+}
\ No newline at end of file
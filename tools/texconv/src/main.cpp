@@ -0,0 +1,93 @@
+#include "minigl/minigl.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <stb_image.h>
+
+using namespace minigl;
+
+static void usage()
+{
+    fmt::print("Usage: texconv <input.png|jpg|...> <output.ktx2> [options]\n"
+               "Options:\n"
+               "  --format bc1|bc3|bc4|bc5|bc7   block format (default: bc7)\n"
+               "  --srgb                         the image is sRGB color\n"
+               "  --no-mips                      only encode the full resolution level\n");
+}
+
+static bool parse_format(const char* name, CompressedFormat& format)
+{
+    static const std::pair<const char*, CompressedFormat> formats[] = {
+        {"bc1", CompressedFormat::BC1}, {"bc3", CompressedFormat::BC3}, {"bc4", CompressedFormat::BC4},
+        {"bc5", CompressedFormat::BC5}, {"bc7", CompressedFormat::BC7},
+    };
+
+    for (auto& [key, value]: formats) {
+        if (std::strcmp(name, key) == 0) {
+            format = value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// Offline converter of images to block compressed KTX2
+/// textures, with their mip chain, for `Texture` to load
+/// without decoding or compressing anything at runtime.
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+
+    CompressedFormat format = CompressedFormat::BC7;
+    bool srgb = false, mips = true;
+    for (int i = 3; i < argc; i++) {
+        if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc && parse_format(argv[i+1], format))
+            i++;
+        else if (std::strcmp(argv[i], "--srgb") == 0)
+            srgb = true;
+        else if (std::strcmp(argv[i], "--no-mips") == 0)
+            mips = false;
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    // Flipped like the images loaded by `Texture`, so that
+    // both have their first row at the bottom.
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load(1);
+    stbi_uc* pixels = stbi_load(argv[1], &width, &height, &channels, 4);
+    if (!pixels) {
+        fmt::print("Cannot load image '{}': {}\n", argv[1], stbi_failure_reason());
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::vector<uint8_t>> levels {};
+    levels.push_back(encode_bc(pixels, width, height, format));
+    if (mips) {
+        for (auto& mip: generate_mipmaps(pixels, width, height, 4, srgb, MipmapGeneration::CPUKaiser))
+            levels.push_back(encode_bc(mip.pixels.data(), mip.width, mip.height, format));
+    }
+
+    stbi_image_free(pixels);
+
+    if (!write_ktx2(argv[2], format, srgb, width, height, levels)) {
+        fmt::print("Cannot write '{}'\n", argv[2]);
+        return 1;
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    size_t size = 0;
+    for (auto& level: levels)
+        size += level.size();
+
+    fmt::print("{} ({}x{}, {} levels): {} KiB compressed, {:.0f} ms\n",
+               argv[2], width, height, levels.size(), size / 1024, elapsed.count());
+    return 0;
+}
\ No newline at end of file